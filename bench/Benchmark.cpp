@@ -0,0 +1,261 @@
+#include "Benchmark.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/constants.hpp>
+
+#include "Logger.h"
+#include "Profiler.h"
+
+namespace hyper
+{
+	namespace
+	{
+		struct Summary // Milliseconds
+		{
+			double Mean = 0.0, P50 = 0.0, P95 = 0.0, P99 = 0.0, Max = 0.0;
+		};
+
+		Summary Summarise(std::vector<float> values)
+		{
+			Summary summary;
+			if (values.empty())
+				return summary;
+			std::sort(values.begin(), values.end());
+			auto percentile = [&](double p) { return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))]; };
+			double total = 0.0;
+			for (float value : values)
+				total += value;
+			summary.Mean = total / values.size();
+			summary.P50 = percentile(0.5);
+			summary.P95 = percentile(0.95);
+			summary.P99 = percentile(0.99);
+			summary.Max = values.back();
+			return summary;
+		}
+
+		void WriteSummary(std::ofstream& file, const Summary& summary, size_t samples)
+		{
+			file << "{ \"samples\": " << samples << ", \"mean\": " << summary.Mean << ", \"p50\": " << summary.P50 << ", \"p95\": " << summary.P95
+				<< ", \"p99\": " << summary.P99 << ", \"max\": " << summary.Max << " }";
+		}
+
+		std::string Escape(const std::string& text)
+		{
+			std::string escaped;
+			for (char c : text)
+			{
+				if (c == '"' || c == '\\')
+					escaped += '\\';
+				escaped += c;
+			}
+			return escaped;
+		}
+	}
+
+	std::vector<CameraKey> MakeOrbitPath(float radius, float height, float period)
+	{
+		constexpr uint32_t Steps = 64;
+		std::vector<CameraKey> keys;
+		for (uint32_t i = 0; i <= Steps; i++)
+		{
+			float angle = glm::two_pi<float>() * i / Steps;
+			keys.push_back(CameraKey{ period * i / Steps, { std::sin(angle) * radius, height, std::cos(angle) * radius }, -angle,
+				-std::atan2(height, radius) });
+		}
+		return keys;
+	}
+
+	bool LoadCameraPath(const std::filesystem::path& path, std::vector<CameraKey>& keys)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+		{
+			Logger::logger->Log("Couldn't open camera path " + path.string(), Severity::Error);
+			return false;
+		}
+
+		std::vector<CameraKey> loaded;
+		std::string line;
+		for (uint32_t lineNumber = 1; std::getline(file, line); lineNumber++)
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+			std::istringstream stream(line);
+			CameraKey key;
+			if (!(stream >> key.Time >> key.Position.x >> key.Position.y >> key.Position.z >> key.Yaw >> key.Pitch))
+			{
+				Logger::logger->Log(path.string() + ":" + std::to_string(lineNumber) + " isn't \"time x y z yaw pitch\"", Severity::Error);
+				return false;
+			}
+			if (!loaded.empty() && key.Time < loaded.back().Time)
+			{
+				Logger::logger->Log(path.string() + ":" + std::to_string(lineNumber) + " goes back in time", Severity::Error);
+				return false;
+			}
+			loaded.push_back(key);
+		}
+		if (loaded.empty())
+		{
+			Logger::logger->Log("Camera path " + path.string() + " has no keys in it", Severity::Error);
+			return false;
+		}
+		keys = std::move(loaded);
+		return true;
+	}
+
+	CameraKey SampleCameraPath(const std::vector<CameraKey>& keys, float time)
+	{
+		float duration = keys.back().Time;
+		if (keys.size() == 1 || duration <= 0.0f)
+			return keys.front();
+		time = std::fmod(time, duration);
+
+		auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const CameraKey& key) { return t < key.Time; });
+		if (next == keys.begin())
+			return keys.front();
+		if (next == keys.end())
+			return keys.back();
+		const CameraKey& previous = *(next - 1);
+		float span = next->Time - previous.Time;
+		float t = span > 0.0f ? (time - previous.Time) / span : 0.0f;
+		return CameraKey{ time, glm::mix(previous.Position, next->Position, t), glm::mix(previous.Yaw, next->Yaw, t), glm::mix(previous.Pitch, next->Pitch, t) };
+	}
+
+	bool RunBenchmark(const BenchmarkSettings& settings)
+	{
+		std::vector<CameraKey> cameraPath = MakeOrbitPath(6.0f, 2.0f, 10.0f);
+		if (!settings.CameraPath.empty() && !LoadCameraPath(settings.CameraPath, cameraPath))
+			return false;
+
+		Spec spec = settings.RendererSpec;
+		spec.Headless = true;
+		Renderer renderer;
+		renderer.SetupRenderer(spec);
+		Profiler& profiler = *Profiler::profiler; // The renderer's
+
+		auto drawFrame = [&](float time)
+			{
+				CameraKey key = SampleCameraPath(cameraPath, time);
+				Camera& camera = renderer.GetCamera();
+				camera.position = key.Position;
+				camera.yaw = key.Yaw;
+				camera.pitch = key.Pitch;
+				renderer.SetHeadlessTime(time);
+
+				profiler.BeginFrame();
+				renderer.DrawFrame();
+				profiler.EndFrame();
+			};
+
+		// The scene loads in the background like it does in the app, frames keep going so the loader's uploads get picked up
+		std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+		auto loadSeconds = [&]() { return std::chrono::duration<float>(std::chrono::steady_clock::now() - loadStart).count(); };
+		while (renderer.GetSceneState() == AssetState::Loading || renderer.GetSceneState() == AssetState::Uploading)
+		{
+			if (loadSeconds() > settings.LoadTimeout)
+			{
+				Logger::logger->Log("Scene " + spec.ModelPath + " still wasn't resident after " + std::to_string(settings.LoadTimeout) + "s", Severity::Error);
+				return false;
+			}
+			drawFrame(0.0f);
+		}
+		if (renderer.GetSceneState() == AssetState::Failed)
+		{
+			Logger::logger->Log("Scene " + spec.ModelPath + " failed to load", Severity::Error);
+			return false;
+		}
+		float sceneLoadSeconds = loadSeconds();
+
+		uint64_t sceneFrame = 0; // Scene time starts once it's loaded
+		for (uint32_t i = 0; i < settings.WarmupFrames; i++)
+			drawFrame(sceneFrame++ * settings.TimeStep);
+
+		// Timestamps only come back once a frame's slot comes round again, so each frame gets read that many frames later
+		// and a few extra frames at the end get drawn just to bring the last ones back
+		uint64_t lag = std::max(spec.FramesInFlight, 1u);
+		uint64_t firstMeasured = profiler.GetFrameNumber() + 1, lastMeasured = firstMeasured + settings.Frames - 1, nextRead = firstMeasured;
+		std::vector<float> cpuTimes, gpuTimes;
+		std::map<std::string, std::vector<float>> phaseTimes; // Summed within a frame, recording chunks and the like show up more than once
+		auto readFrames = [&]()
+			{
+				uint64_t current = profiler.GetFrameNumber();
+				for (; nextRead <= lastMeasured && nextRead + lag <= current; nextRead++)
+				{
+					const ProfileFrame* frame = profiler.GetFrame(nextRead);
+					if (!frame)
+						continue; // Can't happen with the ring as big as it is, but a missing frame shouldn't take the run down
+					cpuTimes.push_back((frame->End - frame->Start) / 1e6f);
+					for (uint32_t i = 0; i < frame->GpuCount; i++)
+						if (std::string(frame->Gpu[i].Name) == "Frame")
+							gpuTimes.push_back((frame->Gpu[i].End - frame->Gpu[i].Start) / 1e6f);
+
+					std::map<std::string, float> phases;
+					uint32_t cpuCount = std::min(frame->CpuCount.load(std::memory_order_relaxed), ProfileFrame::MaxCpuEvents);
+					for (uint32_t i = 0; i < cpuCount; i++)
+						if (frame->Cpu[i].End != 0)
+							phases[frame->Cpu[i].Name] += (frame->Cpu[i].End - frame->Cpu[i].Start) / 1e6f;
+					for (const std::pair<const std::string, float>& phase : phases)
+						phaseTimes[phase.first].push_back(phase.second);
+				}
+			};
+		for (uint32_t i = 0; i < settings.Frames; i++)
+		{
+			drawFrame(sceneFrame++ * settings.TimeStep);
+			readFrames();
+		}
+		for (uint64_t i = 0; i < lag; i++)
+		{
+			drawFrame(sceneFrame++ * settings.TimeStep);
+			readFrames();
+		}
+
+		std::ofstream file(settings.OutputPath, std::ios::trunc);
+		if (!file.is_open())
+		{
+			Logger::logger->Log("Couldn't open " + settings.OutputPath.string() + " to write the results to", Severity::Error);
+			return false;
+		}
+		Summary cpu = Summarise(cpuTimes), gpu = Summarise(gpuTimes);
+		file << std::fixed << std::setprecision(4);
+		file << "{\n";
+		file << "\t\"device\": \"" << Escape(renderer.GetDeviceName()) << "\",\n";
+		file << "\t\"scene\": \"" << Escape(spec.ModelPath) << "\",\n";
+		file << "\t\"width\": " << spec.Width << ",\n\t\"height\": " << spec.Height << ",\n";
+		file << "\t\"framesInFlight\": " << spec.FramesInFlight << ",\n";
+		file << "\t\"frames\": " << settings.Frames << ",\n\t\"warmupFrames\": " << settings.WarmupFrames << ",\n";
+		file << "\t\"sceneLoadSeconds\": " << sceneLoadSeconds << ",\n";
+		file << "\t\"cpuFrameMs\": ";
+		WriteSummary(file, cpu, cpuTimes.size());
+		file << ",\n\t\"gpuFrameMs\": ";
+		if (gpuTimes.empty()) // No timestamp support on the queue
+			file << "null";
+		else
+			WriteSummary(file, gpu, gpuTimes.size());
+		file << ",\n\t\"phasesMs\": {";
+		bool first = true;
+		for (const std::pair<const std::string, std::vector<float>>& phase : phaseTimes)
+		{
+			file << (first ? "\n" : ",\n") << "\t\t\"" << Escape(phase.first) << "\": ";
+			WriteSummary(file, Summarise(phase.second), phase.second.size());
+			first = false;
+		}
+		file << "\n\t}\n}\n";
+		if (!file)
+		{
+			Logger::logger->Log("Failed writing " + settings.OutputPath.string(), Severity::Error);
+			return false;
+		}
+
+		std::ostringstream result;
+		result << std::fixed << std::setprecision(3) << "Benchmark done: cpu p50 " << cpu.P50 << "ms p99 " << cpu.P99 << "ms, gpu p50 " << gpu.P50
+			<< "ms p99 " << gpu.P99 << "ms, written to " << settings.OutputPath.string();
+		Logger::logger->Log(result.str());
+		return true;
+	}
+}
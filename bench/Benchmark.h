@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <filesystem>
+
+#include "Renderer.h"
+
+namespace hyper
+{
+	struct CameraKey // One point on a camera path, straight lines in between
+	{
+		float Time; // Seconds
+		glm::vec3 Position;
+		float Yaw, Pitch; // Same as Camera's
+	};
+
+	struct BenchmarkSettings
+	{
+		Spec RendererSpec; // Always run headless, whatever this says
+		uint32_t Frames = 500;
+		uint32_t WarmupFrames = 60; // Shader variants, the first uploads and the driver settling in, none of it gets counted
+		float TimeStep = 1.0f / 60.0f; // Scene time per frame, fixed so every run draws the same frames however fast it goes
+		float LoadTimeout = 120.0f; // Seconds to wait for the scene to go resident, lavapipe can take a while
+		std::filesystem::path CameraPath; // Empty orbits the origin
+		std::filesystem::path OutputPath = "benchmark.json";
+	};
+
+	std::vector<CameraKey> MakeOrbitPath(float radius, float height, float period); // Circles the origin, always facing it
+	bool LoadCameraPath(const std::filesystem::path& path, std::vector<CameraKey>& keys); // A "time x y z yaw pitch" per line, # for comments
+	CameraKey SampleCameraPath(const std::vector<CameraKey>& keys, float time); // Loops once it runs off the end
+
+	// Loads the scene headless, draws the warmup and then settings.Frames frames down the camera path,
+	// and writes frame time percentiles, the profiler's cpu phases and gpu time as JSON
+	bool RunBenchmark(const BenchmarkSettings& settings);
+}
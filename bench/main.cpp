@@ -0,0 +1,77 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <string>
+
+#include "Logger.h"
+
+int main(int argc, char** argv)
+{
+	hyper::BenchmarkSettings settings{};
+	settings.RendererSpec.Title = "hyper benchmark";
+	settings.RendererSpec.InfoDebug = false; // Less Verbose
+	settings.RendererSpec.Validation = false; // It'd be most of what gets measured
+	settings.RendererSpec.Width = 1280;
+	settings.RendererSpec.Height = 720;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option == "--validation")
+		{
+			settings.RendererSpec.Validation = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Usage: hyper-bench [--scene file.glb] [--frames n] [--warmup n] [--width n] [--height n] [--frames-in-flight n]\n"
+				"                   [--device name] [--camera path.txt] [--out results.json] [--validation]\n";
+			return 2;
+		}
+		std::string value = argv[++i];
+		bool numeric = option != "--scene" && option != "--device" && option != "--camera" && option != "--out";
+		if (numeric && (value.empty() || value.find_first_not_of("0123456789") != std::string::npos))
+		{
+			std::cerr << option << " needs a number, got \"" << value << "\"\n";
+			return 2;
+		}
+		if (option == "--scene")
+			settings.RendererSpec.ModelPath = value;
+		else if (option == "--frames")
+			settings.Frames = std::stoul(value);
+		else if (option == "--warmup")
+			settings.WarmupFrames = std::stoul(value);
+		else if (option == "--width")
+			settings.RendererSpec.Width = std::stoul(value);
+		else if (option == "--height")
+			settings.RendererSpec.Height = std::stoul(value);
+		else if (option == "--frames-in-flight")
+			settings.RendererSpec.FramesInFlight = std::stoul(value);
+		else if (option == "--device")
+			settings.RendererSpec.DeviceName = value; // "llvmpipe" picks lavapipe even with a real gpu around
+		else if (option == "--camera")
+			settings.CameraPath = value;
+		else if (option == "--out")
+			settings.OutputPath = value;
+		else
+		{
+			std::cerr << "Unknown option " << option << "\n";
+			return 2;
+		}
+	}
+
+	hyper::Logger* logger = new hyper::Logger();
+	logger->SetDebug(settings.RendererSpec);
+
+	int result = 1;
+	try
+	{
+		result = hyper::RunBenchmark(settings) ? 0 : 1;
+	}
+	catch (const std::exception& exception) // Missing extensions and the like come out of vulkan.hpp as exceptions, ci wants an exit code
+	{
+		logger->Log(std::string("Benchmark failed: ") + exception.what(), hyper::Severity::Error);
+	}
+	delete logger; // Writes out whatever's still queued
+	return result;
+}
@@ -0,0 +1,161 @@
+#include "MicroBench.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+namespace hyper
+{
+	namespace
+	{
+		std::string Escape(const std::string& text)
+		{
+			std::string escaped;
+			for (char c : text)
+			{
+				if (c == '"' || c == '\\')
+					escaped += '\\';
+				escaped += c;
+			}
+			return escaped;
+		}
+
+		std::string CompilerName()
+		{
+#if defined(__clang__)
+			return "clang " __clang_version__;
+#elif defined(__GNUC__)
+			return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+			return "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+			return "unknown";
+#endif
+		}
+
+		std::string FormatTime(double nanoseconds)
+		{
+			std::ostringstream text;
+			text << std::fixed << std::setprecision(2);
+			if (nanoseconds >= 1e6)
+				text << nanoseconds / 1e6 << " ms";
+			else if (nanoseconds >= 1e3)
+				text << nanoseconds / 1e3 << " us";
+			else
+				text << nanoseconds << " ns";
+			return text.str();
+		}
+	}
+
+	size_t MicroBench::Scaled(size_t size) const
+	{
+		return std::max<size_t>(1, static_cast<size_t>(std::llround(size * m_Settings.Scale)));
+	}
+
+	void MicroBench::Run(const std::string& name, const std::string& input, uint64_t items, uint64_t bytes, const std::function<void()>& body)
+	{
+		Measure(name, input, items, bytes, [&](uint64_t batch)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for (uint64_t i = 0; i < batch; i++)
+					body();
+				return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			});
+	}
+
+	void MicroBench::RunTimed(const std::string& name, const std::string& input, uint64_t items, uint64_t bytes, const std::function<double()>& body)
+	{
+		Measure(name, input, items, bytes, [&](uint64_t batch)
+			{
+				double time = 0.0;
+				for (uint64_t i = 0; i < batch; i++)
+					time += body();
+				return time;
+			});
+	}
+
+	void MicroBench::Measure(const std::string& name, const std::string& input, uint64_t items, uint64_t bytes,
+		const std::function<double(uint64_t batch)>& timeBatch)
+	{
+		if (!Enabled(name))
+			return;
+
+		// Doubling the batch doubles as the warmup, caches and the allocator are settled by the time it's big enough
+		uint64_t batch = 1;
+		while (timeBatch(batch) < 1e6 && batch < (1ull << 30))
+			batch *= 2;
+
+		std::vector<double> samples;
+		double total = 0.0;
+		while (total < m_Settings.MinSeconds * 1e9 || samples.size() < m_Settings.MinSamples)
+		{
+			double time = timeBatch(batch);
+			total += time;
+			samples.push_back(time / batch);
+		}
+		std::sort(samples.begin(), samples.end());
+
+		MicroBenchResult result;
+		result.Name = name;
+		result.Input = input;
+		result.Items = items;
+		result.Bytes = bytes;
+		result.Iterations = batch * samples.size();
+		result.Min = samples.front();
+		result.Median = samples[samples.size() / 2];
+		result.Mean = total / result.Iterations;
+		result.Max = samples.back();
+		m_Results.push_back(result);
+
+		m_Console << std::left << std::setw(32) << name << std::setw(24) << input << std::right << std::setw(12) << FormatTime(result.Median)
+			<< "  min " << std::setw(12) << FormatTime(result.Min);
+		if (bytes)
+			m_Console << "  " << std::fixed << std::setprecision(1) << bytes / result.Median * 1e9 / (1024.0 * 1024.0) << " MiB/s";
+		else if (items)
+			m_Console << "  " << std::fixed << std::setprecision(1) << items / result.Median * 1e3 << " M/s";
+		m_Console << std::endl;
+	}
+
+	bool MicroBench::WriteJson() const
+	{
+		std::ofstream file(m_Settings.OutputPath, std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "Couldn't open " << m_Settings.OutputPath.string() << " to write the results to" << std::endl;
+			return false;
+		}
+		file << std::fixed << std::setprecision(3);
+		file << "{\n";
+		file << "\t\"compiler\": \"" << Escape(CompilerName()) << "\",\n";
+#if defined(NDEBUG)
+		file << "\t\"optimised\": true,\n";
+#else
+		file << "\t\"optimised\": false,\n";
+#endif
+		file << "\t\"scale\": " << m_Settings.Scale << ",\n";
+		file << "\t\"cases\": [";
+		for (size_t i = 0; i < m_Results.size(); i++)
+		{
+			const MicroBenchResult& result = m_Results[i];
+			file << (i ? ",\n" : "\n") << "\t\t{ \"name\": \"" << Escape(result.Name) << "\", \"input\": \"" << Escape(result.Input) << "\", \"iterations\": "
+				<< result.Iterations << ", \"minNs\": " << result.Min << ", \"medianNs\": " << result.Median << ", \"meanNs\": " << result.Mean
+				<< ", \"maxNs\": " << result.Max;
+			if (result.Items)
+				file << ", \"items\": " << result.Items << ", \"itemsPerSecond\": " << result.Items / result.Median * 1e9;
+			if (result.Bytes)
+				file << ", \"bytes\": " << result.Bytes << ", \"bytesPerSecond\": " << result.Bytes / result.Median * 1e9;
+			file << " }";
+		}
+		file << "\n\t]\n}\n";
+		if (!file)
+		{
+			std::cerr << "Failed writing " << m_Settings.OutputPath.string() << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <iostream>
+#include <filesystem>
+#include <cstdint>
+#include <cstddef>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace hyper
+{
+	struct MicroBenchSettings
+	{
+		double Scale = 1.0; // Multiplies every case's input size, results only diff cleanly against runs at the same scale
+		double MinSeconds = 0.25; // Each case keeps going until it's been timed for at least this long
+		uint32_t MinSamples = 7;
+		std::string Filter; // Only cases with this in their name, empty runs everything
+		std::filesystem::path OutputPath = "microbench.json";
+	};
+
+	struct MicroBenchResult // Times are per iteration, in nanoseconds
+	{
+		std::string Name;
+		std::string Input; // What it ran on, "65536 vertices" and the like
+		uint64_t Items = 0, Bytes = 0; // Per iteration, for throughput, 0 leaves it out
+		uint64_t Iterations = 0;
+		double Min = 0.0, Median = 0.0, Mean = 0.0, Max = 0.0;
+	};
+
+	// Tiny timing harness, no dependencies so it builds wherever the engine does
+	// Iterations get batched until one sample takes about a millisecond, then samples are taken until there's enough of them
+	class MicroBench
+	{
+	public:
+		explicit MicroBench(const MicroBenchSettings& settings) : m_Settings(settings), m_Console(std::cout.rdbuf()) {}
+
+		size_t Scaled(size_t size) const; // size * scale, never below 1
+		bool Enabled(const std::string& name) const { return m_Settings.Filter.empty() || name.find(m_Settings.Filter) != std::string::npos; }
+
+		// body is one iteration, anything that shouldn't be timed goes before the call
+		void Run(const std::string& name, const std::string& input, uint64_t items, uint64_t bytes, const std::function<void()>& body);
+		// Same, but body times itself and returns the nanoseconds, for iterations that need untimed cleanup at the end of each one
+		void RunTimed(const std::string& name, const std::string& input, uint64_t items, uint64_t bytes, const std::function<double()>& body);
+		bool WriteJson() const;
+
+		const std::vector<MicroBenchResult>& GetResults() const { return m_Results; }
+
+	private:
+		void Measure(const std::string& name, const std::string& input, uint64_t items, uint64_t bytes, const std::function<double(uint64_t batch)>& timeBatch);
+
+		MicroBenchSettings m_Settings;
+		std::vector<MicroBenchResult> m_Results;
+		std::ostream m_Console; // Stdout's buffer from when it was made, so cases can point std::cout somewhere else without hiding the results
+	};
+
+	// Stops the compiler throwing away work whose result nothing reads
+	template<typename T>
+	inline void KeepAlive(const T& value)
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		static const void* volatile sink;
+		sink = &value;
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r"(&value) : "memory");
+#endif
+	}
+}
@@ -0,0 +1,277 @@
+#include "Synthetic.h"
+
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+namespace hyper
+{
+	namespace
+	{
+		float Height(float x, float z)
+		{
+			return std::sin(x * 0.7f) * std::cos(z * 0.45f) * 1.5f + std::sin(x * 2.3f + z * 1.9f) * 0.2f;
+		}
+
+		template<typename T>
+		void Append(std::vector<uint8_t>& bytes, const std::vector<T>& values)
+		{
+			size_t offset = bytes.size();
+			bytes.resize(offset + values.size() * sizeof(T));
+			std::memcpy(bytes.data() + offset, values.data(), values.size() * sizeof(T));
+		}
+
+		void PutU32(std::vector<uint8_t>& bytes, uint32_t value) // Little endian, GLB
+		{
+			for (uint32_t i = 0; i < 4; i++)
+				bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+		}
+
+		void PutU32BE(std::vector<uint8_t>& bytes, uint32_t value) // Big endian, PNG
+		{
+			for (uint32_t i = 0; i < 4; i++)
+				bytes.push_back(static_cast<uint8_t>(value >> (24 - i * 8)));
+		}
+
+		uint32_t Crc32(const uint8_t* data, size_t size)
+		{
+			static uint32_t table[256] = {};
+			if (!table[1])
+				for (uint32_t n = 0; n < 256; n++)
+				{
+					uint32_t c = n;
+					for (uint32_t k = 0; k < 8; k++)
+						c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					table[n] = c;
+				}
+			uint32_t crc = ~0u;
+			for (size_t i = 0; i < size; i++)
+				crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			return ~crc;
+		}
+
+		void PutChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data)
+		{
+			PutU32BE(png, static_cast<uint32_t>(data.size()));
+			size_t start = png.size();
+			png.insert(png.end(), type, type + 4);
+			png.insert(png.end(), data.begin(), data.end());
+			PutU32BE(png, Crc32(png.data() + start, png.size() - start)); // Covers the type too
+		}
+
+		class BitWriter // Deflate packs bits from the least significant end up
+		{
+		public:
+			void Put(uint32_t bits, uint32_t count)
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					m_Current |= ((bits >> i) & 1) << m_Count;
+					if (++m_Count == 8)
+						Flush();
+				}
+			}
+			void PutCode(uint32_t code, uint32_t length) // Huffman codes go most significant bit first
+			{
+				for (uint32_t i = length; i-- > 0;)
+					Put(code >> i, 1);
+			}
+			void Flush()
+			{
+				if (m_Count)
+					Bytes.push_back(static_cast<uint8_t>(m_Current));
+				m_Current = 0;
+				m_Count = 0;
+			}
+
+			std::vector<uint8_t> Bytes;
+
+		private:
+			uint32_t m_Current = 0, m_Count = 0;
+		};
+
+		uint8_t Paeth(int a, int b, int c)
+		{
+			int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+			return static_cast<uint8_t>(pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+		}
+	}
+
+	SyntheticMesh MakeGridMesh(uint32_t side, uint32_t seed)
+	{
+		side = std::max(side, 2u);
+		SyntheticMesh mesh;
+		size_t vertexCount = static_cast<size_t>(side) * side;
+		mesh.Positions.reserve(vertexCount * 3);
+		mesh.Normals.reserve(vertexCount * 3);
+		mesh.TexCoords.reserve(vertexCount * 2);
+
+		constexpr float Size = 20.0f;
+		float step = Size / (side - 1);
+		for (uint32_t z = 0; z < side; z++)
+			for (uint32_t x = 0; x < side; x++)
+			{
+				float px = x * step - Size * 0.5f, pz = z * step - Size * 0.5f;
+				mesh.Positions.insert(mesh.Positions.end(), { px, Height(px, pz), pz });
+
+				float dx = Height(px + step, pz) - Height(px - step, pz), dz = Height(px, pz + step) - Height(px, pz - step); // Central differences
+				float nx = -dx, ny = 2.0f * step, nz = -dz, length = std::sqrt(nx * nx + ny * ny + nz * nz);
+				mesh.Normals.insert(mesh.Normals.end(), { nx / length, ny / length, nz / length });
+				mesh.TexCoords.insert(mesh.TexCoords.end(), { static_cast<float>(x) / (side - 1), static_cast<float>(z) / (side - 1) });
+			}
+
+		std::vector<uint32_t> quads(static_cast<size_t>(side - 1) * (side - 1) * 2);
+		for (uint32_t i = 0; i < quads.size(); i++)
+			quads[i] = i;
+		std::mt19937 random(seed); // Raw outputs are the same everywhere, the distributions aren't
+		for (size_t i = quads.size() - 1; i > 0; i--)
+			std::swap(quads[i], quads[random() % (i + 1)]);
+
+		mesh.Indices.reserve(quads.size() * 3);
+		for (uint32_t triangle : quads)
+		{
+			uint32_t quad = triangle / 2, x = quad % (side - 1), z = quad / (side - 1);
+			uint32_t v0 = z * side + x, v1 = v0 + 1, v2 = v0 + side, v3 = v2 + 1;
+			if (triangle & 1)
+				mesh.Indices.insert(mesh.Indices.end(), { v1, v3, v2 });
+			else
+				mesh.Indices.insert(mesh.Indices.end(), { v0, v1, v2 });
+		}
+		return mesh;
+	}
+
+	bool WriteGlb(const std::filesystem::path& path, const SyntheticMesh& mesh)
+	{
+		std::vector<uint8_t> binary; // Every attribute is 4 byte aligned already, so they just go one after the other
+		size_t views[5] = { 0 };
+		Append(binary, mesh.Positions);
+		views[1] = binary.size();
+		Append(binary, mesh.Normals);
+		views[2] = binary.size();
+		Append(binary, mesh.TexCoords);
+		views[3] = binary.size();
+		Append(binary, mesh.Indices);
+		views[4] = binary.size();
+
+		float minimum[3] = { INFINITY, INFINITY, INFINITY }, maximum[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (size_t i = 0; i < mesh.Positions.size(); i++)
+		{
+			minimum[i % 3] = std::min(minimum[i % 3], mesh.Positions[i]);
+			maximum[i % 3] = std::max(maximum[i % 3], mesh.Positions[i]);
+		}
+
+		std::ostringstream json;
+		json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"hyper-microbench\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+			<< "\"meshes\":[{\"name\":\"grid\",\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+			<< "\"buffers\":[{\"byteLength\":" << binary.size() << "}],\"bufferViews\":[";
+		for (uint32_t i = 0; i < 4; i++)
+			json << (i ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << views[i] << ",\"byteLength\":" << views[i + 1] - views[i]
+				<< ",\"target\":" << (i == 3 ? 34963 : 34962) << "}";
+		json << "],\"accessors\":["
+			<< "{\"bufferView\":0,\"componentType\":5126,\"count\":" << mesh.VertexCount() << ",\"type\":\"VEC3\",\"min\":[" << minimum[0] << ","
+			<< minimum[1] << "," << minimum[2] << "],\"max\":[" << maximum[0] << "," << maximum[1] << "," << maximum[2] << "]},"
+			<< "{\"bufferView\":1,\"componentType\":5126,\"count\":" << mesh.VertexCount() << ",\"type\":\"VEC3\"},"
+			<< "{\"bufferView\":2,\"componentType\":5126,\"count\":" << mesh.VertexCount() << ",\"type\":\"VEC2\"},"
+			<< "{\"bufferView\":3,\"componentType\":5125,\"count\":" << mesh.Indices.size() << ",\"type\":\"SCALAR\"}]}";
+		std::string text = json.str();
+		text.resize((text.size() + 3) & ~size_t(3), ' '); // Chunks are 4 byte aligned, JSON pads with spaces and the binary with zeroes
+		binary.resize((binary.size() + 3) & ~size_t(3), 0);
+
+		std::vector<uint8_t> glb;
+		PutU32(glb, 0x46546C67); // "glTF"
+		PutU32(glb, 2);
+		PutU32(glb, static_cast<uint32_t>(12 + 8 + text.size() + 8 + binary.size()));
+		PutU32(glb, static_cast<uint32_t>(text.size()));
+		PutU32(glb, 0x4E4F534A); // "JSON"
+		glb.insert(glb.end(), text.begin(), text.end());
+		PutU32(glb, static_cast<uint32_t>(binary.size()));
+		PutU32(glb, 0x004E4942); // "BIN"
+		glb.insert(glb.end(), binary.begin(), binary.end());
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(glb.data()), glb.size());
+		return static_cast<bool>(file);
+	}
+
+	std::vector<uint8_t> MakeImageRGBA8(uint32_t width, uint32_t height, uint32_t seed)
+	{
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+		std::mt19937 random(seed);
+		for (uint32_t y = 0; y < height; y++)
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint8_t* pixel = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+				uint32_t noise = random();
+				pixel[0] = static_cast<uint8_t>(x * 255 / std::max(width - 1, 1u) + (noise & 7));
+				pixel[1] = static_cast<uint8_t>(y * 255 / std::max(height - 1, 1u) + ((noise >> 3) & 7));
+				pixel[2] = static_cast<uint8_t>((x ^ y) + ((noise >> 6) & 15));
+				pixel[3] = 255;
+			}
+		return pixels;
+	}
+
+	std::vector<uint8_t> EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height)
+	{
+		size_t rowBytes = static_cast<size_t>(width) * 4;
+		std::vector<uint8_t> filtered;
+		filtered.reserve((rowBytes + 1) * height);
+		std::vector<uint8_t> zeroRow(rowBytes, 0);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const uint8_t* row = rgba + y * rowBytes;
+			const uint8_t* above = y ? row - rowBytes : zeroRow.data();
+			uint8_t filter = static_cast<uint8_t>(y % 5); // None, Sub, Up, Average, Paeth
+			filtered.push_back(filter);
+			for (size_t i = 0; i < rowBytes; i++)
+			{
+				int a = i >= 4 ? row[i - 4] : 0, b = above[i], c = i >= 4 ? above[i - 4] : 0;
+				int predicted = 0;
+				switch (filter)
+				{
+				case 1: predicted = a; break;
+				case 2: predicted = b; break;
+				case 3: predicted = (a + b) / 2; break;
+				case 4: predicted = Paeth(a, b, c); break;
+				}
+				filtered.push_back(static_cast<uint8_t>(row[i] - predicted));
+			}
+		}
+
+		BitWriter deflate;
+		deflate.Bytes.reserve(filtered.size() + filtered.size() / 8 + 16);
+		deflate.Put(0x78, 8); // zlib header, 32K window, no dictionary
+		deflate.Put(0x01, 8);
+		deflate.Put(1, 1); // Last block
+		deflate.Put(1, 2); // Fixed Huffman
+		for (uint8_t byte : filtered)
+		{
+			if (byte < 144)
+				deflate.PutCode(0x30 + byte, 8);
+			else
+				deflate.PutCode(0x190 + (byte - 144), 9);
+		}
+		deflate.PutCode(0, 7); // End of block
+		deflate.Flush();
+		uint32_t a = 1, b = 0; // Adler-32 of the uncompressed data
+		for (uint8_t byte : filtered)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		PutU32BE(deflate.Bytes, (b << 16) | a);
+
+		std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		std::vector<uint8_t> header;
+		PutU32BE(header, width);
+		PutU32BE(header, height);
+		header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, no interlacing
+		PutChunk(png, "IHDR", header);
+		PutChunk(png, "IDAT", deflate.Bytes);
+		PutChunk(png, "IEND", {});
+		return png;
+	}
+}
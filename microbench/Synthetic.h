@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+
+namespace hyper
+{
+	// Made up inputs for the micro-benchmarks, same seed gives the same bytes so runs can be compared
+	struct SyntheticMesh
+	{
+		std::vector<float> Positions; // xyz
+		std::vector<float> Normals; // xyz
+		std::vector<float> TexCoords; // uv
+		std::vector<uint32_t> Indices;
+
+		size_t VertexCount() const { return Positions.size() / 3; }
+	};
+
+	// side x side vertex grid with some hills in it, triangles shuffled the way an exporter that doesn't care leaves them
+	SyntheticMesh MakeGridMesh(uint32_t side, uint32_t seed);
+	// Binary glTF with one mesh, POSITION, NORMAL and TEXCOORD_0 plus uint32 indices, what ParseModel reads
+	bool WriteGlb(const std::filesystem::path& path, const SyntheticMesh& mesh);
+
+	// Smooth gradients with noise on top, so neither a filter nor the encoder gets an easy ride
+	std::vector<uint8_t> MakeImageRGBA8(uint32_t width, uint32_t height, uint32_t seed);
+	// PNG with every filter type in turn and literal only fixed Huffman deflate, no matches, so inflate does real Huffman decoding on a file a bit bigger than the pixels
+	std::vector<uint8_t> EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height);
+}
@@ -0,0 +1,390 @@
+#include "MicroBench.h"
+#include "Synthetic.h"
+
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <stb_image.h>
+
+#include "Camera.h"
+#include "Culling.h"
+#include "DrawSort.h"
+#include "File.h"
+#include "Logger.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "Mipmap.h"
+#include "BcEncoder.h"
+
+namespace
+{
+	using namespace hyper;
+
+	class NullBuffer : public std::streambuf // Swallows the logger's output so the terminal isn't what gets timed
+	{
+	protected:
+		int overflow(int c) override { return c; }
+		std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+	};
+
+	std::string Count(size_t count, const char* what)
+	{
+		return std::to_string(count) + " " + what;
+	}
+
+	std::vector<Vertex> ToVertices(const SyntheticMesh& mesh)
+	{
+		std::vector<Vertex> vertices(mesh.VertexCount());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{ // Members one at a time so the padding stays zeroed, welding compares bytes
+			vertices[i].position = { mesh.Positions[i * 3], mesh.Positions[i * 3 + 1], mesh.Positions[i * 3 + 2] };
+			vertices[i].normal = { mesh.Normals[i * 3], mesh.Normals[i * 3 + 1], mesh.Normals[i * 3 + 2] };
+			vertices[i].color = glm::vec4{ 1.0f };
+			vertices[i].texCoord = { mesh.TexCoords[i * 2], mesh.TexCoords[i * 2 + 1] };
+		}
+		return vertices;
+	}
+
+	uint32_t GridSide(const MicroBench& bench)
+	{
+		return std::max(2u, static_cast<uint32_t>(std::sqrt(static_cast<double>(bench.Scaled(256 * 256)))));
+	}
+
+	// ParseModel is all of LoadModel that happens before the upload, accessor iteration, vertex building and the optimizer
+	void BenchModel(MicroBench& bench, const std::filesystem::path& directory)
+	{
+		SyntheticMesh grid = MakeGridMesh(GridSide(bench), 1);
+		std::filesystem::path path = directory / "grid.glb";
+		if (!WriteGlb(path, grid))
+		{
+			std::cerr << "Couldn't write " << path.string() << ", skipping the glTF cases" << std::endl;
+			return;
+		}
+		std::string input = Count(grid.VertexCount(), "vertices");
+		std::vector<MeshData> meshes;
+		bench.Run("gltf/parse", input, grid.VertexCount(), 0, [&]()
+			{
+				meshes.clear();
+				ParseModel(path, meshes, MeshOptimizeSettings::None());
+			});
+		bench.Run("gltf/parse_optimized", input, grid.VertexCount(), 0, [&]()
+			{
+				meshes.clear();
+				ParseModel(path, meshes);
+			});
+	}
+
+	void BenchCamera(MicroBench& bench)
+	{
+		std::vector<Camera> cameras(bench.Scaled(1024));
+		for (size_t i = 0; i < cameras.size(); i++) // All different, so nothing can be hoisted out of the loop
+		{
+			cameras[i].position = glm::vec3(i * 0.1f, 1.0f, -(i * 0.2f));
+			cameras[i].yaw = i * 0.01f;
+			cameras[i].pitch = std::sin(i * 0.1f);
+		}
+		std::string input = Count(cameras.size(), "cameras");
+		bench.Run("camera/view_matrix", input, cameras.size(), 0, [&]()
+			{
+				for (const Camera& camera : cameras)
+					KeepAlive(camera.GetViewMatrix());
+			});
+		bench.Run("camera/rotation_matrix", input, cameras.size(), 0, [&]()
+			{
+				for (const Camera& camera : cameras)
+					KeepAlive(camera.GetRotationMatrix());
+			});
+	}
+
+	void BenchLogger(MicroBench& bench)
+	{
+		Logger& logger = *Logger::logger;
+		bench.Run("logger/timestamp", "1 timestamp", 1, 0, [&]()
+			{
+				KeepAlive(logger.getCurrentTimestamp());
+			});
+
+		// Bursts well under the ring size, so nothing gets dropped, the flush after each one isn't part of the enqueue cases' time
+		constexpr uint32_t Burst = 256;
+		const std::string message = "Uploaded mesh \"grid\" with 65536 vertices and 130050 triangles into the geometry pool";
+		const std::string input = std::to_string(Burst) + " info messages";
+		NullBuffer null;
+		logger.Flush();
+		std::streambuf* out = std::cout.rdbuf(&null);
+		std::streambuf* err = std::cerr.rdbuf(&null);
+		Spec spec;
+		spec.Debug = true;
+		spec.InfoDebug = true;
+		logger.SetDebug(spec);
+		auto timeBurst = [&](const std::function<void()>& log)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for (uint32_t i = 0; i < Burst; i++)
+					log();
+				double time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+				logger.Flush();
+				return time;
+			};
+		bench.RunTimed("logger/log", input, Burst, 0, [&]() { return timeBurst([&]() { logger.Log(message, Severity::Info); }); });
+		bench.RunTimed("logger/log_format", input, Burst, 0, [&]()
+			{
+				return timeBurst([&]() { HYPER_LOG(Severity::Info, "Uploaded mesh \"{}\" with {} vertices and {} triangles into the geometry pool", "grid", 65536, 130050); });
+			});
+		bench.Run("logger/log_and_write", input, Burst, 0, [&]() // The whole trip, formatting and writing included
+			{
+				for (uint32_t i = 0; i < Burst; i++)
+					logger.Log(message, Severity::Info);
+				logger.Flush();
+			});
+		spec.Debug = false;
+		logger.SetDebug(spec);
+		bench.Run("logger/log_disabled", "1 info message", 1, 0, [&]() { logger.Log(message, Severity::Info); });
+		logger.Flush();
+		std::cout.rdbuf(out);
+		std::cerr.rdbuf(err);
+	}
+
+	void BenchFile(MicroBench& bench, const std::filesystem::path& directory)
+	{
+		size_t size = bench.Scaled(16 * 1024 * 1024);
+		std::filesystem::path path = directory / "file.bin";
+		{
+			std::vector<char> bytes(size);
+			std::mt19937 random(2);
+			for (char& byte : bytes)
+				byte = static_cast<char>(random());
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(bytes.data(), bytes.size());
+		}
+		std::string input = Count(size >> 10, "KiB"); // Warm page cache, this is the copy and allocation cost, not the disk
+		bench.Run("file/read_file", input, 0, size, [&]()
+			{
+				KeepAlive(readFile(path.string()));
+			});
+		bench.Run("file/map_and_touch", input, 0, size, [&]()
+			{
+				MappedFile file;
+				file.Open(path);
+				uint32_t sum = 0;
+				for (size_t i = 0; i < file.GetSize(); i += 4096)
+					sum += file.GetData()[i];
+				KeepAlive(sum);
+			});
+	}
+
+	void BenchImage(MicroBench& bench)
+	{
+		uint32_t width = 1024, height = static_cast<uint32_t>(bench.Scaled(1024));
+		std::vector<uint8_t> pixels = MakeImageRGBA8(width, height, 3);
+		std::vector<uint8_t> png = EncodePng(pixels.data(), width, height);
+		bench.Run("image/png_decode", std::to_string(width) + "x" + std::to_string(height), 0, pixels.size(), [&]()
+			{
+				int x, y, channels;
+				stbi_uc* decoded = stbi_load_from_memory(png.data(), static_cast<int>(png.size()), &x, &y, &channels, STBI_rgb_alpha);
+				KeepAlive(decoded);
+				stbi_image_free(decoded);
+			});
+
+		std::vector<char> jpg = readFile("res/texture/texture.jpg"); // The one real texture, fixed size, only there when run from the repository root
+		if (jpg.empty())
+			return;
+		int width2, height2, channels2;
+		if (!stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(jpg.data()), static_cast<int>(jpg.size()), &width2, &height2, &channels2))
+			return;
+		bench.Run("image/jpg_decode", "res/texture/texture.jpg", 0, static_cast<uint64_t>(width2) * height2 * 4, [&]()
+			{
+				int x, y, channels;
+				stbi_uc* decoded = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(jpg.data()), static_cast<int>(jpg.size()), &x, &y, &channels, STBI_rgb_alpha);
+				KeepAlive(decoded);
+				stbi_image_free(decoded);
+			});
+	}
+
+	void BenchCulling(MicroBench& bench)
+	{
+		size_t count = bench.Scaled(1 << 20);
+		CullBounds bounds;
+		bounds.Resize(count);
+		std::mt19937 random(4);
+		auto unit = [&]() { return static_cast<float>(random()) / static_cast<float>(std::mt19937::max()); };
+		for (size_t i = 0; i < count; i++) // A box around the camera, only what is in front of it is in view
+			bounds.Set(i, glm::vec3(unit() * 400.0f - 200.0f, unit() * 100.0f - 50.0f, unit() * 400.0f - 200.0f), 0.5f + unit() * 4.0f);
+		glm::mat4 viewProjection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+			* glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		Frustum frustum = ExtractFrustum(viewProjection);
+		std::vector<uint8_t> visible(count);
+		bench.Run("cull/spheres", Count(count, "spheres"), count, 0, [&]()
+			{
+				KeepAlive(CullSpheres(frustum, bounds, 0, count, visible.data()));
+			});
+	}
+
+	void BenchSort(MicroBench& bench)
+	{
+		size_t count = bench.Scaled(1 << 18);
+		std::vector<uint64_t> keys(count), tempKeys;
+		std::vector<uint32_t> values(count), tempValues;
+		std::mt19937 random(5);
+		for (size_t i = 0; i < count; i++) // A scene's worth of shaders and materials, every draw its own surface and depth
+		{
+			keys[i] = SortKey::Make(SortKey::Opaque, random() % 8, random() % 512, static_cast<uint32_t>(i), random() & ((1u << SortKey::DepthBits) - 1));
+			values[i] = static_cast<uint32_t>(i);
+		}
+		// LSD radix does the same work whatever order the keys come in, so sorting what the last iteration already sorted is fine
+		bench.Run("sort/radix", Count(count, "keys"), count, 0, [&]()
+			{
+				RadixSort(keys, values, tempKeys, tempValues);
+			});
+	}
+
+	void BenchMeshOptimizer(MicroBench& bench)
+	{
+		SyntheticMesh grid = MakeGridMesh(GridSide(bench), 6);
+		std::vector<Vertex> vertices = ToVertices(grid);
+		const std::vector<uint32_t>& indices = grid.Indices;
+		std::string input = Count(indices.size() / 3, "triangles");
+		size_t triangles = indices.size() / 3;
+		MeshOptimizeSettings defaults;
+
+		bench.Run("mesh/analyze_vertex_cache", input, triangles, 0, [&]()
+			{
+				KeepAlive(AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), defaults.CacheSize));
+			});
+
+		std::vector<Vertex> soup(indices.size()); // Unindexed, like a glTF without indices, every shared vertex is a duplicate
+		for (size_t i = 0; i < indices.size(); i++)
+			soup[i] = vertices[indices[i]];
+		std::vector<uint32_t> remap;
+		bench.Run("mesh/vertex_remap", Count(soup.size(), "vertices"), soup.size(), 0, [&]()
+			{
+				KeepAlive(GenerateVertexRemap(remap, soup.data(), soup.size(), sizeof(Vertex)));
+			});
+
+		std::vector<uint32_t> work(indices.size()); // The passes work in place, copying the input back in each time is a small part of it
+		bench.Run("mesh/optimize_vertex_cache", input, triangles, 0, [&]()
+			{
+				work.assign(indices.begin(), indices.end());
+				KeepAlive(OptimizeVertexCache(work.data(), work.size(), vertices.size(), defaults.CacheSize));
+			});
+
+		std::vector<uint32_t> cacheOptimized = indices;
+		std::vector<uint32_t> clusters = OptimizeVertexCache(cacheOptimized.data(), cacheOptimized.size(), vertices.size(), defaults.CacheSize);
+		bench.Run("mesh/optimize_overdraw", input, triangles, 0, [&]()
+			{
+				work.assign(cacheOptimized.begin(), cacheOptimized.end());
+				OptimizeOverdraw(work.data(), work.size(), &vertices[0].position.x, vertices.size(), sizeof(Vertex), clusters, defaults.CacheSize,
+					defaults.OverdrawThreshold);
+			});
+
+		std::vector<Vertex> fetched(vertices.size());
+		bench.Run("mesh/optimize_vertex_fetch", Count(vertices.size(), "vertices"), vertices.size(), 0, [&]()
+			{
+				work.assign(cacheOptimized.begin(), cacheOptimized.end());
+				KeepAlive(OptimizeVertexFetch(fetched.data(), work.data(), work.size(), vertices.data(), vertices.size(), sizeof(Vertex)));
+			});
+	}
+
+	void BenchTexture(MicroBench& bench)
+	{
+		uint32_t width = 1024, height = static_cast<uint32_t>(bench.Scaled(1024));
+		std::vector<uint8_t> pixels = MakeImageRGBA8(width, height, 7);
+		std::string input = std::to_string(width) + "x" + std::to_string(height);
+		bench.Run("texture/mips_box", input, 0, pixels.size(), [&]()
+			{
+				KeepAlive(GenerateMipChain(pixels.data(), width, height, MipFilter::Box, false));
+			});
+		bench.Run("texture/mips_kaiser_srgb", input, 0, pixels.size(), [&]()
+			{
+				KeepAlive(GenerateMipChain(pixels.data(), width, height, MipFilter::Kaiser, true));
+			});
+		bench.Run("texture/bc1", input, 0, pixels.size(), [&]() // Single threaded, the pool would only measure the core count
+			{
+				KeepAlive(CompressRGBA8(pixels.data(), width, height, BcFormat::BC1));
+			});
+		bench.Run("texture/bc7", input, 0, pixels.size(), [&]()
+			{
+				KeepAlive(CompressRGBA8(pixels.data(), width, height, BcFormat::BC7));
+			});
+	}
+
+	bool ParseNumber(const std::string& text, double& value)
+	{
+		char* end = nullptr;
+		value = std::strtod(text.c_str(), &end);
+		return !text.empty() && end == text.c_str() + text.size() && value > 0.0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	hyper::MicroBenchSettings settings{};
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Usage: hyper-microbench [--scale n] [--filter name] [--min-time seconds] [--out results.json]\n";
+			return 2;
+		}
+		std::string value = argv[++i];
+		bool ok = true;
+		if (option == "--scale")
+			ok = ParseNumber(value, settings.Scale);
+		else if (option == "--min-time")
+			ok = ParseNumber(value, settings.MinSeconds);
+		else if (option == "--filter")
+			settings.Filter = value;
+		else if (option == "--out")
+			settings.OutputPath = value;
+		else
+		{
+			std::cerr << "Unknown option " << option << "\n";
+			return 2;
+		}
+		if (!ok)
+		{
+			std::cerr << option << " needs a number above 0, got \"" << value << "\"\n";
+			return 2;
+		}
+	}
+
+	hyper::Logger* logger = new hyper::Logger(); // Debug off, anything the engine logs mid-case would end up in the timings
+
+	std::error_code error;
+	std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "hyper-microbench";
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		std::cerr << "Couldn't make a scratch directory at " << directory.string() << ": " << error.message() << "\n";
+		return 1;
+	}
+
+	hyper::MicroBench bench(settings);
+	BenchModel(bench, directory);
+	BenchCamera(bench);
+	BenchLogger(bench);
+	BenchFile(bench, directory);
+	BenchImage(bench);
+	BenchCulling(bench);
+	BenchSort(bench);
+	BenchMeshOptimizer(bench);
+	BenchTexture(bench);
+	std::filesystem::remove_all(directory, error);
+
+	delete logger;
+
+	if (bench.GetResults().empty())
+	{
+		std::cerr << "No cases matched \"" << settings.Filter << "\"\n";
+		return 1;
+	}
+	if (!bench.WriteJson())
+		return 1;
+	std::cout << "Written to " << settings.OutputPath.string() << std::endl;
+	return 0;
+}
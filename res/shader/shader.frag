@@ -1,6 +1,19 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D texSampler;
+layout(set = 0, binding = 1) uniform texture2D textures[]; // Bindless texture and sampler arrays
+layout(set = 0, binding = 2) uniform sampler samplers[];
+
+layout(push_constant) uniform PushConstants {
+	vec4 positionOffset; // Only used by the vertex shader, has to be here so the offsets line up
+	vec4 positionScale;
+	uvec2 vertexBuffer;
+	uvec2 uniforms;
+	uvec2 instances;
+	float snapFactor;
+	uint textureIndex;
+	uint samplerIndex;
+} pc;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -8,5 +21,5 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);// + vec4(fragColor, 1.0);
+    outColor = texture(sampler2D(textures[nonuniformEXT(pc.textureIndex)], samplers[nonuniformEXT(pc.samplerIndex)]), fragTexCoord);// + vec4(fragColor, 1.0);
 }
\ No newline at end of file
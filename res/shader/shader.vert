@@ -8,22 +8,46 @@ struct Vertex {
 	vec2 uv;
 };
 
+struct PackedVertex { // 16 bytes, see hyper::PackedVertex
+	uint positionXY;		// Unorm16 x2
+	uint positionZNormal;	// Unorm16 z, then the octahedral normal as snorm8 x2
+	uint color;				// Unorm8 x4
+	uint uv;				// Half x2
+};
+
 layout(buffer_reference, std430) readonly buffer VertexBuffer { 
 	Vertex vertices[];
 };
+layout(buffer_reference, std430) readonly buffer PackedVertexBuffer {
+	PackedVertex vertices[];
+};
 
-layout(binding = 0) uniform UniformBufferObject {
-	mat4 model;
+// Both come out of hyper::FrameAllocator, fresh every frame, so they're addresses rather than bindless indices
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer UniformBufferObject {
 	mat4 view;
 	mat4 proj;
-} ubo;
+};
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer InstanceBuffer {
+	mat4 transforms[];
+};
+
+// One variant per combination gets built by hyper::ShaderVariants, the ids are hyper::ShaderFeature's bits
+layout(constant_id = 0) const bool SNAP_VERTICES = false;
+layout(constant_id = 1) const bool PACKED_VERTICES = false; // PackedVertex instead of Vertex
 
 layout(push_constant) uniform PushConstants {
+	vec4 positionOffset;
+	vec4 positionScale;
 	VertexBuffer vertexBuffer;
-	bool shouldSnap;
+	UniformBufferObject uniforms;
+	InstanceBuffer instances;
 	float snapFactor;
+	uint textureIndex;
+	uint samplerIndex;
 } pc;
 
+#define ubo pc.uniforms
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
@@ -31,12 +55,33 @@ layout(location = 2) in vec2 inTexCoord;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
+vec3 octahedralDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
+
+Vertex fetchVertex(uint index) {
+	if (!PACKED_VERTICES)
+		return pc.vertexBuffer.vertices[index];
+
+	PackedVertex p = PackedVertexBuffer(pc.vertexBuffer).vertices[index];
+	Vertex v;
+	v.position = pc.positionOffset.xyz + vec3(unpackUnorm2x16(p.positionXY), unpackUnorm2x16(p.positionZNormal).x) * pc.positionScale.xyz;
+	v.normal = octahedralDecode(unpackSnorm4x8(p.positionZNormal).zw);
+	v.color = unpackUnorm4x8(p.color);
+	v.uv = unpackHalf2x16(p.uv);
+	return v;
+}
+
 void main() {
-	Vertex v = pc.vertexBuffer.vertices[gl_VertexIndex];
+	Vertex v = fetchVertex(gl_VertexIndex);
+	mat4 model = pc.instances.transforms[gl_InstanceIndex]; // Includes firstInstance, so it's the draw list index
 	
-	gl_Position = pc.shouldSnap
-		? ubo.proj * ubo.view * round(ubo.model * vec4(v.position, 1.0)*pc.snapFactor)/pc.snapFactor
-		: ubo.proj * ubo.view * ubo.model * vec4(v.position, 1.0);
+	gl_Position = SNAP_VERTICES
+		? ubo.proj * ubo.view * round(model * vec4(v.position, 1.0)*pc.snapFactor)/pc.snapFactor
+		: ubo.proj * ubo.view * model * vec4(v.position, 1.0);
 
 	fragColor = v.color.rgb;
 	fragTexCoord = v.uv;
@@ -48,7 +48,11 @@ namespace hyper
 	{
 		while (!glfwWindowShouldClose(m_Window))
 		{
-			glfwPollEvents();
+			Profiler::profiler->BeginFrame();
+			{
+				HYPER_PROFILE_SCOPE("Poll events");
+				glfwPollEvents();
+			}
 
 			double currentTime = glfwGetTime();
 			frameCount++;
@@ -62,6 +66,7 @@ namespace hyper
 			if (userActions.Keys[GLFW_KEY_ESCAPE].KeyState)
 				glfwSetWindowShouldClose(m_Window, GLFW_TRUE);
 			m_Renderer.DrawFrame(); // Can add more things later, like audio :)
+			Profiler::profiler->EndFrame();
 		}
 	}
 
@@ -0,0 +1,182 @@
+#include "AssetLoader.h"
+
+#include <stb_image.h>
+
+#include "Logger.h"
+#include "Package.h"
+
+namespace hyper
+{
+	namespace
+	{
+		// Only for cooking, the package keeps every level so they're made here on the cpu with the better filter
+		// Loads at runtime go through CreateImagesParallel instead, straight into staging with the mips blitted on the gpu
+		bool DecodeTexture(const TextureSource& source, TextureData& texture)
+		{
+			if (source.Encoded.empty() && source.Path.extension() == ".ktx2")
+				return LoadKtx2(source.Path, texture); // Already has its levels
+			int width, height, channels;
+			stbi_uc* pixels = source.Encoded.empty() ? stbi_load(source.Path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha)
+				: stbi_load_from_memory(source.Encoded.data(), static_cast<int>(source.Encoded.size()), &width, &height, &channels, STBI_rgb_alpha);
+			if (!pixels)
+			{
+				Logger::logger->Log("Failed to decode texture \"" + source.Name + "\": " + stbi_failure_reason(), Severity::Error);
+				return false;
+			}
+			texture.Format = source.Format;
+			if (source.GenerateMipmaps)
+				texture.Chain = GenerateMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), MipFilter::Kaiser, false);
+			else
+				texture.Chain = MipChain{ std::vector<uint8_t>(pixels, pixels + static_cast<size_t>(width) * height * 4),
+					{ MipLevel{ 0, static_cast<uint32_t>(width), static_cast<uint32_t>(height) } } };
+			stbi_image_free(pixels);
+			return true;
+		}
+	}
+
+	void AssetLoader::CreateAssetLoader(VmaAllocator& allocator, vk::Device device, GeometryPool& pool, UploadContext& upload, BindlessTable& bindless,
+		uint32_t threadCount)
+	{
+		m_Allocator = allocator;
+		m_Device = device;
+		m_GeometryPool = &pool;
+		m_Upload = &upload;
+		m_Bindless = &bindless;
+		m_ThreadPool = std::make_unique<ThreadPool>(threadCount);
+	}
+
+	void AssetLoader::DestroyAssetLoader()
+	{
+		for (std::future<void>& task : m_Tasks)
+			task.wait();
+		m_Tasks.clear();
+		for (std::shared_ptr<ModelAsset>& model : m_Models)
+		{
+			m_Upload->Wait(model->UploadTicket);
+			for (std::shared_ptr<MeshAsset>& mesh : model->Meshes)
+				FreeMesh(*m_GeometryPool, *mesh);
+			model->Meshes.clear();
+			for (uint32_t index : model->TextureIndices)
+				m_Bindless->RemoveTexture(index);
+			model->TextureIndices.clear();
+			for (Image& image : model->Images)
+				if (image.Image)
+					DestroyImage(m_Allocator, m_Device, image);
+			model->Images.clear();
+		}
+		m_Models.clear();
+		m_ThreadPool.reset();
+	}
+
+	std::shared_ptr<ModelAsset> AssetLoader::LoadModelAsync(std::filesystem::path filePath, const MeshOptimizeSettings& settings)
+	{
+		std::shared_ptr<ModelAsset> model = std::make_shared<ModelAsset>();
+		model->Path = filePath;
+		model->OptimizeSettings = settings;
+		m_Models.push_back(model);
+
+		m_Tasks.push_back(m_ThreadPool->Submit([this, model]()
+			{
+				bool published = false; // After this the model belongs to the main thread, a throw only loses the package
+				try
+				{
+					// A package that was cooked from exactly this file (and these settings) skips parsing altogether
+					std::filesystem::path packagePath = model->Path;
+					packagePath.replace_extension(".hpkg");
+					uint64_t sourceHash = HashModelSource(model->Path, model->OptimizeSettings);
+					Package package;
+					if (package.Open(packagePath) && package.GetSourceHash() == sourceHash)
+					{
+						for (uint32_t i = 0; i < package.GetMeshCount(); i++)
+							model->Meshes.push_back(UploadMesh(*m_GeometryPool, *m_Upload, package.GetMesh(i))); // Straight from the mapping into staging
+						package.LoadScene(model->SceneGraph);
+						model->Images.resize(package.GetTextureCount());
+						m_ThreadPool->ParallelForEach(package.GetTextureCount(), [&](uint32_t index)
+							{ // Nothing to decode, but the memcpys into staging still go wider
+								PackageTexture texture = package.GetTexture(index);
+								model->Images[index] = CreateImageStaged(m_Allocator, m_Device, *m_Upload, texture.Data, texture.Size, texture.Levels,
+									texture.Format, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled,
+									{ MemoryCategory::Texture, packagePath.string().c_str() });
+							});
+					}
+					else
+					{
+						package.Close();
+						std::vector<MeshData> meshData;
+						std::vector<TextureSource> imageSources;
+						if (!ParseModel(model->Path, meshData, model->OptimizeSettings, &model->SceneGraph, &imageSources))
+						{
+							model->State = AssetState::Failed;
+							return;
+						}
+						for (const MeshData& mesh : meshData)
+							model->Meshes.push_back(UploadMesh(*m_GeometryPool, *m_Upload, mesh));
+
+						// Images decode across the pool (this thread takes a share too) straight into staging, into the same batch as the meshes
+						model->Images = CreateImagesParallel(m_Allocator, m_Device, *m_Upload, *m_ThreadPool, imageSources, vk::ImageUsageFlagBits::eSampled);
+						model->UploadTicket = m_Upload->Flush();
+						Scene scene = sourceHash ? model->SceneGraph : Scene{}; // The main thread owns the model's once it's published
+						model->State = AssetState::Uploading; // Published before cooking so it can be drawn meanwhile, nothing below touches model
+						published = true;
+						if (!sourceHash)
+							return;
+
+						// The package needs every level on the cpu, so cooking decodes again, only the first load (or after the source changes) pays for it
+						std::vector<TextureData> textures(imageSources.size());
+						m_ThreadPool->ParallelForEach(static_cast<uint32_t>(imageSources.size()), [&](uint32_t index)
+							{
+								DecodeTexture(imageSources[index], textures[index]);
+							});
+
+						PackageWriter writer;
+						for (const MeshData& mesh : meshData)
+							writer.AddMesh(mesh);
+						writer.SetScene(scene);
+						bool allDecoded = true;
+						for (size_t i = 0; i < textures.size(); i++)
+						{
+							allDecoded &= !textures[i].Chain.Levels.empty();
+							writer.AddTexture(imageSources[i].Name, textures[i]);
+						}
+						// A missing image would shift every index after it, so a model with a broken one just doesn't get cooked
+						if (allDecoded && writer.Write(packagePath, sourceHash))
+							Logger::logger->Log("Cooked " + packagePath.string());
+						return;
+					}
+					model->UploadTicket = m_Upload->Flush(); // Nothing else is coming for this model, no point waiting for someone else to flush
+					model->State = AssetState::Uploading; // Published last, the main thread doesn't read anything above until it sees this
+				}
+				catch (const std::exception& e)
+				{ // Nobody waits on these futures, so anything left uncaught would leave the model loading forever
+					if (published)
+						HYPER_LOG(Severity::Error, "Failed to cook {}: {}", model->Path, e.what());
+					else
+					{
+						HYPER_LOG(Severity::Error, "Failed to load {}: {}", model->Path, e.what());
+						model->State = AssetState::Failed;
+					}
+				}
+			}));
+		return model;
+	}
+
+	void AssetLoader::Update()
+	{
+		for (std::shared_ptr<ModelAsset>& model : m_Models)
+			if (model->State == AssetState::Uploading && m_Upload->IsComplete(model->UploadTicket))
+			{
+				// Only now, so nothing can sample an image that's still uploading
+				for (const Image& image : model->Images)
+					model->TextureIndices.push_back(image.Image ? m_Bindless->AddTexture(image.ImageView, vk::ImageLayout::eShaderReadOnlyOptimal)
+						: BindlessTable::FallbackIndex);
+				model->State = AssetState::Resident;
+				HYPER_LOG(Severity::Setup, "Model loaded: {} ({} meshes, {} images)", model->Path, model->Meshes.size(), model->Images.size());
+			}
+
+		// Finished tasks don't need their futures anymore
+		m_Tasks.erase(std::remove_if(m_Tasks.begin(), m_Tasks.end(), [](std::future<void>& task)
+			{
+				return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			}), m_Tasks.end());
+	}
+}
\ No newline at end of file
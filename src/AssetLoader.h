@@ -0,0 +1,56 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <future>
+#include <filesystem>
+
+#include "Mesh.h"
+#include "Image.h"
+#include "Upload.h"
+#include "ThreadPool.h"
+#include "Bindless.h"
+
+namespace hyper
+{
+	enum class AssetState
+	{
+		Loading,	// Parsing and building vertices on a worker
+		Uploading,	// Uploads submitted, waiting on the gpu
+		Resident,	// Safe to draw
+		Failed
+	};
+
+	struct ModelAsset // Handle to a model that might still be loading, check State before touching Meshes
+	{
+		std::filesystem::path Path;
+		MeshOptimizeSettings OptimizeSettings;
+		std::atomic<AssetState> State{ AssetState::Loading };
+		std::vector<std::shared_ptr<MeshAsset>> Meshes;
+		Scene SceneGraph; // Node tree from the file, node meshes index into Meshes
+		std::vector<Image> Images; // Same order as the file's images, empty ones failed to decode
+		std::vector<uint32_t> TextureIndices; // Bindless index of each image, added once it's resident, the fallback for ones that failed
+		uint64_t UploadTicket = 0;
+	};
+
+	class AssetLoader
+	{
+	public:
+		void CreateAssetLoader(VmaAllocator& allocator, vk::Device device, GeometryPool& pool, UploadContext& upload, BindlessTable& bindless,
+			uint32_t threadCount);
+		void DestroyAssetLoader(); // Waits for anything still loading, then frees every mesh and image it loaded
+
+		std::shared_ptr<ModelAsset> LoadModelAsync(std::filesystem::path filePath, const MeshOptimizeSettings& settings = {}); // Returns straight away
+		void Update(); // Main thread, once per frame, flips finished uploads over to resident
+
+	private:
+		VmaAllocator m_Allocator{};
+		vk::Device m_Device;
+		GeometryPool* m_GeometryPool = nullptr;
+		UploadContext* m_Upload = nullptr;
+		BindlessTable* m_Bindless = nullptr;
+		std::unique_ptr<ThreadPool> m_ThreadPool; // Separate from the renderer's so a big model can't hold up command recording
+
+		std::vector<std::shared_ptr<ModelAsset>> m_Models;
+		std::vector<std::future<void>> m_Tasks;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,437 @@
+#include "BcEncoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HYPER_BC_SSE
+#endif
+
+namespace hyper
+{
+	namespace
+	{
+		struct Block // Split into channels so 4 texels can be compared against a palette entry at once
+		{
+			alignas(16) float Channels[4][16];
+		};
+
+		Block LoadBlock(const uint8_t* rgba)
+		{
+			Block block;
+			for (uint32_t t = 0; t < 16; t++)
+				for (uint32_t c = 0; c < 4; c++)
+					block.Channels[c][t] = rgba[t * 4 + c];
+			return block;
+		}
+
+		// Picks the closest palette entry for every texel, weights zero out the channels a format doesn't store, returns the total squared error
+		float FindNearest(const Block& block, const float (*palette)[4], uint32_t paletteSize, const float weights[4], uint8_t* indices)
+		{
+			float error = 0.0f;
+#if defined(HYPER_BC_SSE)
+			for (uint32_t t = 0; t < 16; t += 4)
+			{
+				__m128 texel[4];
+				for (uint32_t c = 0; c < 4; c++)
+					texel[c] = _mm_load_ps(&block.Channels[c][t]);
+				__m128 best = _mm_set1_ps(1e30f);
+				__m128i bestIndex = _mm_setzero_si128();
+				for (uint32_t k = 0; k < paletteSize; k++)
+				{
+					__m128 distance = _mm_setzero_ps();
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						__m128 difference = _mm_sub_ps(texel[c], _mm_set1_ps(palette[k][c]));
+						distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(difference, difference), _mm_set1_ps(weights[c])));
+					}
+					__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+					bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(static_cast<int>(k))), _mm_andnot_si128(closer, bestIndex));
+					best = _mm_min_ps(best, distance);
+				}
+				alignas(16) int32_t lanes[4];
+				alignas(16) float lanesError[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+				_mm_store_ps(lanesError, best);
+				for (uint32_t i = 0; i < 4; i++)
+				{
+					indices[t + i] = static_cast<uint8_t>(lanes[i]);
+					error += lanesError[i];
+				}
+			}
+#else
+			for (uint32_t t = 0; t < 16; t++)
+			{
+				float best = 1e30f;
+				for (uint32_t k = 0; k < paletteSize; k++)
+				{
+					float distance = 0.0f;
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						float difference = block.Channels[c][t] - palette[k][c];
+						distance += difference * difference * weights[c];
+					}
+					if (distance < best)
+					{
+						best = distance;
+						indices[t] = static_cast<uint8_t>(k);
+					}
+				}
+				error += best;
+			}
+#endif
+			return error;
+		}
+
+		// Endpoints at either end of the block's principal axis, found with a few rounds of power iteration on the covariance
+		void PrincipalEndpoints(const Block& block, const float weights[4], float e0[4], float e1[4])
+		{
+			float mean[4] = {};
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				for (uint32_t t = 0; t < 16; t++)
+					mean[c] += block.Channels[c][t];
+				mean[c] /= 16.0f;
+			}
+			float covariance[4][4] = {};
+			for (uint32_t t = 0; t < 16; t++)
+				for (uint32_t i = 0; i < 4; i++)
+					for (uint32_t j = 0; j < 4; j++)
+						covariance[i][j] += (block.Channels[i][t] - mean[i]) * (block.Channels[j][t] - mean[j]) * weights[i] * weights[j];
+
+			float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			for (uint32_t iteration = 0; iteration < 8; iteration++)
+			{
+				float next[4] = {};
+				for (uint32_t i = 0; i < 4; i++)
+					for (uint32_t j = 0; j < 4; j++)
+						next[i] += covariance[i][j] * axis[j];
+				float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+				if (length < 1e-6f)
+					break; // Flat block, any axis will do
+				for (uint32_t i = 0; i < 4; i++)
+					axis[i] = next[i] / length;
+			}
+
+			float low = 0.0f, high = 0.0f;
+			for (uint32_t t = 0; t < 16; t++)
+			{
+				float projection = 0.0f;
+				for (uint32_t c = 0; c < 4; c++)
+					projection += (block.Channels[c][t] - mean[c]) * axis[c] * weights[c];
+				low = std::min(low, projection);
+				high = std::max(high, projection);
+			}
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				e0[c] = std::min(std::max(mean[c] + axis[c] * low * weights[c], 0.0f), 255.0f);
+				e1[c] = std::min(std::max(mean[c] + axis[c] * high * weights[c], 0.0f), 255.0f);
+			}
+		}
+
+		// Least squares endpoints for the indices that were just picked, position is where along the line each palette entry sits
+		bool RefitEndpoints(const Block& block, const uint8_t* indices, const float* position, float e0[4], float e1[4])
+		{
+			float a = 0.0f, b = 0.0f, c = 0.0f, rhs0[4] = {}, rhs1[4] = {};
+			for (uint32_t t = 0; t < 16; t++)
+			{
+				float w = position[indices[t]];
+				a += (1.0f - w) * (1.0f - w);
+				b += w * (1.0f - w);
+				c += w * w;
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					rhs0[k] += (1.0f - w) * block.Channels[k][t];
+					rhs1[k] += w * block.Channels[k][t];
+				}
+			}
+			float determinant = a * c - b * b;
+			if (std::abs(determinant) < 1e-6f)
+				return false;
+			for (uint32_t k = 0; k < 4; k++)
+			{
+				e0[k] = std::min(std::max((c * rhs0[k] - b * rhs1[k]) / determinant, 0.0f), 255.0f);
+				e1[k] = std::min(std::max((a * rhs1[k] - b * rhs0[k]) / determinant, 0.0f), 255.0f);
+			}
+			return true;
+		}
+
+		uint16_t Pack565(const float colour[4])
+		{
+			uint32_t r = static_cast<uint32_t>(colour[0] * 31.0f / 255.0f + 0.5f);
+			uint32_t g = static_cast<uint32_t>(colour[1] * 63.0f / 255.0f + 0.5f);
+			uint32_t b = static_cast<uint32_t>(colour[2] * 31.0f / 255.0f + 0.5f);
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		void Unpack565(uint16_t packed, float colour[4])
+		{
+			uint32_t r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+			colour[0] = static_cast<float>((r << 3) | (r >> 2));
+			colour[1] = static_cast<float>((g << 2) | (g >> 4));
+			colour[2] = static_cast<float>((b << 3) | (b >> 2));
+			colour[3] = 0.0f;
+		}
+
+		// Error of one pair of 565 endpoints, always the four colour mode since BC3 can't use anything else
+		float EvaluateBC1(const Block& block, uint16_t& colour0, uint16_t& colour1, uint8_t* indices)
+		{
+			static const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+			if (colour0 < colour1)
+				std::swap(colour0, colour1);
+			float palette[4][4];
+			Unpack565(colour0, palette[0]);
+			Unpack565(colour1, palette[1]);
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+				palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+			}
+			palette[2][3] = palette[3][3] = 0.0f;
+			return FindNearest(block, palette, colour0 == colour1 ? 1 : 4, weights, indices);
+		}
+
+		void EncodeColourBC1(const Block& block, uint8_t* out)
+		{
+			static const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+			static const float position[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			float e0[4], e1[4];
+			PrincipalEndpoints(block, weights, e0, e1);
+			uint16_t colour0 = Pack565(e1), colour1 = Pack565(e0);
+			uint8_t indices[16];
+			float error = EvaluateBC1(block, colour0, colour1, indices);
+
+			if (RefitEndpoints(block, indices, position, e0, e1))
+			{
+				uint16_t refit0 = Pack565(e0), refit1 = Pack565(e1);
+				uint8_t refitIndices[16];
+				if (EvaluateBC1(block, refit0, refit1, refitIndices) < error)
+				{
+					colour0 = refit0;
+					colour1 = refit1;
+					std::memcpy(indices, refitIndices, 16);
+				}
+			}
+
+			uint32_t bits = 0;
+			for (uint32_t t = 0; t < 16; t++)
+				bits |= static_cast<uint32_t>(indices[t]) << (t * 2);
+			std::memcpy(out, &colour0, 2);
+			std::memcpy(out + 2, &colour1, 2);
+			std::memcpy(out + 4, &bits, 4);
+		}
+
+		void EncodeChannelBC4(const Block& block, uint32_t channel, uint8_t* out)
+		{ // Single channel, always the 8 value mode
+			static const float weights[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+			Block single;
+			std::memcpy(single.Channels[0], block.Channels[channel], sizeof(single.Channels[0]));
+			std::memset(single.Channels[1], 0, sizeof(float) * 16 * 3);
+
+			float low = 255.0f, high = 0.0f;
+			for (uint32_t t = 0; t < 16; t++)
+			{
+				low = std::min(low, single.Channels[0][t]);
+				high = std::max(high, single.Channels[0][t]);
+			}
+			uint8_t alpha0 = static_cast<uint8_t>(high), alpha1 = static_cast<uint8_t>(low);
+			float palette[8][4] = {};
+			palette[0][0] = alpha0;
+			palette[1][0] = alpha1;
+			for (uint32_t i = 2; i < 8; i++)
+				palette[i][0] = static_cast<float>(((8 - i) * alpha0 + (i - 1) * alpha1) / 7);
+			uint8_t indices[16];
+			FindNearest(single, palette, alpha0 == alpha1 ? 1 : 8, weights, indices);
+
+			uint64_t bits = 0;
+			for (uint32_t t = 0; t < 16; t++)
+				bits |= static_cast<uint64_t>(indices[t]) << (t * 3);
+			out[0] = alpha0;
+			out[1] = alpha1;
+			for (uint32_t i = 0; i < 6; i++)
+				out[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+		}
+
+		struct BitWriter // Little endian, least significant bit first, which is how BC7 is laid out
+		{
+			uint8_t* Out;
+			uint32_t Position = 0;
+
+			void Write(uint32_t value, uint32_t count)
+			{
+				for (uint32_t i = 0; i < count; i++, Position++)
+					if (value & (1u << i))
+						Out[Position / 8] |= static_cast<uint8_t>(1u << (Position % 8));
+			}
+		};
+
+		// 7 bit endpoint plus a shared p-bit, the p-bit that loses the least precision wins
+		void QuantizeBC7(const float endpoint[4], uint32_t quantized[4], uint32_t& pBit)
+		{
+			float bestError = 1e30f;
+			for (uint32_t p = 0; p < 2; p++)
+			{
+				uint32_t candidate[4];
+				float error = 0.0f;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					int32_t q = static_cast<int32_t>(std::floor((endpoint[c] - p) / 2.0f + 0.5f));
+					candidate[c] = static_cast<uint32_t>(std::min(std::max(q, 0), 127));
+					float restored = static_cast<float>((candidate[c] << 1) | p);
+					error += (restored - endpoint[c]) * (restored - endpoint[c]);
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					pBit = p;
+					std::memcpy(quantized, candidate, sizeof(candidate));
+				}
+			}
+		}
+
+		float EvaluateBC7(const Block& block, const float e0[4], const float e1[4], uint32_t q0[4], uint32_t q1[4], uint32_t& p0, uint32_t& p1,
+			uint8_t* indices)
+		{
+			static const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			static const uint32_t interpolation[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+			QuantizeBC7(e0, q0, p0);
+			QuantizeBC7(e1, q1, p1);
+			float palette[16][4];
+			for (uint32_t i = 0; i < 16; i++)
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t a = (q0[c] << 1) | p0, b = (q1[c] << 1) | p1;
+					palette[i][c] = static_cast<float>(((64 - interpolation[i]) * a + interpolation[i] * b + 32) >> 6);
+				}
+			return FindNearest(block, palette, 16, weights, indices);
+		}
+	}
+
+	uint32_t BcBlockBytes(BcFormat format)
+	{
+		return format == BcFormat::BC1 ? 8 : 16;
+	}
+
+	size_t BcLevelBytes(BcFormat format, uint32_t width, uint32_t height)
+	{
+		return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * BcBlockBytes(format);
+	}
+
+	void EncodeBlockBC1(const uint8_t* rgba, uint8_t* out)
+	{
+		EncodeColourBC1(LoadBlock(rgba), out);
+	}
+
+	void EncodeBlockBC3(const uint8_t* rgba, uint8_t* out)
+	{
+		Block block = LoadBlock(rgba);
+		EncodeChannelBC4(block, 3, out);
+		EncodeColourBC1(block, out + 8);
+	}
+
+	void EncodeBlockBC5(const uint8_t* rgba, uint8_t* out)
+	{
+		Block block = LoadBlock(rgba);
+		EncodeChannelBC4(block, 0, out);
+		EncodeChannelBC4(block, 1, out + 8);
+	}
+
+	void EncodeBlockBC7(const uint8_t* rgba, uint8_t* out)
+	{
+		static const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		static const float position[16] = { 0.0f / 64, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+			34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64 }; // The interpolation weights
+
+		Block block = LoadBlock(rgba);
+		float e0[4], e1[4];
+		PrincipalEndpoints(block, weights, e0, e1);
+		uint32_t q0[4], q1[4], p0 = 0, p1 = 0;
+		uint8_t indices[16];
+		float error = EvaluateBC7(block, e0, e1, q0, q1, p0, p1, indices);
+
+		uint8_t refitIndices[16];
+		std::memcpy(refitIndices, indices, 16);
+		if (RefitEndpoints(block, refitIndices, position, e0, e1))
+		{
+			uint32_t r0[4], r1[4], rp0 = 0, rp1 = 0;
+			if (EvaluateBC7(block, e0, e1, r0, r1, rp0, rp1, refitIndices) < error)
+			{
+				std::memcpy(q0, r0, sizeof(q0));
+				std::memcpy(q1, r1, sizeof(q1));
+				p0 = rp0;
+				p1 = rp1;
+				std::memcpy(indices, refitIndices, 16);
+			}
+		}
+
+		// The first texel's index only gets 3 bits, so its top bit has to be 0, flipping the endpoints flips every index
+		if (indices[0] & 8)
+		{
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+			for (uint8_t& index : indices)
+				index = static_cast<uint8_t>(15 - index);
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter writer{ out };
+		writer.Write(1u << 6, 7); // Mode 6
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			writer.Write(q0[c], 7);
+			writer.Write(q1[c], 7);
+		}
+		writer.Write(p0, 1);
+		writer.Write(p1, 1);
+		writer.Write(indices[0], 3);
+		for (uint32_t t = 1; t < 16; t++)
+			writer.Write(indices[t], 4);
+	}
+
+	std::vector<uint8_t> CompressRGBA8(const uint8_t* pixels, uint32_t width, uint32_t height, BcFormat format, ThreadPool* pool)
+	{
+		uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		uint32_t blockBytes = BcBlockBytes(format);
+		std::vector<uint8_t> output(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+		void (*encode)(const uint8_t*, uint8_t*) = format == BcFormat::BC1 ? EncodeBlockBC1 : format == BcFormat::BC3 ? EncodeBlockBC3
+			: format == BcFormat::BC5 ? EncodeBlockBC5 : EncodeBlockBC7;
+
+		auto compressRows = [&](uint32_t first, uint32_t last)
+			{
+				uint8_t rgba[64];
+				for (uint32_t by = first; by < last; by++)
+					for (uint32_t bx = 0; bx < blocksX; bx++)
+					{
+						for (uint32_t y = 0; y < 4; y++)
+							for (uint32_t x = 0; x < 4; x++)
+							{ // Clamped so blocks hanging off the edge just repeat the last row/column
+								uint32_t px = std::min(bx * 4 + x, width - 1), py = std::min(by * 4 + y, height - 1);
+								std::memcpy(&rgba[(y * 4 + x) * 4], &pixels[(static_cast<size_t>(py) * width + px) * 4], 4);
+							}
+						encode(rgba, &output[(static_cast<size_t>(by) * blocksX + bx) * blockBytes]);
+					}
+			};
+
+		if (pool && blocksY > 1)
+			pool->ParallelFor(blocksY, std::min(pool->GetThreadCount() + 1, blocksY), [&](uint32_t, uint32_t first, uint32_t last) { compressRows(first, last); });
+		else
+			compressRows(0, blocksY);
+		return output;
+	}
+
+	MipChain CompressMipChain(const MipChain& chain, BcFormat format, ThreadPool* pool)
+	{
+		MipChain compressed;
+		for (const MipLevel& level : chain.Levels)
+		{
+			std::vector<uint8_t> blocks = CompressRGBA8(&chain.Data[level.Offset], level.Width, level.Height, format, pool);
+			compressed.Levels.push_back(MipLevel{ compressed.Data.size(), level.Width, level.Height });
+			compressed.Data.insert(compressed.Data.end(), blocks.begin(), blocks.end());
+		}
+		return compressed;
+	}
+}
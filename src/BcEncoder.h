@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Mipmap.h"
+
+namespace hyper
+{
+	class ThreadPool;
+
+	// CPU block compression for cooking textures, not fast enough to run every load, that's what the cooked KTX2 files are for
+	enum class BcFormat
+	{
+		BC1,	// RGB, 8 bytes per 4x4 block, alpha is dropped
+		BC3,	// RGBA, BC1 colour plus a BC4 alpha block, 16 bytes
+		BC5,	// Two channels (RG), two BC4 blocks, for normal maps, 16 bytes
+		BC7		// RGBA, 16 bytes, only mode 6 (one subset, 7 bit endpoints plus p-bits, 4 bit indices) so quality is good rather than great
+	};
+
+	uint32_t BcBlockBytes(BcFormat format);
+	size_t BcLevelBytes(BcFormat format, uint32_t width, uint32_t height); // Partial blocks at the edges count as whole ones
+
+	// rgba is one 4x4 block, 64 bytes row by row, out gets BcBlockBytes of it
+	void EncodeBlockBC1(const uint8_t* rgba, uint8_t* out);
+	void EncodeBlockBC3(const uint8_t* rgba, uint8_t* out);
+	void EncodeBlockBC5(const uint8_t* rgba, uint8_t* out);
+	void EncodeBlockBC7(const uint8_t* rgba, uint8_t* out);
+
+	// Rows of blocks are split across the pool when there is one, partial blocks at the edges are padded by clamping
+	std::vector<uint8_t> CompressRGBA8(const uint8_t* pixels, uint32_t width, uint32_t height, BcFormat format, ThreadPool* pool = nullptr);
+	MipChain CompressMipChain(const MipChain& chain, BcFormat format, ThreadPool* pool = nullptr); // Level sizes stay the same, offsets don't
+}
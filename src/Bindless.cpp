@@ -0,0 +1,120 @@
+#include "Bindless.h"
+
+#include "Logger.h"
+
+namespace hyper
+{
+	void BindlessTable::CreateBindlessTable(vk::Device device, vk::Buffer fallbackBuffer, vk::ImageView fallbackTexture, vk::Sampler fallbackSampler)
+	{
+		m_Device = device;
+
+		// Update after bind so adding something while a frame is in flight is fine, partially bound so the unused slots are too
+		// Kept around after, the shader cache hashes the layout into its keys
+		m_Bindings = {
+			vk::DescriptorSetLayoutBinding{ BufferBinding, vk::DescriptorType::eStorageBuffer, MaxBuffers, vk::ShaderStageFlagBits::eAll },
+			vk::DescriptorSetLayoutBinding{ TextureBinding, vk::DescriptorType::eSampledImage, MaxTextures, vk::ShaderStageFlagBits::eAll },
+			vk::DescriptorSetLayoutBinding{ SamplerBinding, vk::DescriptorType::eSampler, MaxSamplers, vk::ShaderStageFlagBits::eAll } };
+		m_BindingFlags.fill(vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind);
+		m_BindingFlagsInfo = vk::DescriptorSetLayoutBindingFlagsCreateInfo{ static_cast<uint32_t>(m_BindingFlags.size()), m_BindingFlags.data() };
+		m_LayoutInfo = vk::DescriptorSetLayoutCreateInfo{ vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+			static_cast<uint32_t>(m_Bindings.size()), m_Bindings.data(), &m_BindingFlagsInfo };
+		m_Layout = m_Device.createDescriptorSetLayoutUnique(m_LayoutInfo);
+
+		std::array<vk::DescriptorPoolSize, 3> poolSizes{ vk::DescriptorPoolSize{ vk::DescriptorType::eStorageBuffer, MaxBuffers },
+			vk::DescriptorPoolSize{ vk::DescriptorType::eSampledImage, MaxTextures }, vk::DescriptorPoolSize{ vk::DescriptorType::eSampler, MaxSamplers } };
+		m_Pool = m_Device.createDescriptorPoolUnique({ vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind, 1,
+			static_cast<uint32_t>(poolSizes.size()), poolSizes.data() });
+
+		m_Set = m_Device.allocateDescriptorSets({ m_Pool.get(), 1, &m_Layout.get() })[0];
+
+		// The fallbacks, the only time slot 0 gets written
+		WriteBuffer(FallbackIndex, fallbackBuffer, VK_WHOLE_SIZE);
+		WriteTexture(FallbackIndex, fallbackTexture, vk::ImageLayout::eReadOnlyOptimal);
+		WriteSampler(FallbackIndex, fallbackSampler);
+	}
+
+	uint32_t BindlessTable::AddBuffer(vk::Buffer buffer, vk::DeviceSize range)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		uint32_t index = Allocate(m_Buffers, MaxBuffers, "buffer");
+		if (index != FallbackIndex)
+			WriteBuffer(index, buffer, range);
+		return index;
+	}
+
+	uint32_t BindlessTable::AddTexture(vk::ImageView imageView, vk::ImageLayout layout)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		uint32_t index = Allocate(m_Textures, MaxTextures, "texture");
+		if (index != FallbackIndex)
+			WriteTexture(index, imageView, layout);
+		return index;
+	}
+
+	uint32_t BindlessTable::AddSampler(vk::Sampler sampler)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		uint32_t index = Allocate(m_Samplers, MaxSamplers, "sampler");
+		if (index != FallbackIndex)
+			WriteSampler(index, sampler);
+		return index;
+	}
+
+	void BindlessTable::RemoveBuffer(uint32_t index)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (index != FallbackIndex) // Whoever got the fallback never owned it
+			m_Buffers.Free.push_back(index);
+	}
+
+	void BindlessTable::RemoveTexture(uint32_t index)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (index != FallbackIndex)
+			m_Textures.Free.push_back(index);
+	}
+
+	void BindlessTable::RemoveSampler(uint32_t index)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (index != FallbackIndex)
+			m_Samplers.Free.push_back(index);
+	}
+
+	void BindlessTable::WriteBuffer(uint32_t index, vk::Buffer buffer, vk::DeviceSize range)
+	{
+		vk::DescriptorBufferInfo bufferInfo{ buffer, 0, range };
+		m_Device.updateDescriptorSets(vk::WriteDescriptorSet{ m_Set, BufferBinding, index, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfo },
+			nullptr);
+	}
+
+	void BindlessTable::WriteTexture(uint32_t index, vk::ImageView imageView, vk::ImageLayout layout)
+	{
+		vk::DescriptorImageInfo imageInfo{ {}, imageView, layout };
+		m_Device.updateDescriptorSets(vk::WriteDescriptorSet{ m_Set, TextureBinding, index, 1, vk::DescriptorType::eSampledImage, &imageInfo },
+			nullptr);
+	}
+
+	void BindlessTable::WriteSampler(uint32_t index, vk::Sampler sampler)
+	{
+		vk::DescriptorImageInfo imageInfo{ sampler };
+		m_Device.updateDescriptorSets(vk::WriteDescriptorSet{ m_Set, SamplerBinding, index, 1, vk::DescriptorType::eSampler, &imageInfo },
+			nullptr);
+	}
+
+	uint32_t BindlessTable::Allocate(Slots& slots, uint32_t max, const char* name)
+	{
+		if (!slots.Free.empty())
+		{
+			uint32_t index = slots.Free.back();
+			slots.Free.pop_back();
+			return index;
+		}
+		if (slots.Next >= max)
+		{ // The fallback is always valid, so a wrong looking draw is better than a crash
+			HYPER_LOG(Severity::Error, "Bindless table is out of {} slots, using the fallback", name);
+			return FallbackIndex;
+		}
+		return slots.Next++;
+	}
+}
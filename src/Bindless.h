@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+
+namespace hyper
+{
+	// One global descriptor set that everything lives in, shaders get indices into it through push constants
+	// Descriptors are written once when something is added, so nothing has to be updated per frame or per material
+	// Slot 0 of each array is a fallback that's never handed out, running out of slots gets it instead of overwriting someone else's
+	class BindlessTable
+	{
+	public:
+		static constexpr uint32_t BufferBinding = 0, TextureBinding = 1, SamplerBinding = 2; // Has to match the shaders
+		static constexpr uint32_t MaxBuffers = 1024, MaxTextures = 4096, MaxSamplers = 32;
+		static constexpr uint32_t FallbackIndex = 0;
+
+		void CreateBindlessTable(vk::Device device, vk::Buffer fallbackBuffer, vk::ImageView fallbackTexture, vk::Sampler fallbackSampler);
+
+		uint32_t AddBuffer(vk::Buffer buffer, vk::DeviceSize range = VK_WHOLE_SIZE);
+		uint32_t AddTexture(vk::ImageView imageView, vk::ImageLayout layout = vk::ImageLayout::eReadOnlyOptimal);
+		uint32_t AddSampler(vk::Sampler sampler);
+
+		// Only call these once the gpu is done with whatever was in the slot, the index gets handed straight back out, the fallback is ignored
+		void RemoveBuffer(uint32_t index);
+		void RemoveTexture(uint32_t index);
+		void RemoveSampler(uint32_t index);
+
+		vk::DescriptorSetLayout GetLayout() const { return m_Layout.get(); }
+		const vk::DescriptorSetLayoutCreateInfo& GetLayoutInfo() const { return m_LayoutInfo; } // What it was made from, for the shader cache's keys
+		const vk::DescriptorSet& GetSet() const { return m_Set; }
+
+	private:
+		struct Slots // Free list per array, so removed indices get reused before the array grows
+		{
+			uint32_t Next = FallbackIndex + 1;
+			std::vector<uint32_t> Free;
+		};
+		uint32_t Allocate(Slots& slots, uint32_t max, const char* name); // FallbackIndex when it's out, nothing gets written then
+		void WriteBuffer(uint32_t index, vk::Buffer buffer, vk::DeviceSize range);
+		void WriteTexture(uint32_t index, vk::ImageView imageView, vk::ImageLayout layout);
+		void WriteSampler(uint32_t index, vk::Sampler sampler);
+
+		vk::Device m_Device;
+		std::array<vk::DescriptorSetLayoutBinding, 3> m_Bindings;
+		std::array<vk::DescriptorBindingFlags, 3> m_BindingFlags;
+		vk::DescriptorSetLayoutBindingFlagsCreateInfo m_BindingFlagsInfo;
+		vk::DescriptorSetLayoutCreateInfo m_LayoutInfo; // Points at the three above
+		vk::UniqueDescriptorPool m_Pool;
+		vk::UniqueDescriptorSetLayout m_Layout;
+		vk::DescriptorSet m_Set; // Freed with the pool
+
+		std::mutex m_Mutex; // Assets can be loaded off the main thread
+		Slots m_Buffers, m_Textures, m_Samplers;
+	};
+}
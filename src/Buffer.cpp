@@ -1,58 +1,46 @@
 #include "Buffer.h"
 
+#include "Upload.h"
+
 namespace hyper
 {
-	Buffer CreateBuffer(VmaAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+	Buffer CreateBuffer(VmaAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, VmaMemoryUsage memoryUsage, const MemoryTag& tag)
 	{
 		vk::BufferCreateInfo bufferInfo{ {}, size, usage, vk::SharingMode::eExclusive };
 		VmaAllocationCreateInfo allocCreateInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, memoryUsage };
 		Buffer buffer;
 		vmaCreateBuffer(allocator, reinterpret_cast<VkBufferCreateInfo*>(&bufferInfo), &allocCreateInfo,
 			reinterpret_cast<VkBuffer*>(&buffer.Buffer), &buffer.Allocation, &buffer.AllocationInfo);
+		TagAllocation(allocator, buffer.Allocation, tag);
 		return buffer;
 	}
 
-	Buffer CreateBufferStaged(VmaAllocator& allocator, vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, vk::DeviceSize size,
-		vk::BufferUsageFlags usage, const void* data)
+	Buffer CreateBufferStaged(VmaAllocator& allocator, UploadContext& upload, vk::DeviceSize size, vk::BufferUsageFlags usage, const void* data,
+		const MemoryTag& tag)
 	{
-		Buffer buffer = CreateBuffer(allocator, size, usage | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY);
-		Buffer stagingBuffer = CreateBuffer(allocator, size, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY);
-		memcpy(stagingBuffer.AllocationInfo.pMappedData, data, size);
-		CopyBuffer(commandPool, device, deviceQueue, stagingBuffer, buffer, size);
-		DestroyBuffer(allocator, stagingBuffer);
+		Buffer buffer = CreateBuffer(allocator, size, usage | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY, tag);
+		upload.Stage(data, size, [&](vk::CommandBuffer commandBuffer, vk::Buffer staging, vk::DeviceSize offset)
+			{
+				vk::BufferCopy copyRegion{ offset, 0, size };
+				commandBuffer.copyBuffer(staging, buffer.Buffer, 1, &copyRegion);
+				upload.ReleaseBuffer(commandBuffer, buffer.Buffer);
+			});
 		return buffer;
 	}
 
-	void CopyBuffer(vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, Buffer& src, Buffer& dst, vk::DeviceSize size)
-	{
-		vk::UniqueFence fence = device.createFenceUnique({ vk::FenceCreateFlagBits::eSignaled });
-
-		vk::CommandBufferAllocateInfo allocInfo{ commandPool, vk::CommandBufferLevel::ePrimary, 1 };
-		std::vector<vk::UniqueCommandBuffer> commandBuffer = device.allocateCommandBuffersUnique(allocInfo);
-		vk::BufferCopy copyRegion{ 0, 0, size };
-
-		vk::BufferMemoryBarrier2 topBufferMemoryBarrier2{ vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
-			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-			src.Buffer, 0, size };
-		vk::BufferMemoryBarrier2 bottomBufferMemoryBarrier2{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
-			vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-			dst.Buffer, 0, size };
-
-		static_cast<void>(device.resetFences(1, &fence.get()));
-
-		commandBuffer[0]->begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-		commandBuffer[0]->pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 1, &topBufferMemoryBarrier2 });
-		commandBuffer[0]->copyBuffer(src.Buffer, dst.Buffer, 1, &copyRegion);
-		commandBuffer[0]->pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 1, &bottomBufferMemoryBarrier2 });
-		commandBuffer[0]->end();
-		
-		vk::CommandBufferSubmitInfo commandBufferSubmitInfo{ commandBuffer[0].get() };
-		deviceQueue.submit2(vk::SubmitInfo2{ {}, 0, nullptr, 1, &commandBufferSubmitInfo, 0, nullptr }, fence.get());
-		static_cast<void>(device.waitForFences(1, &fence.get(), VK_TRUE, UINT64_MAX));
+	void CopyBuffer(UploadContext& upload, Buffer& src, Buffer& dst, vk::DeviceSize size)
+	{ // The upload context puts one barrier at the end of the batch, so no per-copy barriers here anymore
+		upload.Record([&](vk::CommandBuffer commandBuffer)
+			{
+				vk::BufferCopy copyRegion{ 0, 0, size };
+				commandBuffer.copyBuffer(src.Buffer, dst.Buffer, 1, &copyRegion);
+				upload.ReleaseBuffer(commandBuffer, dst.Buffer);
+			});
 	}
 
 	void DestroyBuffer(VmaAllocator& allocator, Buffer& buffer)
 	{
+		UntagAllocation(allocator, buffer.Allocation);
 		vmaDestroyBuffer(allocator, buffer.Buffer, buffer.Allocation);
 	}
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 #include <vulkan/vulkan.hpp>
 #include <vma/vk_mem_alloc.h>
 
+#include "MemoryTracker.h"
+
 namespace hyper
 {
+	class UploadContext;
+
 	struct Buffer
 	{
 		vk::Buffer Buffer;
@@ -11,9 +15,10 @@ namespace hyper
 		VmaAllocationInfo AllocationInfo = {0};
 	};
 
-	Buffer CreateBuffer(VmaAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, VmaMemoryUsage memoryUsage);
-	Buffer CreateBufferStaged(VmaAllocator& allocator, vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, vk::DeviceSize size,
-		vk::BufferUsageFlags usage, const void* data);
-	void CopyBuffer(vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, Buffer& src, Buffer& dst, vk::DeviceSize size);
+	Buffer CreateBuffer(VmaAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, VmaMemoryUsage memoryUsage, const MemoryTag& tag);
+	// Staged copies go into the upload context's current batch, they're only on the gpu once that batch has been flushed and waited on
+	Buffer CreateBufferStaged(VmaAllocator& allocator, UploadContext& upload, vk::DeviceSize size, vk::BufferUsageFlags usage, const void* data,
+		const MemoryTag& tag);
+	void CopyBuffer(UploadContext& upload, Buffer& src, Buffer& dst, vk::DeviceSize size);
 	void DestroyBuffer(VmaAllocator& allocator, Buffer& buffer);
 }
\ No newline at end of file
@@ -1,6 +1,5 @@
 #pragma once
 #include <GLFW/glfw3.h>
-#define GLM_FORCE_RADIANS
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
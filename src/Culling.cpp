@@ -0,0 +1,98 @@
+#include "Culling.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define HYPER_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HYPER_CULL_SSE
+#endif
+
+namespace hyper
+{
+	Frustum ExtractFrustum(const glm::mat4& viewProjection)
+	{ // Gribb/Hartmann, glm is column major so the rows have to be pulled out by hand
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+			rows[i] = glm::vec4{ viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i] };
+
+		Frustum frustum{ { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] } };
+		for (glm::vec4& plane : frustum.Planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+
+	void CullBounds::Resize(size_t count)
+	{
+		CenterX.resize(count);
+		CenterY.resize(count);
+		CenterZ.resize(count);
+		Radius.resize(count);
+	}
+
+	uint32_t CullSpheres(const Frustum& frustum, const CullBounds& bounds, size_t begin, size_t end, uint8_t* visible)
+	{
+		uint32_t visibleCount = 0;
+		size_t i = begin;
+
+#if defined(HYPER_CULL_AVX)
+		__m256 planes[6][4];
+		for (int p = 0; p < 6; p++)
+			for (int k = 0; k < 4; k++)
+				planes[p][k] = _mm256_set1_ps(frustum.Planes[p][k]);
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(&bounds.CenterX[i]), y = _mm256_loadu_ps(&bounds.CenterY[i]), z = _mm256_loadu_ps(&bounds.CenterZ[i]);
+			__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.Radius[i]));
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+					_mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+			}
+			int mask = _mm256_movemask_ps(inside);
+			for (int k = 0; k < 8; k++)
+			{
+				visible[i + k] = (mask >> k) & 1;
+				visibleCount += (mask >> k) & 1;
+			}
+		}
+#elif defined(HYPER_CULL_SSE)
+		__m128 planes[6][4];
+		for (int p = 0; p < 6; p++)
+			for (int k = 0; k < 4; k++)
+				planes[p][k] = _mm_set1_ps(frustum.Planes[p][k]);
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&bounds.CenterX[i]), y = _mm_loadu_ps(&bounds.CenterY[i]), z = _mm_loadu_ps(&bounds.CenterZ[i]);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.Radius[i]));
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+					_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+			int mask = _mm_movemask_ps(inside);
+			for (int k = 0; k < 4; k++)
+			{
+				visible[i + k] = (mask >> k) & 1;
+				visibleCount += (mask >> k) & 1;
+			}
+		}
+#endif
+
+		for (; i < end; i++) // Whatever's left over
+		{
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.Planes)
+				inside &= plane.x * bounds.CenterX[i] + plane.y * bounds.CenterY[i] + plane.z * bounds.CenterZ[i] + plane.w >= -bounds.Radius[i];
+			visible[i] = inside;
+			visibleCount += inside;
+		}
+		return visibleCount;
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace hyper
+{
+	struct Frustum
+	{
+		glm::vec4 Planes[6]; // Left, right, bottom, top, near, far, normals point inwards and are normalised
+	};
+	// Clip space depth is 0 to 1, same as the GLM_FORCE_DEPTH_ZERO_TO_ONE projection the renderer builds
+	Frustum ExtractFrustum(const glm::mat4& viewProjection);
+
+	struct CullBounds // World space bounding spheres, split into arrays so the kernel can load 4 or 8 of one thing at once
+	{
+		std::vector<float> CenterX, CenterY, CenterZ, Radius;
+
+		void Resize(size_t count);
+		void Set(size_t index, glm::vec3 center, float radius)
+		{
+			CenterX[index] = center.x; CenterY[index] = center.y; CenterZ[index] = center.z; Radius[index] = radius;
+		}
+	};
+
+	// Writes 1 into visible for every sphere in [begin, end) that touches the frustum, 0 otherwise, returns how many were visible
+	// AVX when the compiler has it turned on, SSE2 otherwise, plain C++ on anything that isn't x86
+	uint32_t CullSpheres(const Frustum& frustum, const CullBounds& bounds, size_t begin, size_t end, uint8_t* visible);
+}
@@ -0,0 +1,42 @@
+#include "DrawSort.h"
+
+#include <array>
+
+namespace hyper
+{
+	void RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& tempKeys, std::vector<uint32_t>& tempValues)
+	{
+		size_t count = keys.size();
+		tempKeys.resize(count);
+		tempValues.resize(count);
+
+		// Every histogram in one read of the keys
+		std::array<std::array<uint32_t, 256>, 8> histograms{};
+		for (uint64_t key : keys)
+			for (uint32_t pass = 0; pass < 8; pass++)
+				histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+
+		for (uint32_t pass = 0; pass < 8; pass++)
+		{
+			std::array<uint32_t, 256>& histogram = histograms[pass];
+			if (count == 0 || histogram[(keys[0] >> (pass * 8)) & 0xFF] == count)
+				continue; // Every key has the same byte here, the pass wouldn't move anything
+
+			uint32_t offset = 0;
+			for (uint32_t& bucket : histogram) // Counts into starting offsets
+			{
+				uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t destination = histogram[(keys[i] >> (pass * 8)) & 0xFF]++;
+				tempKeys[destination] = keys[i];
+				tempValues[destination] = values[i];
+			}
+			keys.swap(tempKeys);
+			values.swap(tempValues);
+		}
+	}
+}
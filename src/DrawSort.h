@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace hyper
+{
+	// 64 bit draw sort key, most significant first: pass | shader | material | surface | depth
+	// Sorting by it puts draws that share state next to each other, so the recorder only has to change state where the key does
+	namespace SortKey
+	{
+		constexpr uint32_t PassBits = 2, ShaderBits = 10, MaterialBits = 14, SurfaceBits = 18, DepthBits = 20;
+		constexpr uint32_t DepthShift = 0;
+		constexpr uint32_t SurfaceShift = DepthShift + DepthBits;
+		constexpr uint32_t MaterialShift = SurfaceShift + SurfaceBits;
+		constexpr uint32_t ShaderShift = MaterialShift + MaterialBits;
+		constexpr uint32_t PassShift = ShaderShift + ShaderBits;
+		constexpr uint64_t StateMask = ~((1ull << SurfaceShift) - 1); // Everything but depth, equal state bits means the draws can share a batch
+
+		enum Pass : uint32_t
+		{
+			Opaque = 0,
+			Transparent = 1 // Back to front once there is one, so its depth gets flipped
+		};
+
+		inline uint64_t Make(uint32_t pass, uint32_t shader, uint32_t material, uint32_t surface, uint32_t depth)
+		{ // Ids wrap when they don't fit, which only costs batching, never correctness
+			return (static_cast<uint64_t>(pass & ((1u << PassBits) - 1)) << PassShift)
+				| (static_cast<uint64_t>(shader & ((1u << ShaderBits) - 1)) << ShaderShift)
+				| (static_cast<uint64_t>(material & ((1u << MaterialBits) - 1)) << MaterialShift)
+				| (static_cast<uint64_t>(surface & ((1u << SurfaceBits) - 1)) << SurfaceShift)
+				| (static_cast<uint64_t>(depth & ((1u << DepthBits) - 1)) << DepthShift);
+		}
+
+		// Linear view depth from 0 to farPlane squashed into DepthBits, anything past the far plane clamps
+		inline uint32_t QuantizeDepth(float viewDepth, float farPlane)
+		{
+			float normalised = viewDepth <= 0.0f ? 0.0f : (viewDepth >= farPlane ? 1.0f : viewDepth / farPlane);
+			return static_cast<uint32_t>(normalised * static_cast<float>((1u << DepthBits) - 1));
+		}
+	}
+
+	// LSD radix sort, 8 bits a pass, values get moved along with their keys, the temp vectors are just scratch space to keep around between frames
+	// Passes where every key has the same byte are skipped, which is most of them when only a few bits of the key are in use
+	void RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& tempKeys, std::vector<uint32_t>& tempValues);
+}
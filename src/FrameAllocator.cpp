@@ -0,0 +1,82 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+
+#include "Logger.h"
+
+namespace hyper
+{
+	void FrameAllocator::CreateFrameAllocator(VmaAllocator& allocator, vk::Device device, vk::DeviceSize capacity, vk::DeviceSize alignment)
+	{
+		m_Allocator = allocator;
+		m_Device = device;
+		m_Alignment = alignment;
+		m_Capacity = capacity;
+		m_Buffer = CreateBlock(m_Capacity);
+		m_Address = m_Device.getBufferAddress({ m_Buffer.Buffer });
+		m_Offset.store(0, std::memory_order_relaxed);
+	}
+
+	void FrameAllocator::DestroyFrameAllocator()
+	{
+		for (Buffer& buffer : m_Overflow)
+			DestroyBuffer(m_Allocator, buffer);
+		m_Overflow.clear();
+		DestroyBuffer(m_Allocator, m_Buffer);
+		m_Buffer = Buffer{};
+		m_Capacity = 0;
+	}
+
+	void FrameAllocator::Reset()
+	{
+		for (Buffer& buffer : m_Overflow)
+			DestroyBuffer(m_Allocator, buffer);
+		m_Overflow.clear();
+
+		if (m_OverflowBytes > 0)
+		{ // At least double, so a scene that keeps growing doesn't overflow every few frames
+			vk::DeviceSize capacity = std::max(m_Capacity * 2, m_Capacity + m_OverflowBytes);
+			DestroyBuffer(m_Allocator, m_Buffer);
+			m_Buffer = CreateBlock(capacity);
+			m_Address = m_Device.getBufferAddress({ m_Buffer.Buffer });
+			m_Capacity = capacity;
+			m_OverflowBytes = 0;
+			HYPER_LOG(Severity::Info, "Frame allocator grown to {}KB", capacity / 1024);
+		}
+		m_Offset.store(0, std::memory_order_relaxed);
+	}
+
+	FrameAllocation FrameAllocator::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+	{
+		alignment = std::max(alignment, m_Alignment);
+		vk::DeviceSize offset = m_Offset.load(std::memory_order_relaxed);
+		vk::DeviceSize aligned;
+		do
+		{
+			aligned = (offset + alignment - 1) & ~(alignment - 1);
+			if (aligned + size > m_Capacity)
+				return AllocateOverflow(size);
+		} while (!m_Offset.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed));
+
+		return FrameAllocation{ static_cast<char*>(m_Buffer.AllocationInfo.pMappedData) + aligned, m_Buffer.Buffer, aligned, m_Address + aligned, size };
+	}
+
+	Buffer FrameAllocator::CreateBlock(vk::DeviceSize size)
+	{ // Mapped for good, the cpu writes straight into it and the gpu reads it once, not worth a copy into device local memory
+		return CreateBuffer(m_Allocator, size, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eUniformBuffer
+			| vk::BufferUsageFlagBits::eShaderDeviceAddress, VMA_MEMORY_USAGE_CPU_TO_GPU, { MemoryCategory::Transient, "Frame allocator" });
+	}
+
+	FrameAllocation FrameAllocator::AllocateOverflow(vk::DeviceSize size)
+	{ // Same idea as the upload context's overflow, a one-off buffer that goes away when the slot comes round again
+		Buffer buffer = CreateBlock(std::max<vk::DeviceSize>(size, 1));
+		vk::DeviceAddress address = m_Device.getBufferAddress({ buffer.Buffer });
+
+		std::lock_guard<std::mutex> lock(m_OverflowMutex);
+		if (m_Overflow.empty())
+			HYPER_LOG(Severity::Warning, "Frame allocator is out of its {}KB, the rest of this frame gets its own buffers", m_Capacity / 1024);
+		m_Overflow.push_back(buffer);
+		m_OverflowBytes += size + m_Alignment;
+		return FrameAllocation{ buffer.AllocationInfo.pMappedData, buffer.Buffer, 0, address, size };
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <vulkan/vulkan.hpp>
+#include <vma/vk_mem_alloc.h>
+
+#include "Buffer.h"
+
+namespace hyper
+{
+	struct FrameAllocation // Only valid until the frame slot it came from is reset, so never keep one past the frame
+	{
+		void* Data = nullptr; // Mapped, write straight into it
+		vk::Buffer Buffer;
+		vk::DeviceSize Offset = 0; // Into Buffer, for dynamic offsets
+		vk::DeviceAddress Address = 0; // Already has Offset added, for buffer_reference in shaders
+		vk::DeviceSize Size = 0;
+	};
+
+	// Bump allocator over one persistently mapped host visible buffer, one per frame slot, for per frame, per pass and per draw constants
+	// Allocating is an atomic add, so any thread can do it while recording, and nothing ever needs a descriptor write since shaders get the address
+	// Reset once the slot's fence has been waited on, if a frame didn't fit the rest went into one-off buffers and the next Reset grows to cover it
+	class FrameAllocator
+	{
+	public:
+		// alignment is the least every allocation gets, minUniformBufferOffsetAlignment and the like so offsets work as dynamic offsets too
+		void CreateFrameAllocator(VmaAllocator& allocator, vk::Device device, vk::DeviceSize capacity, vk::DeviceSize alignment);
+		void DestroyFrameAllocator();
+		void Reset(); // Nothing can be allocating while this runs
+
+		FrameAllocation Allocate(vk::DeviceSize size, vk::DeviceSize alignment = 0); // Any thread, alignment has to be a power of two
+		template<typename T>
+		FrameAllocation Push(const T& value) // Copies value in, for a ubo or a handful of per draw constants
+		{
+			FrameAllocation allocation = Allocate(sizeof(T), alignof(T));
+			std::memcpy(allocation.Data, &value, sizeof(T));
+			return allocation;
+		}
+
+		vk::DeviceSize GetUsed() const { return m_Offset.load(std::memory_order_relaxed); } // Not counting overflow
+		vk::DeviceSize GetCapacity() const { return m_Capacity; }
+
+	private:
+		Buffer CreateBlock(vk::DeviceSize size);
+		FrameAllocation AllocateOverflow(vk::DeviceSize size);
+
+		VmaAllocator m_Allocator{};
+		vk::Device m_Device;
+		vk::DeviceSize m_Alignment = 16;
+
+		Buffer m_Buffer;
+		vk::DeviceAddress m_Address = 0;
+		vk::DeviceSize m_Capacity = 0;
+		std::atomic<vk::DeviceSize> m_Offset{ 0 };
+
+		std::mutex m_OverflowMutex; // Only taken once a frame has already run out
+		std::vector<Buffer> m_Overflow;
+		vk::DeviceSize m_OverflowBytes = 0;
+	};
+}
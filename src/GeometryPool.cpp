@@ -0,0 +1,188 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+
+#include "Upload.h"
+#include "Logger.h"
+
+namespace hyper
+{
+	void GeometryPool::CreateGeometryPool(VmaAllocator& allocator, vk::Device device, const std::vector<uint32_t>& queueFamilies, vk::DeviceSize blockSize)
+	{
+		m_Allocator = allocator;
+		m_Device = device;
+		m_QueueFamilies = queueFamilies;
+		std::sort(m_QueueFamilies.begin(), m_QueueFamilies.end());
+		m_QueueFamilies.erase(std::unique(m_QueueFamilies.begin(), m_QueueFamilies.end()), m_QueueFamilies.end());
+		m_BlockSize = blockSize;
+
+		m_Blocks.emplace_back();
+		CreateBlock(m_Blocks.back(), m_BlockSize);
+	}
+
+	void GeometryPool::DestroyGeometryPool()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (Block& block : m_Blocks)
+			if (block.Size)
+				DestroyBuffer(m_Allocator, block.Buffer);
+		m_Blocks.clear();
+	}
+
+	GeometryAllocation GeometryPool::Allocate(vk::DeviceSize size, vk::DeviceSize alignment, uint32_t preferredBlock)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		GeometryAllocation allocation{ ~0u, 0, size };
+		if (size == 0)
+			return allocation;
+
+		if (preferredBlock < m_Blocks.size() && AllocateFrom(m_Blocks[preferredBlock], size, alignment, allocation.Offset))
+		{
+			allocation.Block = preferredBlock;
+			return allocation;
+		}
+		for (uint32_t i = 0; i < m_Blocks.size(); i++)
+			if (AllocateFrom(m_Blocks[i], size, alignment, allocation.Offset))
+			{
+				allocation.Block = i;
+				return allocation;
+			}
+
+		// Nothing fits, reuse a destroyed block's slot before adding a new one
+		uint32_t slot = 0;
+		while (slot < m_Blocks.size() && m_Blocks[slot].Size)
+			slot++;
+		if (slot == m_Blocks.size())
+			m_Blocks.emplace_back();
+		if (!CreateBlock(m_Blocks[slot], std::max(m_BlockSize, size + alignment)) || !AllocateFrom(m_Blocks[slot], size, alignment, allocation.Offset))
+		{
+			HYPER_LOG(Severity::Error, "Geometry pool failed to allocate {} bytes", size);
+			return GeometryAllocation{};
+		}
+		allocation.Block = slot;
+		return allocation;
+	}
+
+	void GeometryPool::Free(const GeometryAllocation& allocation)
+	{
+		if (allocation.Block == ~0u)
+			return;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		Block& block = m_Blocks[allocation.Block];
+		block.Used -= allocation.Size;
+
+		// Merge with whatever free space sits either side, so the free list doesn't end up as lots of tiny gaps
+		Range range{ allocation.Offset, allocation.Size };
+		std::vector<Range>::iterator next = std::lower_bound(block.Free.begin(), block.Free.end(), range.Offset,
+			[](const Range& r, vk::DeviceSize offset) { return r.Offset < offset; });
+		if (next != block.Free.end() && range.Offset + range.Size == next->Offset)
+		{
+			range.Size += next->Size;
+			next = block.Free.erase(next);
+		}
+		if (next != block.Free.begin() && std::prev(next)->Offset + std::prev(next)->Size == range.Offset)
+			std::prev(next)->Size += range.Size;
+		else
+			block.Free.insert(next, range);
+
+		// Give empty overflow blocks back, the first one stays around since something will be loaded into it again
+		if (block.Used == 0 && allocation.Block != 0)
+		{
+			DestroyBuffer(m_Allocator, block.Buffer);
+			block = Block{};
+		}
+	}
+
+	void GeometryPool::Upload(UploadContext& upload, const GeometryAllocation& allocation, const void* data)
+	{
+		if (allocation.Block == ~0u)
+			return;
+		vk::Buffer buffer = GetBuffer(allocation.Block);
+		upload.Stage(data, allocation.Size, [&](vk::CommandBuffer commandBuffer, vk::Buffer staging, vk::DeviceSize offset)
+			{ // Blocks are shared between the queue families, so there's no ownership to release here
+				vk::BufferCopy copyRegion{ offset, allocation.Offset, allocation.Size };
+				commandBuffer.copyBuffer(staging, buffer, 1, &copyRegion);
+			});
+	}
+
+	vk::Buffer GeometryPool::GetBuffer(uint32_t block)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Blocks[block].Buffer.Buffer;
+	}
+
+	vk::DeviceAddress GeometryPool::GetAddress(uint32_t block)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Blocks[block].Address;
+	}
+
+	uint32_t GeometryPool::GetBlockCount()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return static_cast<uint32_t>(std::count_if(m_Blocks.begin(), m_Blocks.end(), [](const Block& block) { return block.Size != 0; }));
+	}
+
+	vk::DeviceSize GeometryPool::GetUsedBytes()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		vk::DeviceSize used = 0;
+		for (const Block& block : m_Blocks)
+			used += block.Used;
+		return used;
+	}
+
+	bool GeometryPool::CreateBlock(Block& block, vk::DeviceSize size)
+	{
+		// Concurrent when uploads come from a separate transfer family, ownership transfers on a buffer the graphics queue is reading from would be a mess
+		vk::BufferCreateInfo bufferInfo{ {}, size, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer
+			| vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferDst,
+			m_QueueFamilies.size() > 1 ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive };
+		if (m_QueueFamilies.size() > 1)
+			bufferInfo.setQueueFamilyIndices(m_QueueFamilies);
+		VmaAllocationCreateInfo allocCreateInfo{ {}, VMA_MEMORY_USAGE_GPU_ONLY };
+		if (vmaCreateBuffer(m_Allocator, reinterpret_cast<VkBufferCreateInfo*>(&bufferInfo), &allocCreateInfo,
+			reinterpret_cast<VkBuffer*>(&block.Buffer.Buffer), &block.Buffer.Allocation, &block.Buffer.AllocationInfo) != VK_SUCCESS)
+			return false;
+		TagAllocation(m_Allocator, block.Buffer.Allocation, { MemoryCategory::Geometry, "Geometry pool block" });
+
+		block.Address = m_Device.getBufferAddress({ block.Buffer.Buffer });
+		block.Size = size;
+		block.Used = 0;
+		block.Free = { Range{ 0, size } };
+		HYPER_LOG(Severity::Setup, "Geometry pool block created: {}MB", size / (1024 * 1024));
+		return true;
+	}
+
+	bool GeometryPool::AllocateFrom(Block& block, vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset)
+	{
+		// Best fit, the smallest gap that still fits leaves the bigger ones for bigger meshes
+		std::vector<Range>::iterator best = block.Free.end();
+		vk::DeviceSize bestLeftover = ~0ull;
+		for (std::vector<Range>::iterator it = block.Free.begin(); it != block.Free.end(); it++)
+		{
+			vk::DeviceSize aligned = (it->Offset + alignment - 1) / alignment * alignment; // Vertex strides aren't always powers of two
+			if (aligned + size > it->Offset + it->Size)
+				continue;
+			vk::DeviceSize leftover = it->Size - size;
+			if (leftover < bestLeftover)
+			{
+				best = it;
+				bestLeftover = leftover;
+			}
+		}
+		if (best == block.Free.end())
+			return false;
+
+		// Split off whatever's left either side, the padding in front stays free so it can merge back later
+		Range range = *best;
+		offset = (range.Offset + alignment - 1) / alignment * alignment;
+		best = block.Free.erase(best);
+		if (offset + size < range.Offset + range.Size)
+			best = block.Free.insert(best, Range{ offset + size, range.Offset + range.Size - offset - size });
+		if (offset > range.Offset)
+			block.Free.insert(best, Range{ range.Offset, offset - range.Offset });
+		block.Used += size;
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+#include <vma/vk_mem_alloc.h>
+
+#include "Buffer.h"
+
+namespace hyper
+{
+	class UploadContext;
+
+	struct GeometryAllocation
+	{
+		uint32_t Block = ~0u; // ~0u means nothing was allocated
+		vk::DeviceSize Offset = 0;
+		vk::DeviceSize Size = 0;
+	};
+
+	// Vertices and indices for every mesh live in a handful of big buffers instead of one allocation each
+	// Each block is usable as both an index buffer and through its device address, so one bind and one base address cover every mesh in it
+	class GeometryPool
+	{
+	public:
+		void CreateGeometryPool(VmaAllocator& allocator, vk::Device device, const std::vector<uint32_t>& queueFamilies, vk::DeviceSize blockSize);
+		void DestroyGeometryPool();
+
+		// Best fit across every block, a new block gets made if nothing fits, preferredBlock is tried first so a mesh can stay in one block
+		GeometryAllocation Allocate(vk::DeviceSize size, vk::DeviceSize alignment, uint32_t preferredBlock = ~0u);
+		void Free(const GeometryAllocation& allocation); // Only once the gpu is done with it, same as the bindless table
+		void Upload(UploadContext& upload, const GeometryAllocation& allocation, const void* data);
+
+		vk::Buffer GetBuffer(uint32_t block);
+		vk::DeviceAddress GetAddress(uint32_t block);
+		uint32_t GetBlockCount();
+		vk::DeviceSize GetUsedBytes();
+
+	private:
+		struct Range
+		{
+			vk::DeviceSize Offset;
+			vk::DeviceSize Size;
+		};
+		struct Block
+		{
+			Buffer Buffer;
+			vk::DeviceAddress Address = 0;
+			vk::DeviceSize Size = 0;
+			vk::DeviceSize Used = 0;
+			std::vector<Range> Free; // Sorted by offset, neighbours get merged on free
+		};
+
+		bool CreateBlock(Block& block, vk::DeviceSize size);
+		bool AllocateFrom(Block& block, vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset);
+
+		VmaAllocator m_Allocator{};
+		vk::Device m_Device;
+		std::vector<uint32_t> m_QueueFamilies;
+		vk::DeviceSize m_BlockSize = 0;
+
+		std::vector<Block> m_Blocks; // Emptied blocks are destroyed but keep their slot, so block indices stay valid
+		std::mutex m_Mutex; // Meshes get uploaded from the loader threads
+	};
+}
\ No newline at end of file
@@ -1,22 +1,31 @@
 #include "Image.h"
 
+#include <array>
+#include <algorithm>
+#include <cstring>
 #include <stb_image.h>
 
 #include "Buffer.h"
+#include "Upload.h"
+#include "Ktx.h"
+#include "ThreadPool.h"
+#include "Logger.h"
 
 namespace hyper
 {
 	Image CreateImage(VmaAllocator& allocator, vk::Device& device, vk::Extent2D extent, vk::Format format, vk::ImageTiling tiling,
-		vk::ImageUsageFlags usage, VmaMemoryUsage memoryUsage)
+		vk::ImageUsageFlags usage, VmaMemoryUsage memoryUsage, const MemoryTag& tag, uint32_t mipLevels)
 	{
 		Image image;
 		image.Format = format;
 		image.Extent = extent;
+		image.MipLevels = mipLevels;
 		vk::ImageCreateInfo imageInfo{ {}, vk::ImageType::e2D, format, { extent.width, extent.height, 1 },
-		1, 1, vk::SampleCountFlagBits::e1, tiling, usage, vk::SharingMode::eExclusive };
+		mipLevels, 1, vk::SampleCountFlagBits::e1, tiling, usage, vk::SharingMode::eExclusive };
 		VmaAllocationCreateInfo allocCreateInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, memoryUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT };
 		vmaCreateImage(allocator, reinterpret_cast<VkImageCreateInfo*>(&imageInfo), &allocCreateInfo, reinterpret_cast<VkImage*>(&image.Image),
 			&image.Allocation, &image.AllocationInfo);
+		TagAllocation(allocator, image.Allocation, tag);
 
 		vk::ImageAspectFlags aspectFlag = vk::ImageAspectFlagBits::eColor;
 		if (format == vk::Format::eD32Sfloat)
@@ -24,74 +33,218 @@ namespace hyper
 
 		vk::ImageViewUsageCreateInfo imageViewUsageCreateInfo{ usage };
 		vk::ImageViewCreateInfo imageViewCreateInfo{ {}, image.Image, vk::ImageViewType::e2D, format, {},
-		{ aspectFlag, 0, 1, 0, 1 }, &imageViewUsageCreateInfo };
+		{ aspectFlag, 0, mipLevels, 0, 1 }, &imageViewUsageCreateInfo };
 
 		image.ImageView = device.createImageView(imageViewCreateInfo);
 		return image;
 	}
 
-	Image CreateImageStaged(VmaAllocator& allocator, vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, vk::Extent2D extent,
-		const void* data, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage)
+	namespace
 	{
-		Buffer buffer = CreateBuffer(allocator, extent.width * extent.height * 4, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		memcpy(buffer.AllocationInfo.pMappedData, data, extent.width * extent.height * 4);
-		Image image = CreateImage(allocator, device, extent, format, tiling, usage | vk::ImageUsageFlagBits::eTransferDst,
-			VMA_MEMORY_USAGE_GPU_ONLY);
-		CopyImage(commandPool, device, deviceQueue, buffer.Buffer, extent, image.Image);
-		DestroyBuffer(allocator, buffer);
-		return image;
+		// Whatever's in the staging memory becomes level 0, the rest get blitted if generateMipmaps is set
+		Image CreateImageFromStaging(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, StagingAllocation& staging,
+			vk::Extent2D extent, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, const MemoryTag& tag, bool generateMipmaps)
+		{
+			uint32_t mipLevels = generateMipmaps ? MipLevelCount(extent.width, extent.height) : 1;
+			Image image = CreateImage(allocator, device, extent, format, tiling, usage | vk::ImageUsageFlagBits::eTransferDst
+				| (mipLevels > 1 ? vk::ImageUsageFlagBits::eTransferSrc : vk::ImageUsageFlags{}), VMA_MEMORY_USAGE_GPU_ONLY, tag, mipLevels);
+			upload.Commit(staging, [&](vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::DeviceSize offset)
+				{
+					RecordCopyImage(commandBuffer, buffer, offset, extent, image.Image, mipLevels);
+					// With mips it stays in TransferDst, the blits do the transition to ShaderReadOnly
+					upload.ReleaseImage(commandBuffer, image.Image, { vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1 }, vk::ImageLayout::eTransferDstOptimal,
+						mipLevels > 1 ? vk::ImageLayout::eTransferDstOptimal : vk::ImageLayout::eShaderReadOnlyOptimal);
+				});
+			if (mipLevels > 1)
+			{
+				vk::Image handle = image.Image;
+				upload.RecordGraphics([handle, extent, mipLevels](vk::CommandBuffer commandBuffer) { RecordGenerateMipmaps(commandBuffer, handle, extent, mipLevels); });
+			}
+			return image;
+		}
+
+		// Every level is already in the staging memory, at the offsets in levels
+		Image CreateImageFromStaging(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, StagingAllocation& staging,
+			const std::vector<MipLevel>& levels, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, const MemoryTag& tag)
+		{
+			uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+			Image image = CreateImage(allocator, device, { levels[0].Width, levels[0].Height }, format, tiling,
+				usage | vk::ImageUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY, tag, mipLevels);
+			upload.Commit(staging, [&](vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::DeviceSize offset)
+				{ // One copy command for the whole chain
+					vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1 };
+					vk::ImageMemoryBarrier2 topImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eTopOfPipe, vk::AccessFlagBits2::eNone,
+						vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eUndefined,
+						vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image.Image, range };
+					commandBuffer.pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &topImageMemoryBarrier2 });
+
+					std::vector<vk::BufferImageCopy> copyRegions;
+					for (uint32_t level = 0; level < mipLevels; level++)
+						copyRegions.push_back(vk::BufferImageCopy{ offset + levels[level].Offset, 0, 0, { vk::ImageAspectFlagBits::eColor, level, 0, 1 },
+							{ 0, 0, 0 }, { levels[level].Width, levels[level].Height, 1 } });
+					commandBuffer.copyBufferToImage(buffer, image.Image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+					upload.ReleaseImage(commandBuffer, image.Image, range, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+				});
+			return image;
+		}
+	}
+
+	Image CreateImageStaged(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, vk::Extent2D extent, const void* data,
+		vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, const MemoryTag& tag, bool generateMipmaps)
+	{
+		vk::DeviceSize size = static_cast<vk::DeviceSize>(extent.width) * extent.height * 4;
+		StagingAllocation staging = upload.Reserve(size);
+		memcpy(staging.Data, data, size);
+		return CreateImageFromStaging(allocator, device, upload, staging, extent, format, tiling, usage, tag, generateMipmaps);
+	}
+
+	Image CreateImageStaged(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, const MipChain& chain, vk::Format format,
+		vk::ImageTiling tiling, vk::ImageUsageFlags usage, const MemoryTag& tag)
+	{
+		return CreateImageStaged(allocator, device, upload, chain.Data.data(), chain.Data.size(), chain.Levels, format, tiling, usage, tag);
+	}
+
+	Image CreateImageStaged(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, const uint8_t* data, size_t size,
+		const std::vector<MipLevel>& levels, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, const MemoryTag& tag)
+	{
+		StagingAllocation staging = upload.Reserve(size);
+		memcpy(staging.Data, data, size);
+		return CreateImageFromStaging(allocator, device, upload, staging, levels, format, tiling, usage, tag);
+	}
+
+	Image CreateImageTexture(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, std::string path, vk::Format format,
+		vk::ImageTiling tiling, vk::ImageUsageFlags usage, bool generateMipmaps)
+	{
+		TextureSource source;
+		source.Name = path;
+		source.Path = path;
+		source.Format = format;
+		source.GenerateMipmaps = generateMipmaps;
+		return CreateImageFromSource(allocator, device, upload, source, usage, tiling);
+	}
+
+	Image CreateImageKtx(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, std::string path, vk::ImageUsageFlags usage)
+	{
+		TextureSource source;
+		source.Name = path;
+		source.Path = path;
+		return CreateImageFromSource(allocator, device, upload, source, usage);
 	}
 
-	Image CreateImageTexture(VmaAllocator& allocator, vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, std::string path,
-		vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage)
+	Image CreateImageFromSource(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, const TextureSource& source,
+		vk::ImageUsageFlags usage, vk::ImageTiling tiling)
 	{
-		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		vk::DeviceSize size = static_cast<vk::DeviceSize>(texWidth * texHeight * 4);
-		Buffer buffer = CreateBuffer(allocator, size, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		memcpy(buffer.AllocationInfo.pMappedData, pixels, size);
+		if (source.Encoded.empty() && source.Path.extension() == ".ktx2")
+		{ // Level data is read from the file straight into staging memory
+			vk::Format format;
+			std::vector<MipLevel> levels;
+			StagingAllocation staging;
+			if (!LoadKtx2(source.Path, format, levels, [&](size_t size)
+				{
+					staging = upload.Reserve(size);
+					return static_cast<uint8_t*>(staging.Data);
+				}))
+			{
+				if (staging.Data)
+					upload.Cancel(staging);
+				return Image{};
+			}
+			return CreateImageFromStaging(allocator, device, upload, staging, levels, format, tiling, usage,
+				{ MemoryCategory::Texture, source.Name.c_str() });
+		}
+
+		int width, height, channels;
+		stbi_uc* pixels = source.Encoded.empty() ? stbi_load(source.Path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha)
+			: stbi_load_from_memory(source.Encoded.data(), static_cast<int>(source.Encoded.size()), &width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels)
+		{
+			Logger::logger->Log("Failed to decode texture \"" + source.Name + "\": " + stbi_failure_reason(), Severity::Error);
+			return Image{};
+		}
+
+		// stb only decodes into memory it allocates itself, so this is the one copy left, straight into mapped staging memory
+		vk::Extent2D extent{ static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+		vk::DeviceSize size = static_cast<vk::DeviceSize>(width) * height * 4;
+		StagingAllocation staging = upload.Reserve(size);
+		memcpy(staging.Data, pixels, size);
 		stbi_image_free(pixels);
-		Image image = CreateImage(allocator, device, { (uint32_t)texWidth, (uint32_t)texHeight }, format, tiling, usage | vk::ImageUsageFlagBits::eTransferDst,
-			VMA_MEMORY_USAGE_GPU_ONLY);
-		CopyImage(commandPool, device, deviceQueue, buffer.Buffer, { (uint32_t)texWidth, (uint32_t)texHeight }, image.Image);
-		DestroyBuffer(allocator, buffer);
-		return image;
+		return CreateImageFromStaging(allocator, device, upload, staging, extent, source.Format, tiling, usage,
+			{ MemoryCategory::Texture, source.Name.c_str() }, source.GenerateMipmaps);
+	}
+
+	std::vector<Image> CreateImagesParallel(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, ThreadPool& pool,
+		const std::vector<TextureSource>& sources, vk::ImageUsageFlags usage)
+	{
+		std::vector<Image> images(sources.size());
+		pool.ParallelForEach(static_cast<uint32_t>(sources.size()), [&](uint32_t index)
+			{
+				images[index] = CreateImageFromSource(allocator, device, upload, sources[index], usage);
+			});
+		return images;
 	}
 
-	void CopyImage(vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, vk::Buffer& buffer, vk::Extent2D extent, vk::Image& dst)
+	void CopyImage(UploadContext& upload, vk::Buffer& buffer, vk::Extent2D extent, vk::Image& dst)
 	{
-		vk::UniqueFence fence = device.createFenceUnique({ vk::FenceCreateFlagBits::eSignaled });
+		upload.Record([&](vk::CommandBuffer commandBuffer)
+			{
+				RecordCopyImage(commandBuffer, buffer, 0, extent, dst);
+				upload.ReleaseImage(commandBuffer, dst, { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 }, vk::ImageLayout::eTransferDstOptimal,
+					vk::ImageLayout::eShaderReadOnlyOptimal);
+			});
+	}
 
-		vk::CommandBufferAllocateInfo allocInfo{ commandPool, vk::CommandBufferLevel::ePrimary, 1 };
-		std::vector<vk::UniqueCommandBuffer> commandBuffer = device.allocateCommandBuffersUnique(allocInfo);
-		vk::BufferImageCopy copyRegion{ 0, 0, 0, {vk::ImageAspectFlagBits::eColor, 0, 0, 1 }, { 0, 0, 0 },
+	void RecordCopyImage(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::DeviceSize offset, vk::Extent2D extent, vk::Image dst,
+		uint32_t mipLevels)
+	{
+		vk::BufferImageCopy copyRegion{ offset, 0, 0, {vk::ImageAspectFlagBits::eColor, 0, 0, 1 }, { 0, 0, 0 },
 			{ extent.width, extent.height, 1 } };
 
 		vk::ImageMemoryBarrier2 topImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eTopOfPipe, vk::AccessFlagBits2::eNone,
 			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eUndefined,
 			vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dst,
-			vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } };
-		vk::ImageMemoryBarrier2 bottomImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
-			vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderRead, vk::ImageLayout::eTransferDstOptimal,
-			vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dst,
-			vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } };
-
-		static_cast<void>(device.resetFences(1, &fence.get()));
-
-		commandBuffer[0]->begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-		commandBuffer[0]->pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &topImageMemoryBarrier2 });
-		commandBuffer[0]->copyBufferToImage(buffer, dst, vk::ImageLayout::eTransferDstOptimal, 1, &copyRegion);
-		commandBuffer[0]->pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &bottomImageMemoryBarrier2 });
-		commandBuffer[0]->end();
-
-		vk::CommandBufferSubmitInfo commandBufferSubmitInfo{ commandBuffer[0].get() };
-		deviceQueue.submit2(vk::SubmitInfo2{ {}, 0, nullptr, 1, &commandBufferSubmitInfo, 0, nullptr }, fence.get());
-		static_cast<void>(device.waitForFences(1, &fence.get(), VK_TRUE, UINT64_MAX));
+			vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1 } };
+
+		commandBuffer.pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &topImageMemoryBarrier2 });
+		commandBuffer.copyBufferToImage(buffer, dst, vk::ImageLayout::eTransferDstOptimal, 1, &copyRegion);
+	}
+
+	void RecordGenerateMipmaps(vk::CommandBuffer commandBuffer, vk::Image image, vk::Extent2D extent, uint32_t mipLevels)
+	{
+		int32_t width = static_cast<int32_t>(extent.width), height = static_cast<int32_t>(extent.height);
+		for (uint32_t level = 1; level < mipLevels; level++)
+		{
+			// The level above has just been written (copied or blitted), it becomes the source for this one
+			vk::ImageMemoryBarrier2 sourceBarrier{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead, vk::ImageLayout::eTransferDstOptimal,
+				vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image,
+				vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, level - 1, 1, 0, 1 } };
+			commandBuffer.pipelineBarrier2({ {}, 0, nullptr, 0, nullptr, 1, &sourceBarrier });
+
+			int32_t nextWidth = std::max(width / 2, 1), nextHeight = std::max(height / 2, 1);
+			vk::ImageBlit blit{ { vk::ImageAspectFlagBits::eColor, level - 1, 0, 1 }, { vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ width, height, 1 } },
+				{ vk::ImageAspectFlagBits::eColor, level, 0, 1 }, { vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ nextWidth, nextHeight, 1 } } };
+			commandBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, 1, &blit, vk::Filter::eLinear);
+			width = nextWidth;
+			height = nextHeight;
+		}
+
+		// Every level but the last is a blit source by now, so two transitions cover the lot
+		std::array<vk::ImageMemoryBarrier2, 2> readBarriers{
+			vk::ImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead,
+				vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderRead, vk::ImageLayout::eTransferSrcOptimal,
+				vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image,
+				vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, mipLevels - 1, 0, 1 } },
+			vk::ImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderRead, vk::ImageLayout::eTransferDstOptimal,
+				vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image,
+				vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, mipLevels - 1, 1, 0, 1 } } };
+		commandBuffer.pipelineBarrier2({ {}, 0, nullptr, 0, nullptr, static_cast<uint32_t>(readBarriers.size()), readBarriers.data() });
 	}
 
 	void DestroyImage(VmaAllocator& allocator, vk::Device& device, Image& image)
 	{
 		device.destroyImageView(image.ImageView);
+		UntagAllocation(allocator, image.Allocation);
 		vmaDestroyImage(allocator, image.Image, image.Allocation);
 	}
 }
\ No newline at end of file
@@ -1,9 +1,18 @@
 #pragma once
+#include <string>
+#include <vector>
+#include <filesystem>
 #include <vulkan/vulkan.hpp>
 #include <vma/vk_mem_alloc.h>
 
+#include "Mipmap.h"
+#include "MemoryTracker.h"
+
 namespace hyper
 {
+	class UploadContext;
+	class ThreadPool;
+
 	struct Image
 	{
 		vk::Image Image;
@@ -12,15 +21,47 @@ namespace hyper
 		VmaAllocationInfo AllocationInfo = { 0 };
 		vk::Extent2D Extent;
 		vk::Format Format = { vk::Format::eUndefined };
+		uint32_t MipLevels = 1; // The view covers all of them
+	};
+
+	struct TextureSource // An image that hasn't been decoded yet, either a file or the encoded bytes of one (a png embedded in a glb)
+	{
+		std::string Name; // Only for logging
+		std::filesystem::path Path; // .ktx2 is loaded as is, anything else goes through stb_image
+		std::vector<uint8_t> Encoded; // Used instead of Path when it isn't empty
+		vk::Format Format = vk::Format::eR8G8B8A8Unorm; // Ignored for .ktx2, the file has its own
+		bool GenerateMipmaps = true;
 	};
 
 	Image CreateImage(VmaAllocator& allocator, vk::Device& device, vk::Extent2D extent, vk::Format format, vk::ImageTiling tiling,
-	vk::ImageUsageFlags usage, VmaMemoryUsage memoryUsage);
-	Image CreateImageStaged(VmaAllocator& allocator, vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, vk::Extent2D extent,
-		const void* data, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage);
-	Image CreateImageTexture(VmaAllocator& allocator, vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, std::string path,
-		vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage);
-	void CopyImage(vk::CommandPool& commandPool, vk::Device& device, vk::Queue& deviceQueue, vk::Buffer& buffer, vk::Extent2D extent, vk::Image& dst);
+	vk::ImageUsageFlags usage, VmaMemoryUsage memoryUsage, const MemoryTag& tag, uint32_t mipLevels = 1);
+	// Staged images are recorded into the upload context's current batch, flush and wait on it before sampling them
+	// generateMipmaps blits the full chain on the graphics queue, the format has to support linear blits (every RGBA8 format does)
+	Image CreateImageStaged(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, vk::Extent2D extent, const void* data,
+		vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, const MemoryTag& tag, bool generateMipmaps = false);
+	// For chains made ahead of time with GenerateMipChain, every level is copied as is
+	Image CreateImageStaged(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, const MipChain& chain, vk::Format format,
+		vk::ImageTiling tiling, vk::ImageUsageFlags usage, const MemoryTag& tag);
+	// Package textures, data is a chain laid out like levels says (offsets are from data)
+	Image CreateImageStaged(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, const uint8_t* data, size_t size,
+		const std::vector<MipLevel>& levels, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, const MemoryTag& tag);
+	Image CreateImageTexture(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, std::string path, vk::Format format,
+		vk::ImageTiling tiling, vk::ImageUsageFlags usage, bool generateMipmaps = true);
+	// Cooked textures, the stored mips and format (usually BCn) go straight to the gpu, Image is left empty if the file can't be loaded
+	Image CreateImageKtx(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, std::string path, vk::ImageUsageFlags usage);
+	// Decodes (or reads) straight into staging memory from Reserve, safe to call from any thread, Image is left empty if it fails
+	// This and the ones above it are tagged as textures, named after the source
+	Image CreateImageFromSource(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, const TextureSource& source,
+		vk::ImageUsageFlags usage, vk::ImageTiling tiling = vk::ImageTiling::eOptimal);
+	// Every source decoded at once across the pool, all into the upload context's current batch, so one flush covers the lot
+	std::vector<Image> CreateImagesParallel(VmaAllocator& allocator, vk::Device& device, UploadContext& upload, ThreadPool& pool,
+		const std::vector<TextureSource>& sources, vk::ImageUsageFlags usage);
+	void CopyImage(UploadContext& upload, vk::Buffer& buffer, vk::Extent2D extent, vk::Image& dst);
+	// Leaves dst in TransferDstOptimal, every level gets transitioned but only level 0 is written
+	void RecordCopyImage(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::DeviceSize offset, vk::Extent2D extent, vk::Image dst,
+		uint32_t mipLevels = 1);
+	// Expects every level in TransferDstOptimal with level 0 filled in, each level is blitted from the one above and all end up ShaderReadOnlyOptimal
+	void RecordGenerateMipmaps(vk::CommandBuffer commandBuffer, vk::Image image, vk::Extent2D extent, uint32_t mipLevels);
 	void DestroyImage(VmaAllocator& allocator, vk::Device& device, Image& image);
 
 }
\ No newline at end of file
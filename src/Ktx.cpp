@@ -0,0 +1,269 @@
+#include "Ktx.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stb_image.h>
+
+#include "Logger.h"
+
+namespace hyper
+{
+	namespace
+	{
+		const uint8_t Ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		struct Ktx2Header
+		{
+			uint8_t Identifier[12];
+			uint32_t VkFormat;
+			uint32_t TypeSize;
+			uint32_t PixelWidth, PixelHeight, PixelDepth;
+			uint32_t LayerCount, FaceCount, LevelCount;
+			uint32_t SupercompressionScheme;
+			uint32_t DfdByteOffset, DfdByteLength;
+			uint32_t KvdByteOffset, KvdByteLength;
+			uint64_t SgdByteOffset, SgdByteLength;
+		};
+		static_assert(sizeof(Ktx2Header) == 80, "KTX2 header has to match the file exactly");
+
+		struct Ktx2Level
+		{
+			uint64_t ByteOffset, ByteLength, UncompressedByteLength;
+		};
+
+		bool BcFromVkFormat(vk::Format format, BcFormat& bc)
+		{
+			switch (format)
+			{
+			case vk::Format::eBc1RgbUnormBlock: case vk::Format::eBc1RgbSrgbBlock: bc = BcFormat::BC1; return true;
+			case vk::Format::eBc3UnormBlock: case vk::Format::eBc3SrgbBlock: bc = BcFormat::BC3; return true;
+			case vk::Format::eBc5UnormBlock: bc = BcFormat::BC5; return true;
+			case vk::Format::eBc7UnormBlock: case vk::Format::eBc7SrgbBlock: bc = BcFormat::BC7; return true;
+			default: return false;
+			}
+		}
+
+		bool IsSrgb(vk::Format format)
+		{
+			return format == vk::Format::eBc1RgbSrgbBlock || format == vk::Format::eBc3SrgbBlock || format == vk::Format::eBc7SrgbBlock
+				|| format == vk::Format::eR8G8B8A8Srgb;
+		}
+
+		// Basic data format descriptor, the spec requires one, readers mostly only care about vkFormat
+		std::vector<uint32_t> MakeDfd(vk::Format format)
+		{
+			struct Sample { uint32_t BitOffset, BitLength, Channel; };
+			std::vector<Sample> samples;
+			uint32_t colourModel = 1, blockBytes = 4, blockDimension = 0; // RGBSDA for plain RGBA8
+			BcFormat bc;
+			if (BcFromVkFormat(format, bc))
+			{
+				blockBytes = BcBlockBytes(bc);
+				blockDimension = 3 | (3 << 8); // 4x4, stored as size - 1
+				switch (bc)
+				{
+				case BcFormat::BC1: colourModel = 128; samples = { { 0, 64, 0 } }; break;
+				case BcFormat::BC3: colourModel = 130; samples = { { 0, 64, 15 }, { 64, 64, 0 } }; break;
+				case BcFormat::BC5: colourModel = 132; samples = { { 0, 64, 0 }, { 64, 64, 1 } }; break;
+				case BcFormat::BC7: colourModel = 134; samples = { { 0, 128, 0 } }; break;
+				}
+			}
+			else
+				samples = { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, 15 } };
+
+			uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+			std::vector<uint32_t> dfd = { 4 + blockSize, 0, 2 | (blockSize << 16),
+				colourModel | (1 << 8) | ((IsSrgb(format) ? 2u : 1u) << 16), blockDimension, blockBytes, 0 }; // BT709 primaries
+			for (const Sample& sample : samples)
+			{
+				uint32_t channel = sample.Channel;
+				if (IsSrgb(format) && channel == 15)
+					channel |= 0x10; // Alpha is always linear
+				dfd.insert(dfd.end(), { sample.BitOffset | ((sample.BitLength - 1) << 16) | (channel << 24), 0, 0,
+					sample.BitLength >= 32 ? 0xFFFFFFFFu : (1u << sample.BitLength) - 1 });
+			}
+			return dfd;
+		}
+	}
+
+	size_t TextureLevelBytes(vk::Format format, uint32_t width, uint32_t height)
+	{
+		BcFormat bc;
+		if (BcFromVkFormat(format, bc))
+			return BcLevelBytes(bc, width, height);
+		if (format == vk::Format::eR8G8B8A8Unorm || format == vk::Format::eR8G8B8A8Srgb)
+			return static_cast<size_t>(width) * height * 4;
+		return 0;
+	}
+
+	bool LoadKtx2(const std::filesystem::path& path, vk::Format& format, std::vector<MipLevel>& mipLevels,
+		const std::function<uint8_t*(size_t size)>& allocate)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+			return false;
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		file.seekg(0);
+
+		Ktx2Header header;
+		if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| std::memcmp(header.Identifier, Ktx2Identifier, sizeof(Ktx2Identifier)) != 0)
+		{
+			Logger::logger->Log("Not a KTX2 file: " + path.string(), Severity::Error);
+			return false;
+		}
+		if (header.SupercompressionScheme != 0 || header.PixelDepth > 1 || header.LayerCount > 1 || header.FaceCount != 1
+			|| header.PixelWidth == 0 || header.PixelHeight == 0)
+		{
+			Logger::logger->Log("Unsupported KTX2 file (only plain 2D textures are): " + path.string(), Severity::Error);
+			return false;
+		}
+		format = static_cast<vk::Format>(header.VkFormat);
+		if (TextureLevelBytes(format, 1, 1) == 0)
+		{
+			Logger::logger->Log("Unsupported KTX2 vkFormat " + std::to_string(header.VkFormat) + " (only BC1/3/5/7 and RGBA8 are): " + path.string(),
+				Severity::Error);
+			return false;
+		}
+
+		// 0 means the loader is meant to generate them, there's still one level stored, and a chain can't go past 1x1
+		uint32_t levelCount = std::max(header.LevelCount, 1u);
+		if (levelCount > MipLevelCount(header.PixelWidth, header.PixelHeight))
+		{
+			Logger::logger->Log("KTX2 file has " + std::to_string(levelCount) + " levels, more than a " + std::to_string(header.PixelWidth) + "x"
+				+ std::to_string(header.PixelHeight) + " chain can: " + path.string(), Severity::Error);
+			return false;
+		}
+		std::vector<Ktx2Level> levels(levelCount);
+		if (!file.read(reinterpret_cast<char*>(levels.data()), levels.size() * sizeof(Ktx2Level)))
+		{
+			Logger::logger->Log("KTX2 level index runs past the end of the file: " + path.string(), Severity::Error);
+			return false;
+		}
+
+		// Sizes first, so the whole chain can go into one allocation
+		mipLevels.clear();
+		size_t size = 0;
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			const Ktx2Level& entry = levels[level];
+			if (entry.ByteOffset > fileSize || entry.ByteLength > fileSize - entry.ByteOffset) // Written so a huge offset can't wrap round
+			{
+				Logger::logger->Log("KTX2 level " + std::to_string(level) + " runs past the end of the file: " + path.string(), Severity::Error);
+				return false;
+			}
+			MipLevel mip{ size, std::max(header.PixelWidth >> level, 1u), std::max(header.PixelHeight >> level, 1u) };
+			if (entry.ByteLength != TextureLevelBytes(format, mip.Width, mip.Height)) // The copy regions only go off the dimensions
+			{
+				Logger::logger->Log("KTX2 level " + std::to_string(level) + " is " + std::to_string(entry.ByteLength) + " bytes, a " + std::to_string(mip.Width)
+					+ "x" + std::to_string(mip.Height) + " level of its format is " + std::to_string(TextureLevelBytes(format, mip.Width, mip.Height)) + ": "
+					+ path.string(), Severity::Error);
+				return false;
+			}
+			mipLevels.push_back(mip);
+			size += entry.ByteLength;
+		}
+
+		uint8_t* data = allocate(size);
+		if (!data)
+			return false;
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			file.seekg(static_cast<std::streamoff>(levels[level].ByteOffset));
+			file.read(reinterpret_cast<char*>(data + mipLevels[level].Offset), levels[level].ByteLength);
+		}
+		return static_cast<bool>(file);
+	}
+
+	bool LoadKtx2(const std::filesystem::path& path, TextureData& texture)
+	{
+		texture.Chain = {};
+		return LoadKtx2(path, texture.Format, texture.Chain.Levels, [&](size_t size)
+			{
+				texture.Chain.Data.resize(size);
+				return texture.Chain.Data.data();
+			});
+	}
+
+	bool WriteKtx2(const std::filesystem::path& path, const TextureData& texture)
+	{
+		const MipChain& chain = texture.Chain;
+		uint32_t levelCount = static_cast<uint32_t>(chain.Levels.size());
+		std::vector<uint32_t> dfd = MakeDfd(texture.Format);
+		BcFormat bc;
+		bool compressed = BcFromVkFormat(texture.Format, bc);
+		uint64_t alignment = compressed ? BcBlockBytes(bc) : 4; // lcm(texel block size, 4)
+
+		Ktx2Header header{};
+		std::memcpy(header.Identifier, Ktx2Identifier, sizeof(Ktx2Identifier));
+		header.VkFormat = static_cast<uint32_t>(texture.Format);
+		header.TypeSize = 1;
+		header.PixelWidth = chain.Levels[0].Width;
+		header.PixelHeight = chain.Levels[0].Height;
+		header.FaceCount = 1;
+		header.LevelCount = levelCount;
+		header.DfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level));
+		header.DfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+		// Smallest level goes first in the file, the level index still lists level 0 first
+		std::vector<Ktx2Level> levels(levelCount);
+		uint64_t position = header.DfdByteOffset + header.DfdByteLength;
+		for (uint32_t level = levelCount; level-- > 0;)
+		{
+			size_t end = level + 1 < levelCount ? chain.Levels[level + 1].Offset : chain.Data.size(); // Packed in order, so the next level is the end
+			position = (position + alignment - 1) / alignment * alignment;
+			uint64_t size = end - chain.Levels[level].Offset;
+			levels[level] = Ktx2Level{ position, size, size };
+			position += size;
+		}
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			Logger::logger->Log("Couldn't write " + path.string(), Severity::Error);
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(Ktx2Level));
+		file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+		for (uint32_t level = levelCount; level-- > 0;)
+		{
+			static const char padding[16] = {};
+			file.write(padding, static_cast<std::streamsize>(levels[level].ByteOffset - static_cast<uint64_t>(file.tellp())));
+			file.write(reinterpret_cast<const char*>(&chain.Data[chain.Levels[level].Offset]), levels[level].ByteLength);
+		}
+		return static_cast<bool>(file);
+	}
+
+	vk::Format BcVkFormat(BcFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case BcFormat::BC1: return srgb ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc1RgbUnormBlock;
+		case BcFormat::BC3: return srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+		case BcFormat::BC5: return vk::Format::eBc5UnormBlock; // Never colour
+		case BcFormat::BC7: return srgb ? vk::Format::eBc7SrgbBlock : vk::Format::eBc7UnormBlock;
+		}
+		return vk::Format::eUndefined;
+	}
+
+	bool CookTexture(const std::filesystem::path& source, const std::filesystem::path& destination, BcFormat format, bool srgb, ThreadPool* pool)
+	{
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load(source.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels)
+		{
+			Logger::logger->Log("Couldn't load " + source.string() + " to cook it", Severity::Error);
+			return false;
+		}
+		MipChain chain = GenerateMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), MipFilter::Kaiser, srgb);
+		stbi_image_free(pixels);
+
+		TextureData texture{ BcVkFormat(format, srgb), CompressMipChain(chain, format, pool) };
+		if (!WriteKtx2(destination, texture))
+			return false;
+		HYPER_LOG(Severity::Setup, "Cooked {} into {} ({}KB, {} mips)", source, destination, texture.Chain.Data.size() / 1024, texture.Chain.Levels.size());
+		return true;
+	}
+}
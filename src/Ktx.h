@@ -0,0 +1,35 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <vulkan/vulkan.hpp>
+
+#include "Mipmap.h"
+#include "BcEncoder.h"
+
+namespace hyper
+{
+	class ThreadPool;
+
+	struct TextureData // What a texture file holds once it's in memory, levels are tightly packed like MipChain always is
+	{
+		vk::Format Format = vk::Format::eUndefined;
+		MipChain Chain;
+	};
+
+	// Bytes in one tightly packed level, 0 for any format the uploader can't take, which is anything but what CookTexture and the model loader make
+	size_t TextureLevelBytes(vk::Format format, uint32_t width, uint32_t height);
+
+	// KTX2, only the parts we write: 2D, one layer, one face, no supercompression, BC1/3/5/7 or RGBA8
+	// Anything else, or a level index that doesn't fit the file or the dimensions, fails before allocate is called
+	bool LoadKtx2(const std::filesystem::path& path, TextureData& texture);
+	// Same, but the level data goes wherever allocate says (staging memory, usually), levels get offsets from that pointer
+	// allocate is called once with the size of the whole chain, returning nullptr gives up
+	bool LoadKtx2(const std::filesystem::path& path, vk::Format& format, std::vector<MipLevel>& levels,
+		const std::function<uint8_t*(size_t size)>& allocate);
+	bool WriteKtx2(const std::filesystem::path& path, const TextureData& texture);
+
+	vk::Format BcVkFormat(BcFormat format, bool srgb);
+	// Loads anything stb_image can, builds the mip chain, block compresses it and writes it out as KTX2
+	bool CookTexture(const std::filesystem::path& source, const std::filesystem::path& destination, BcFormat format, bool srgb,
+		ThreadPool* pool = nullptr);
+}
@@ -1,13 +1,101 @@
 #include "Logger.h"
 
 #include <iostream>
-#include <iomanip>
 #include <chrono>
+#include <ctime>
+#include <charconv>
+#include <cstdio>
 
 namespace hyper
 {
 	Logger* Logger::logger; // Do not re-declare loggers, it is in big boi space, scary
 
+	namespace
+	{
+		// "2024-01-31 12:34:56.789", cachedSecond and cachedText carry the slow part over between calls in the same second
+		void AppendTimestamp(std::string& out, std::chrono::system_clock::time_point time, int64_t& cachedSecond, std::string& cachedText)
+		{
+			int64_t milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+			int64_t second = milliseconds >= 0 ? milliseconds / 1000 : (milliseconds - 999) / 1000;
+			if (second != cachedSecond)
+			{
+				std::time_t now_time_t = static_cast<std::time_t>(second);
+				struct tm timeInfo;
+#if defined(_WIN32)
+				localtime_s(&timeInfo, &now_time_t);
+#else
+				localtime_r(&now_time_t, &timeInfo); // Same thing, arguments the other way round
+#endif
+				char text[32];
+				cachedText.assign(text, std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &timeInfo));
+				cachedSecond = second;
+			}
+			char fraction[8];
+			out += cachedText;
+			out.append(fraction, std::snprintf(fraction, sizeof(fraction), ".%03d", static_cast<int>(milliseconds - second * 1000)));
+		}
+
+		// Formats the next argument onto the end of out, returns where the one after it starts
+		const uint8_t* AppendArgument(std::string& out, const uint8_t* argument, const uint8_t* end)
+		{
+			if (argument >= end)
+			{
+				out += "{}"; // More placeholders than arguments, leave it be so it's obvious
+				return argument;
+			}
+			LogArgument type = static_cast<LogArgument>(*argument++);
+			auto read = [&](auto& value) { std::memcpy(&value, argument, sizeof(value)); argument += sizeof(value); };
+			char text[32];
+			switch (type)
+			{
+			case LogArgument::Signed:
+			{
+				int64_t value;
+				read(value);
+				out.append(text, std::to_chars(text, text + sizeof(text), value).ptr);
+				break;
+			}
+			case LogArgument::Unsigned:
+			{
+				uint64_t value;
+				read(value);
+				out.append(text, std::to_chars(text, text + sizeof(text), value).ptr);
+				break;
+			}
+			case LogArgument::Float:
+			{
+				double value;
+				read(value);
+				out.append(text, std::snprintf(text, sizeof(text), "%g", value));
+				break;
+			}
+			case LogArgument::Bool:
+			{
+				uint8_t value;
+				read(value);
+				out += value ? "true" : "false";
+				break;
+			}
+			case LogArgument::String:
+			{
+				uint32_t length;
+				read(length);
+				out.append(reinterpret_cast<const char*>(argument), length);
+				argument += length;
+				break;
+			}
+			case LogArgument::Pointer:
+			{
+				uintptr_t value;
+				read(value);
+				out.append(text, std::snprintf(text, sizeof(text), "0x%llx", static_cast<unsigned long long>(value)));
+				break;
+			}
+			}
+			return argument;
+		}
+	}
+
 	static VKAPI_ATTR vk::Bool32 VKAPI_CALL debugCallback(vk::DebugUtilsMessageSeverityFlagBitsEXT messageSeverity, vk::DebugUtilsMessageTypeFlagsEXT messageType,
 		const vk::DebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
 	{
@@ -24,47 +112,202 @@ namespace hyper
 		if (messageSeverity & vk::DebugUtilsMessageSeverityFlagBitsEXT::eError) {
 			severity = Severity::Error;
 		}
-		Logger::logger->Log("validation layer: " + std::string(pCallbackData->pMessage), severity);
+		Logger::logger->LogFormat(severity, "validation layer: {}", pCallbackData->pMessage); // Driver threads can end up here too
 		return vk::False;
 	}
 
+	Logger::Logger()
+	{
+		for (uint32_t i = 0; i < RingSize; i++)
+			m_Ring[i].Sequence.store(i, std::memory_order_relaxed); // Slot i is free for position i, the first time round
+		logger = this;
+		m_Writer = std::thread(&Logger::WriterLoop, this);
+	}
+
+	Logger::~Logger()
+	{
+		m_Stopping.store(true, std::memory_order_release);
+		m_Wake.notify_one();
+		m_Writer.join();
+		if (logger == this)
+			logger = nullptr;
+	}
+
 	std::string Logger::getCurrentTimestamp() const
-	{ // This stuff is re-allocated a lot, I wonder if I should make some static or smth
-		auto now = std::chrono::system_clock::now(); // TBH best case scenario the logger shouldn't be called often ;^)
-		struct tm timeInfo;
-		std::time_t now_time_t = std::chrono::system_clock::to_time_t(now);
-		localtime_s(&timeInfo, &now_time_t);
-		auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
-		std::ostringstream oss;
-		oss << std::put_time(&timeInfo, "%Y-%m-%d %H:%M:%S") << "." << std::setfill('0') << std::setw(3) << milliseconds;
-		return oss.str();
+	{
+		std::string timestamp;
+		int64_t second = -1;
+		std::string secondText;
+		AppendTimestamp(timestamp, std::chrono::system_clock::now(), second, secondText);
+		return timestamp;
+	}
+
+	void Logger::SetDebug(Spec spec)
+	{
+		m_Debug.store(spec.Debug, std::memory_order_relaxed);
+		m_InfoDebug.store(spec.InfoDebug, std::memory_order_relaxed);
+		if (spec.LogPath.empty())
+			return;
+
+		bool opened;
+		{
+			std::lock_guard<std::mutex> lock(m_FileMutex);
+			m_File.close();
+			m_File.clear();
+			m_File.open(spec.LogPath, std::ios::trunc);
+			opened = m_File.is_open();
+		}
+		if (!opened)
+			Log("Couldn't open " + spec.LogPath + " to log to, only logging to the console", Severity::Warning);
+	}
+
+	void Logger::Log(std::string_view message, Severity severity)
+	{
+		if (!IsEnabled(severity))
+			return;
+		uint64_t position;
+		LogRecord* record = Claim(severity, position);
+		if (!record)
+			return;
+		record->Format = nullptr;
+		record->Text.assign(message.data(), message.size());
+		Publish(*record, position);
 	}
 
-	void Logger::Log(std::string message, Severity severity) const
+	void Logger::Flush()
 	{
-		if (m_Debug) // There was a semicolon hidden here, tripped me up for like 10min trying to figure out why my debug statements were running when debug was off
+		uint64_t target = m_Head.load(std::memory_order_acquire);
+		m_Wake.notify_one();
+		while (m_Tail.load(std::memory_order_acquire) < target)
+			std::this_thread::yield();
+	}
+
+	LogRecord* Logger::Claim(Severity severity, uint64_t& position)
+	{ // Bounded MPMC queue from Dmitry Vyukov, with only the one consumer
+		position = m_Head.load(std::memory_order_relaxed);
+		for (;;)
 		{
-			// Timestamp and severity
-			switch (severity)
+			LogRecord& record = m_Ring[position & (RingSize - 1)];
+			int64_t difference = static_cast<int64_t>(record.Sequence.load(std::memory_order_acquire) - position);
+			if (difference == 0)
 			{
-			case Severity::Setup:
-				std::cout << "\033[36;40m[ " << getCurrentTimestamp() << " ] [ SET. ] " << "\033[0m" << message << std::endl; // Cyan
-				break;
-			case Severity::Verbose:
-				std::cout << "\033[90;40m[ " << getCurrentTimestamp() << " ] [ VRB. ] " << "\033[0m" << message << std::endl; // Blue
-				break;
-			case Severity::Info:
-				if (Logger::logger->IsInfoDebug())
-					std::cout << "\033[32;40m[ " << getCurrentTimestamp() << " ] [ INFO ] " << "\033[0m" << message << std::endl; // Green
-				break;
-			case Severity::Warning:
-				std::cout << "\033[33;40m[ " << getCurrentTimestamp() << " ] [ WARN ] " << "\033[0m" << message << std::endl; // Yellow
-				break;
-			case Severity::Error:
-				std::cerr << "\033[31;40m[ " << getCurrentTimestamp() << " ] [ ERR. ] " << "\033[0m" << message << std::endl; // Red
+				if (m_Head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					record.Time = static_cast<uint64_t>((std::chrono::steady_clock::now() - m_SteadyEpoch).count());
+					record.Level = severity;
+					return &record;
+				}
+			}
+			else if (difference < 0) // Full, the writer hasn't got round to this slot since last lap
+			{
+				if (severity == Severity::Verbose || severity == Severity::Info || m_Stopping.load(std::memory_order_relaxed))
+				{
+					m_Dropped.fetch_add(1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				m_Wake.notify_one();
+				std::this_thread::yield();
+				position = m_Head.load(std::memory_order_relaxed);
+			}
+			else // Another thread claimed it first
+				position = m_Head.load(std::memory_order_relaxed);
+		}
+	}
+
+	void Logger::Publish(LogRecord& record, uint64_t position)
+	{
+		bool error = record.Level == Severity::Error; // The record belongs to the writer as soon as the store's done
+		record.Sequence.store(position + 1, std::memory_order_release);
+		if (error)
+			m_Wake.notify_one(); // Out quickly in case it's the last thing that gets logged
+	}
+
+	void Logger::WriterLoop()
+	{
+		for (;;)
+		{
+			bool stopping = m_Stopping.load(std::memory_order_acquire); // Read before draining, so the last drain gets everything logged before the destructor
+			if (Drain())
+				continue;
+			if (stopping)
+				return;
+			std::unique_lock<std::mutex> lock(m_WakeMutex);
+			m_Wake.wait_for(lock, std::chrono::milliseconds(5));
+		}
+	}
+
+	bool Logger::Drain()
+	{
+		std::lock_guard<std::mutex> lock(m_FileMutex);
+		uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+		uint64_t start = tail;
+		for (;; tail++)
+		{
+			LogRecord& record = m_Ring[tail & (RingSize - 1)];
+			if (record.Sequence.load(std::memory_order_acquire) != tail + 1)
 				break;
+			Write(record);
+			record.Sequence.store(tail + RingSize, std::memory_order_release); // Free for the next lap
+		}
+
+		uint64_t dropped = m_Dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped)
+		{
+			LogRecord note;
+			note.Time = static_cast<uint64_t>((std::chrono::steady_clock::now() - m_SteadyEpoch).count());
+			note.Level = Severity::Warning;
+			note.Text = std::to_string(dropped) + " log messages were dropped, the ring was full";
+			Write(note);
+		}
+		if (tail == start && !dropped)
+			return false;
+
+		std::cout.flush(); // Once a batch instead of every line
+		if (m_File.is_open())
+			m_File.flush();
+		m_Tail.store(tail, std::memory_order_release); // After the flush, so Flush() returning means it's really out
+		return true;
+	}
+
+	void Logger::Write(const LogRecord& record)
+	{
+		m_Message.clear();
+		if (record.Format)
+		{
+			const uint8_t* argument = record.Arguments.data();
+			const uint8_t* end = argument + record.Arguments.size();
+			for (const char* c = record.Format; *c; c++)
+			{
+				if (c[0] == '{' && c[1] == '}')
+				{
+					argument = AppendArgument(m_Message, argument, end);
+					c++;
+				}
+				else
+					m_Message += *c;
 			}
 		}
+		else
+			m_Message = record.Text;
+
+		const char* colour;
+		const char* tag;
+		switch (record.Level)
+		{
+		case Severity::Setup: colour = "\033[36;40m"; tag = "SET."; break; // Cyan
+		case Severity::Verbose: colour = "\033[90;40m"; tag = "VRB."; break; // Blue
+		case Severity::Info: colour = "\033[32;40m"; tag = "INFO"; break; // Green
+		case Severity::Warning: colour = "\033[33;40m"; tag = "WARN"; break; // Yellow
+		default: colour = "\033[31;40m"; tag = "ERR."; break; // Red
+		}
+		m_Timestamp.clear();
+		AppendTimestamp(m_Timestamp, m_WallEpoch + std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::steady_clock::duration(record.Time)),
+			m_CachedSecond, m_CachedSecondText);
+
+		std::ostream& console = record.Level == Severity::Error ? std::cerr : std::cout;
+		console << colour << "[ " << m_Timestamp << " ] [ " << tag << " ] " << "\033[0m" << m_Message << '\n';
+		if (m_File.is_open())
+			m_File << "[ " << m_Timestamp << " ] [ " << tag << " ] " << m_Message << '\n';
 	}
 
 	vk::UniqueHandle<vk::DebugUtilsMessengerEXT, vk::detail::DispatchLoaderDynamic> Logger::MakeDebugMessenger(vk::UniqueInstance& instance,
@@ -1,8 +1,26 @@
 #pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <filesystem>
+#include <type_traits>
+#include <cstring>
 #include <vulkan/vulkan.hpp>
 
 #include "Spec.h"
 
+// Levels below this are compiled out of HYPER_LOG, arguments and all, 0 keeps everything, 2 keeps warnings and errors (Setup always stays)
+#ifndef HYPER_LOG_MIN_SEVERITY
+#define HYPER_LOG_MIN_SEVERITY 0
+#endif
+
 namespace hyper
 {
 	enum Severity
@@ -14,26 +32,137 @@ namespace hyper
 		Error = 3
 	};
 
+	enum class LogArgument : uint8_t
+	{
+		Signed,
+		Unsigned,
+		Float,
+		Bool,
+		String,
+		Pointer
+	};
+
+	struct LogRecord // One slot in the ring, the vectors keep their capacity so a slot that's been used once never allocates again
+	{
+		std::atomic<uint64_t> Sequence{ 0 }; // Which lap of the ring this slot is ready for, see Logger::Claim
+		uint64_t Time = 0; // steady_clock ticks, turned into wall time on the logging thread
+		Severity Level = Severity::Setup;
+		const char* Format = nullptr; // String literal with {} for each argument, nullptr when Text is the whole message
+		std::string Text;
+		std::vector<uint8_t> Arguments; // LogArgument tag then the value, strings are a uint32_t length then the bytes
+	};
+
+	// Log calls only copy their message (or the raw arguments) into a lock-free ring and go, a background thread does the
+	// formatting and the writing, so it's fine to log from any thread, the validation layer's callback included
+	// A full ring drops Verbose and Info messages (and says how many), Warning and up wait for room instead
 	class Logger
 	{
 	public:
 		static Logger* logger; // This lets it sit globally without having to get the logger in each scope
-		Logger() { logger = this; }
+		static constexpr uint32_t RingSize = 4096; // Power of two
+
+		Logger();
+		~Logger(); // Writes out whatever's still queued
+		Logger(const Logger&) = delete;
+		Logger& operator=(const Logger&) = delete;
 
 		std::string getCurrentTimestamp() const;
 
-		void SetDebug(Spec spec = {}) { m_Debug = spec.Debug; m_InfoDebug = spec.InfoDebug; }
-		bool IsDebug() const { return m_Debug; }
-		bool IsInfoDebug() const { return m_InfoDebug; }
+		void SetDebug(Spec spec = {}); // Also opens spec.LogPath if there is one
+		bool IsDebug() const { return m_Debug.load(std::memory_order_relaxed); }
+		bool IsInfoDebug() const { return m_InfoDebug.load(std::memory_order_relaxed); }
+		bool IsEnabled(Severity severity) const { return IsDebug() && (severity != Severity::Info || IsInfoDebug()); }
 
-		void Log(std::string message, Severity severity = Severity::Setup) const;
+		void Log(std::string_view message, Severity severity = Severity::Setup);
+		// Deferred formatting, format has to be a string literal since only the pointer is kept, use through HYPER_LOG
+		template<typename... Args>
+		void LogFormat(Severity severity, const char* format, const Args&... args)
+		{
+			if (!IsEnabled(severity))
+				return;
+			uint64_t position;
+			LogRecord* record = Claim(severity, position);
+			if (!record)
+				return;
+			record->Format = format;
+			record->Arguments.clear();
+			(PackArgument(record->Arguments, args), ...);
+			Publish(*record, position);
+		}
+		void Flush(); // Blocks until everything logged before the call has been written
 
 		// Probably doesn't need to be /here/
 		vk::UniqueHandle<vk::DebugUtilsMessengerEXT, vk::detail::DispatchLoaderDynamic> MakeDebugMessenger(vk::UniqueInstance& instance,
 			vk::detail::DispatchLoaderDynamic& dldi);
 
 	private:
-		bool m_Debug = false;
-		bool m_InfoDebug = false;
+		LogRecord* Claim(Severity severity, uint64_t& position); // nullptr if it got dropped
+		void Publish(LogRecord& record, uint64_t position);
+
+		template<typename T>
+		static void PackValue(std::vector<uint8_t>& arguments, LogArgument type, T value)
+		{
+			size_t offset = arguments.size();
+			arguments.resize(offset + 1 + sizeof(T));
+			arguments[offset] = static_cast<uint8_t>(type);
+			std::memcpy(arguments.data() + offset + 1, &value, sizeof(T));
+		}
+		template<typename T>
+		static void PackArgument(std::vector<uint8_t>& arguments, const T& value)
+		{
+			if constexpr (std::is_same_v<T, bool>)
+				PackValue(arguments, LogArgument::Bool, static_cast<uint8_t>(value));
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+				PackValue(arguments, LogArgument::Signed, static_cast<int64_t>(value));
+			else if constexpr (std::is_integral_v<T>)
+				PackValue(arguments, LogArgument::Unsigned, static_cast<uint64_t>(value));
+			else if constexpr (std::is_enum_v<T>)
+				PackValue(arguments, LogArgument::Signed, static_cast<int64_t>(value));
+			else if constexpr (std::is_floating_point_v<T>)
+				PackValue(arguments, LogArgument::Float, static_cast<double>(value));
+			else if constexpr (std::is_convertible_v<const T&, std::string_view>) // Literals, char arrays, std::string, copied since none of them have to outlive the call
+			{
+				std::string_view text = value;
+				PackValue(arguments, LogArgument::String, static_cast<uint32_t>(text.size()));
+				arguments.insert(arguments.end(), text.begin(), text.end());
+			}
+			else if constexpr (std::is_same_v<T, std::filesystem::path>)
+				PackArgument(arguments, value.string());
+			else if constexpr (std::is_pointer_v<T>)
+				PackValue(arguments, LogArgument::Pointer, reinterpret_cast<uintptr_t>(value));
+			else
+				static_assert(sizeof(T) == 0, "Can't log this type, convert it to a number or a string first");
+		}
+
+		void WriterLoop();
+		bool Drain(); // Writes everything that's ready, false if there wasn't anything
+		void Write(const LogRecord& record);
+
+		std::atomic<bool> m_Debug{ false };
+		std::atomic<bool> m_InfoDebug{ false };
+
+		std::unique_ptr<LogRecord[]> m_Ring = std::make_unique<LogRecord[]>(RingSize);
+		alignas(64) std::atomic<uint64_t> m_Head{ 0 }; // Next slot a producer claims
+		alignas(64) std::atomic<uint64_t> m_Tail{ 0 }; // Next slot the writer reads, only the writer moves it
+		std::atomic<uint64_t> m_Dropped{ 0 };
+
+		std::thread m_Writer;
+		std::mutex m_WakeMutex;
+		std::condition_variable m_Wake; // Only errors and Flush wake the writer early, otherwise it looks every few ms so logging never costs a syscall
+		std::atomic<bool> m_Stopping{ false };
+		std::chrono::system_clock::time_point m_WallEpoch = std::chrono::system_clock::now(); // Record times are steady_clock, these line them up
+		std::chrono::steady_clock::time_point m_SteadyEpoch = std::chrono::steady_clock::now();
+
+		// Writer thread only, apart from opening the file which takes the mutex
+		std::mutex m_FileMutex;
+		std::ofstream m_File;
+		std::string m_Message, m_Timestamp;
+		int64_t m_CachedSecond = -1; // localtime is slow, the date and time part only changes once a second
+		std::string m_CachedSecondText;
 	};
-}
\ No newline at end of file
+}
+
+// Compile time filtered logging with deferred formatting, HYPER_LOG(Severity::Warning, "Upload of {} bytes doesn't fit", size)
+// Below HYPER_LOG_MIN_SEVERITY it's an empty statement, the arguments don't even get evaluated
+#define HYPER_LOG(severity, ...) \
+	do { if constexpr (static_cast<int>(severity) >= HYPER_LOG_MIN_SEVERITY) hyper::Logger::logger->LogFormat(severity, __VA_ARGS__); } while (0)
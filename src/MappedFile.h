@@ -0,0 +1,34 @@
+#pragma once
+#include <filesystem>
+#include <cstdint>
+#include <cstddef>
+
+namespace hyper
+{
+	// Read only memory mapped file, pages come in from the OS page cache as they're touched instead of going through a read buffer
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile() { Close(); }
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::filesystem::path& path);
+		void Close();
+
+		bool IsOpen() const { return m_Data != nullptr; }
+		const uint8_t* GetData() const { return m_Data; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+#if defined(_WIN32)
+		void* m_File = nullptr; // HANDLEs, windows.h stays out of the header
+		void* m_Mapping = nullptr;
+#else
+		int m_File = -1;
+#endif
+	};
+}
@@ -0,0 +1,245 @@
+#include "MemoryTracker.h"
+
+#include <fstream>
+#include <cfloat>
+
+#include "imgui.h"
+
+#include "Logger.h"
+
+namespace hyper
+{
+	MemoryTracker* MemoryTracker::tracker; // Same deal as the logger
+
+	namespace
+	{
+		constexpr uint32_t HeapStatsInterval = 30; // Frames between walks of every block for the window
+		constexpr double MB = 1024.0 * 1024.0;
+
+		// Category goes in the allocation's user data, offset by one so untagged allocations (null) can be told apart
+		void* CategoryToUserData(MemoryCategory category) { return reinterpret_cast<void*>(static_cast<uintptr_t>(category) + 1); }
+	}
+
+	const char* GetMemoryCategoryName(MemoryCategory category)
+	{
+		switch (category)
+		{
+		case MemoryCategory::Geometry: return "Geometry";
+		case MemoryCategory::Texture: return "Texture";
+		case MemoryCategory::RenderTarget: return "RenderTarget";
+		case MemoryCategory::Uniform: return "Uniform";
+		case MemoryCategory::Transient: return "Transient";
+		case MemoryCategory::Staging: return "Staging";
+		default: return "Other";
+		}
+	}
+
+	void MemoryTracker::CreateMemoryTracker(VmaAllocator allocator, bool budgetExtension, float pressureThreshold)
+	{
+		m_Allocator = allocator;
+		m_BudgetExtension = budgetExtension;
+		m_PressureThreshold = pressureThreshold;
+		const VkPhysicalDeviceMemoryProperties* memoryProperties;
+		vmaGetMemoryProperties(m_Allocator, &memoryProperties);
+		m_HeapCount = memoryProperties->memoryHeapCount;
+		HYPER_LOG(Severity::Setup, "Memory budgets from {}", budgetExtension ? "VK_EXT_memory_budget" : "VMA's estimate, VK_EXT_memory_budget isn't supported");
+	}
+
+	void MemoryTracker::DestroyMemoryTracker()
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); i++)
+			if (m_Counts[i].load(std::memory_order_relaxed) > 0)
+				HYPER_LOG(Severity::Warning, "{} allocations ({} bytes) of {} memory never got freed", m_Counts[i].load(std::memory_order_relaxed),
+					m_Bytes[i].load(std::memory_order_relaxed), GetMemoryCategoryName(static_cast<MemoryCategory>(i)));
+		m_PressureCallbacks.clear();
+		m_Allocator = {};
+	}
+
+	void MemoryTracker::Track(MemoryCategory category, int64_t bytes, int32_t count)
+	{ // Negative amounts wrap round the unsigned totals and come back out right
+		m_Bytes[static_cast<uint32_t>(category)].fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+		m_Counts[static_cast<uint32_t>(category)].fetch_add(static_cast<uint32_t>(count), std::memory_order_relaxed);
+	}
+
+	void MemoryTracker::Update()
+	{
+		if (!m_Allocator)
+			return;
+		vmaSetCurrentFrameIndex(m_Allocator, static_cast<uint32_t>(++m_FrameNumber));
+		vmaGetHeapBudgets(m_Allocator, m_Budgets.data());
+
+		for (uint32_t heap = 0; heap < m_HeapCount; heap++)
+		{
+			const VmaBudget& budget = m_Budgets[heap];
+			uint64_t target = static_cast<uint64_t>(budget.budget * static_cast<double>(m_PressureThreshold));
+			uint32_t bit = 1u << heap;
+			if (budget.budget == 0 || budget.usage <= target)
+			{
+				if (m_PressuredHeaps & bit)
+					HYPER_LOG(Severity::Info, "Heap {} is back under its budget threshold", heap);
+				m_PressuredHeaps &= ~bit;
+				continue;
+			}
+
+			if (!(m_PressuredHeaps & bit))
+				HYPER_LOG(Severity::Warning, "Heap {} is at {}MB of its {}MB budget", heap, budget.usage / (1024 * 1024), budget.budget / (1024 * 1024));
+			m_PressuredHeaps |= bit;
+			MemoryPressure pressure{ heap, budget.usage, budget.budget, target };
+			for (const PressureCallback& callback : m_PressureCallbacks)
+				callback(pressure);
+		}
+	}
+
+	void MemoryTracker::AddPressureCallback(PressureCallback callback)
+	{
+		m_PressureCallbacks.push_back(std::move(callback));
+	}
+
+	std::vector<MemoryHeapStats> MemoryTracker::GetHeapStats() const
+	{
+		std::vector<MemoryHeapStats> heaps;
+		if (!m_Allocator)
+			return heaps;
+		const VkPhysicalDeviceMemoryProperties* memoryProperties;
+		vmaGetMemoryProperties(m_Allocator, &memoryProperties);
+		VmaTotalStatistics statistics;
+		vmaCalculateStatistics(m_Allocator, &statistics);
+		std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+		vmaGetHeapBudgets(m_Allocator, budgets.data());
+
+		for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++)
+		{
+			const VmaDetailedStatistics& detailed = statistics.memoryHeap[i];
+			MemoryHeapStats heap;
+			heap.Index = i;
+			heap.DeviceLocal = memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+			heap.Size = memoryProperties->memoryHeaps[i].size;
+			heap.Budget = budgets[i].budget;
+			heap.Usage = budgets[i].usage;
+			heap.BlockBytes = detailed.statistics.blockBytes;
+			heap.AllocationBytes = detailed.statistics.allocationBytes;
+			heap.BlockCount = detailed.statistics.blockCount;
+			heap.AllocationCount = detailed.statistics.allocationCount;
+			heap.LargestFreeRange = detailed.unusedRangeCount > 0 ? detailed.unusedRangeSizeMax : 0;
+			uint64_t free = heap.BlockBytes - heap.AllocationBytes;
+			heap.Fragmentation = free > 0 ? 1.0f - static_cast<float>(static_cast<double>(heap.LargestFreeRange) / free) : 0.0f;
+			heaps.push_back(heap);
+		}
+		return heaps;
+	}
+
+	void MemoryTracker::DrawImGui()
+	{
+		if (m_HeapStats.empty() || m_FrameNumber - m_HeapStatsFrame >= HeapStatsInterval)
+		{
+			m_HeapStats = GetHeapStats();
+			m_HeapStatsFrame = m_FrameNumber;
+		}
+
+		ImGui::Begin("Memory");
+		ImGui::Text("Budgets from %s", m_BudgetExtension ? "VK_EXT_memory_budget" : "VMA's estimate");
+		for (const MemoryHeapStats& heap : m_HeapStats)
+		{ // The bar is this frame's, the rest is from the last walk
+			const VmaBudget& budget = m_Budgets[heap.Index];
+			char overlay[64];
+			snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB", budget.usage / MB, budget.budget / MB);
+			ImGui::Text("Heap %u%s, %.0f MB", heap.Index, heap.DeviceLocal ? " (device local)" : "", heap.Size / MB);
+			ImGui::ProgressBar(budget.budget > 0 ? static_cast<float>(static_cast<double>(budget.usage) / budget.budget) : 0.0f, ImVec2(-FLT_MIN, 0.0f), overlay);
+			ImGui::Text("  %u blocks %.1f MB, %u allocations %.1f MB, fragmentation %.0f%%", heap.BlockCount, heap.BlockBytes / MB,
+				heap.AllocationCount, heap.AllocationBytes / MB, heap.Fragmentation * 100.0f);
+		}
+
+		if (ImGui::CollapsingHeader("Categories", ImGuiTreeNodeFlags_DefaultOpen) && ImGui::BeginTable("Categories", 3, ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Category");
+			ImGui::TableSetupColumn("Allocations");
+			ImGui::TableSetupColumn("MB");
+			ImGui::TableHeadersRow();
+			for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); i++)
+			{
+				MemoryCategory category = static_cast<MemoryCategory>(i);
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(GetMemoryCategoryName(category));
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", GetCategoryCount(category));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", GetCategoryBytes(category) / MB);
+			}
+			ImGui::EndTable();
+		}
+
+		if (ImGui::Button("Write memory dump"))
+			m_DumpStatus = WriteJson("memory.json") ? "Wrote memory.json" : "Couldn't write memory.json";
+		if (!m_DumpStatus.empty())
+			ImGui::Text("%s", m_DumpStatus.c_str());
+		ImGui::End();
+	}
+
+	bool MemoryTracker::WriteJson(const std::filesystem::path& path) const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open())
+		{
+			HYPER_LOG(Severity::Error, "Couldn't open {} to write a memory dump to", path);
+			return false;
+		}
+
+		file << "{\n\"frame\": " << m_FrameNumber << ",\n\"budgetExtension\": " << (m_BudgetExtension ? "true" : "false") << ",\n\"heaps\": [";
+		std::vector<MemoryHeapStats> heaps = GetHeapStats();
+		for (size_t i = 0; i < heaps.size(); i++)
+		{
+			const MemoryHeapStats& heap = heaps[i];
+			file << (i ? "," : "") << "\n{\"index\":" << heap.Index << ",\"deviceLocal\":" << (heap.DeviceLocal ? "true" : "false")
+				<< ",\"size\":" << heap.Size << ",\"budget\":" << heap.Budget << ",\"usage\":" << heap.Usage
+				<< ",\"blockBytes\":" << heap.BlockBytes << ",\"allocationBytes\":" << heap.AllocationBytes
+				<< ",\"blocks\":" << heap.BlockCount << ",\"allocations\":" << heap.AllocationCount
+				<< ",\"largestFreeRange\":" << heap.LargestFreeRange << ",\"fragmentation\":" << heap.Fragmentation << "}";
+		}
+		file << "\n],\n\"categories\": [";
+		for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); i++)
+		{
+			MemoryCategory category = static_cast<MemoryCategory>(i);
+			file << (i ? "," : "") << "\n{\"name\":\"" << GetMemoryCategoryName(category) << "\",\"allocations\":" << GetCategoryCount(category)
+				<< ",\"bytes\":" << GetCategoryBytes(category) << "}";
+		}
+		file << "\n]";
+
+		if (m_Allocator)
+		{ // VMA's own dump is already JSON, every block and allocation with its name, type and offset
+			char* vmaStats = nullptr;
+			vmaBuildStatsString(m_Allocator, &vmaStats, VK_TRUE);
+			file << ",\n\"vma\": " << vmaStats;
+			vmaFreeStatsString(m_Allocator, vmaStats);
+		}
+		file << "\n}\n";
+
+		HYPER_LOG(Severity::Info, "Memory dump written to {}", path);
+		return static_cast<bool>(file);
+	}
+
+	void TagAllocation(VmaAllocator allocator, VmaAllocation allocation, const MemoryTag& tag)
+	{
+		if (!allocation)
+			return;
+		if (tag.Name)
+			vmaSetAllocationName(allocator, allocation, tag.Name);
+		vmaSetAllocationUserData(allocator, allocation, CategoryToUserData(tag.Category));
+		if (MemoryTracker::tracker)
+		{
+			VmaAllocationInfo info;
+			vmaGetAllocationInfo(allocator, allocation, &info);
+			MemoryTracker::tracker->Track(tag.Category, static_cast<int64_t>(info.size), 1);
+		}
+	}
+
+	void UntagAllocation(VmaAllocator allocator, VmaAllocation allocation)
+	{
+		if (!allocation || !MemoryTracker::tracker)
+			return;
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo(allocator, allocation, &info);
+		if (info.pUserData) // Anything that was never tagged was never counted either
+			MemoryTracker::tracker->Track(static_cast<MemoryCategory>(reinterpret_cast<uintptr_t>(info.pUserData) - 1), -static_cast<int64_t>(info.size), -1);
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <atomic>
+#include <string>
+#include <functional>
+#include <filesystem>
+#include <vulkan/vulkan.hpp>
+#include <vma/vk_mem_alloc.h>
+
+namespace hyper
+{
+	enum class MemoryCategory : uint32_t
+	{
+		Geometry,
+		Texture,
+		RenderTarget,
+		Uniform,
+		Transient,
+		Staging,
+		Other,
+		Count
+	};
+
+	const char* GetMemoryCategoryName(MemoryCategory category);
+
+	struct MemoryTag // What an allocation is for, every CreateBuffer and CreateImage takes one
+	{
+		MemoryCategory Category = MemoryCategory::Other;
+		const char* Name = nullptr; // VMA keeps its own copy, shows up in the JSON dump next to the allocation
+	};
+
+	struct MemoryHeapStats
+	{
+		uint32_t Index = 0;
+		bool DeviceLocal = false;
+		uint64_t Size = 0;
+		uint64_t Budget = 0, Usage = 0; // From VK_EXT_memory_budget when there is one, VMA's own estimate otherwise, Usage is the whole process not just VMA
+		uint64_t BlockBytes = 0, AllocationBytes = 0; // Only what VMA allocated
+		uint32_t BlockCount = 0, AllocationCount = 0;
+		uint64_t LargestFreeRange = 0;
+		float Fragmentation = 0.0f; // 0 when all the free space in the blocks is one range, close to 1 when it's all tiny gaps
+	};
+
+	struct MemoryPressure // Handed to the pressure callbacks, evicting (Usage - Target) bytes off this heap gets it back under
+	{
+		uint32_t Heap = 0;
+		uint64_t Usage = 0, Budget = 0, Target = 0;
+	};
+
+	// Per category totals for everything that went through TagAllocation, plus heap usage against the budget the driver gives us
+	// Totals are atomics so loader threads can allocate without a lock, the rest is main thread only
+	class MemoryTracker
+	{
+	public:
+		static MemoryTracker* tracker; // Global like the logger, so CreateBuffer and friends can count without being handed it
+		using PressureCallback = std::function<void(const MemoryPressure& pressure)>;
+
+		MemoryTracker() { tracker = this; }
+		~MemoryTracker() { if (tracker == this) tracker = nullptr; } // Allocations after this still get named, just not counted
+
+		// budgetExtension is whether the allocator was made with VK_EXT_memory_budget, without it VMA guesses 80% of each heap
+		void CreateMemoryTracker(VmaAllocator allocator, bool budgetExtension, float pressureThreshold = 0.9f);
+		void DestroyMemoryTracker(); // Warns about any category that still has memory in it
+
+		void Track(MemoryCategory category, int64_t bytes, int32_t count);
+		uint64_t GetCategoryBytes(MemoryCategory category) const { return m_Bytes[static_cast<uint32_t>(category)].load(std::memory_order_relaxed); }
+		uint32_t GetCategoryCount(MemoryCategory category) const { return m_Counts[static_cast<uint32_t>(category)].load(std::memory_order_relaxed); }
+
+		// Once a frame, main thread, refreshes the budgets and calls the pressure callbacks for every heap over the threshold
+		void Update();
+		// Called every frame a heap stays over the threshold, streaming systems should evict until it's back under Target
+		void AddPressureCallback(PressureCallback callback);
+
+		std::vector<MemoryHeapStats> GetHeapStats() const; // Walks every block, too slow for every frame
+		void DrawImGui(); // Its own window, heaps against their budget, fragmentation and the category totals
+		bool WriteJson(const std::filesystem::path& path) const; // Everything in the window plus VMA's detailed map with every named allocation
+
+	private:
+		VmaAllocator m_Allocator{};
+		bool m_BudgetExtension = false;
+		float m_PressureThreshold = 0.9f; // Fraction of the budget
+		std::array<std::atomic<uint64_t>, static_cast<size_t>(MemoryCategory::Count)> m_Bytes{};
+		std::array<std::atomic<uint32_t>, static_cast<size_t>(MemoryCategory::Count)> m_Counts{};
+
+		std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> m_Budgets{};
+		uint32_t m_HeapCount = 0;
+		uint32_t m_PressuredHeaps = 0; // Bit per heap, so the warning only gets logged when one goes over
+		std::vector<PressureCallback> m_PressureCallbacks;
+
+		std::vector<MemoryHeapStats> m_HeapStats; // What the window shows, refreshed every so often rather than every frame
+		uint64_t m_HeapStatsFrame = 0;
+		uint64_t m_FrameNumber = 0; // Counted by Update, VMA only refetches budgets when its frame index moves
+		std::string m_DumpStatus; // Shown under the dump button
+	};
+
+	// Names the allocation and counts it under tag's category, CreateBuffer and CreateImage already do this
+	void TagAllocation(VmaAllocator allocator, VmaAllocation allocation, const MemoryTag& tag);
+	void UntagAllocation(VmaAllocator allocator, VmaAllocation allocation); // Right before it's freed
+}
@@ -2,18 +2,27 @@
 #include <iostream>
 #include <filesystem>
 #include <optional>
+#include <cstring>
+#include <atomic>
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <fastgltf/core.hpp>
 #include <fastgltf/glm_element_traits.hpp>
 #include <fastgltf/tools.hpp>
 
 #include "Buffer.h"
+#include "Upload.h"
+#include "GeometryPool.h"
+#include "Logger.h"
+#include "MeshOptimizer.h"
+#include "Scene.h"
+#include "Image.h"
 
 namespace hyper
 {
-	struct Vertex
+	struct Vertex // Has padding after the vec3s with the aligned glm types, keep it zeroed (value initialise, then set members) since welding compares bytes
 	{
 		glm::vec3 position;
 		glm::vec3 normal;
@@ -36,60 +45,334 @@ namespace hyper
 		}
 	};
 
+	// 16 bytes instead of 64, the vertex shader pulls and decodes these itself, so no attribute formats needed
+	struct PackedVertex
+	{
+		uint16_t position[3];	// Unorm16 across the mesh bounds, see MeshAsset::positionOffset/Scale
+		int8_t normal[2];		// Octahedral, snorm8
+		uint8_t color[4];		// Unorm8
+		uint16_t texCoord[2];	// Half floats
+	};
+	static_assert(sizeof(PackedVertex) == 16, "PackedVertex has to match the layout in shader.vert");
+
+	enum class VertexFormat : uint32_t // Has to match shader.vert
+	{
+		Full = 0,
+		Packed = 1
+	};
+
 	struct MaterialInstance
 	{
 		vk::ShaderEXT shader;
 		vk::PipelineLayout layout;
-		vk::DescriptorSet materialSet;
+		uint32_t textureIndex; // Bindless indices, so materials don't need their own descriptor sets
+		uint32_t samplerIndex;
+		uint32_t shaderId = 0; // Small ids for the draw sort key, materials with the same shader should share one
+		uint32_t materialId = 0;
 	};
 	struct RenderObject
 	{
 		uint32_t indexCount;
 		uint32_t firstIndex;
+		int32_t vertexOffset; // Where the mesh starts in its geometry pool block, in vertices
 		vk::Buffer indexBuffer;
+		vk::IndexType indexType;
 		vk::DeviceAddress vertexBufferAddress;
+		VertexFormat vertexFormat;
+		glm::vec3 positionOffset; // Dequantization for packed positions, unused for full vertices
+		glm::vec3 positionScale;
+		glm::vec4 boundingSphere; // Local space, xyz is the centre and w the radius
+		uint32_t surfaceId; // MeshAsset::firstSurfaceId plus the surface's index, for the draw sort key
 
 		MaterialInstance* material;
 
 		glm::mat4 transform;
 	};
+	struct DrawBatch // Render objects that only differ by transform, drawn with one instanced call
+	{
+		uint32_t firstObject; // Into the sorted draw list, which is also where its transforms start in the instance buffer
+		uint32_t instanceCount;
+	};
 
+	constexpr uint32_t NoImage = ~0u;
 	struct GeoSurface
 	{
 		uint32_t startIndex;
 		uint32_t count;
+		uint32_t image = NoImage; // Base colour image of the surface's material, into the model's images, fits in the padding before boundsMin
+		glm::vec3 boundsMin{ 0.0f }; // Local space, filled in by ComputeSurfaceBounds
+		glm::vec3 boundsMax{ 0.0f };
+		glm::vec4 boundingSphere{ 0.0f }; // xyz is the centre, w the radius
 	};
 	struct MeshAsset
 	{
 		std::string name;
 		std::vector<GeoSurface> surfaces;
-		Buffer vertexBuffer;
-		Buffer indexBuffer;
+		GeometryAllocation vertices; // Both out of the geometry pool, usually the same block
+		GeometryAllocation indices;
+		vk::DeviceAddress vertexBufferAddress = 0; // Base of the block, not the mesh, draws add vertexOffset
+		vk::Buffer indexBuffer;
+		int32_t vertexOffset = 0;
+		uint32_t firstIndex = 0; // Add GeoSurface::startIndex to get a surface's first index
+		vk::IndexType indexType = vk::IndexType::eUint32;
+		VertexFormat vertexFormat = VertexFormat::Full;
+		glm::vec3 positionOffset{ 0.0f };
+		glm::vec3 positionScale{ 1.0f };
+		uint32_t firstSurfaceId = 0; // Every surface of every mesh gets its own id
+	};
+	inline std::atomic<uint32_t> NextSurfaceId{ 0 }; // Inline so every file shares the one counter
+	struct MeshData // Cpu side of a mesh, everything LoadModel builds before the gpu gets involved
+	{
+		std::string name;
+		std::vector<GeoSurface> surfaces;
+		std::vector<Vertex> vertices;
+		std::vector<PackedVertex> packedVertices; // Replaces vertices on upload if it isn't empty
+		std::vector<uint32_t> indices;
+		glm::vec3 boundsMin{ 0.0f };
+		glm::vec3 boundsMax{ 0.0f };
 	};
-	static std::vector<std::shared_ptr<MeshAsset>> LoadModel(vk::CommandPool& commandPool, vk::Device& device, vk::Queue& queue, VmaAllocator& allocator,
-		std::filesystem::path filePath)
+	struct MeshBlob // Gpu ready mesh data owned by someone else (a MeshData, a mapped package), uploaded as is with no conversion
+	{
+		std::string name;
+		const GeoSurface* surfaces = nullptr;
+		uint32_t surfaceCount = 0;
+		const void* vertices = nullptr;
+		uint64_t vertexCount = 0;
+		VertexFormat vertexFormat = VertexFormat::Full;
+		glm::vec3 positionOffset{ 0.0f }; // Only used by VertexFormat::Packed
+		glm::vec3 positionScale{ 1.0f };
+		const void* indices = nullptr;
+		uint64_t indexCount = 0;
+		vk::IndexType indexType = vk::IndexType::eUint32;
+	};
+
+	static glm::vec2 OctahedralEncode(glm::vec3 n)
+	{
+		n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		glm::vec2 e{ n.x, n.y };
+		if (n.z < 0.0f) // Fold the bottom half over the diagonals
+			e = (1.0f - glm::abs(glm::vec2{ n.y, n.x })) * glm::vec2{ n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f };
+		return e;
+	}
+	static glm::vec3 OctahedralDecode(glm::vec2 e) // Same as shader.vert, only used to measure the error here
+	{
+		glm::vec3 n{ e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y) };
+		float t = std::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return glm::normalize(n);
+	}
+
+	// Fills packedVertices, positions are quantized across the bounds so the precision scales with the mesh
+	static void PackMesh(MeshData& mesh)
+	{
+		if (mesh.vertices.empty())
+			return;
+		mesh.boundsMin = mesh.boundsMax = mesh.vertices[0].position;
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			mesh.boundsMin = glm::min(mesh.boundsMin, vertex.position);
+			mesh.boundsMax = glm::max(mesh.boundsMax, vertex.position);
+		}
+		glm::vec3 extent = glm::max(mesh.boundsMax - mesh.boundsMin, glm::vec3{ 1e-8f }); // Flat meshes would divide by zero
+
+		float positionError = 0.0f, normalError = 0.0f, texCoordError = 0.0f;
+		mesh.packedVertices.resize(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			const Vertex& vertex = mesh.vertices[i];
+			PackedVertex& packed = mesh.packedVertices[i];
+
+			glm::vec3 position = (vertex.position - mesh.boundsMin) / extent;
+			for (int k = 0; k < 3; k++)
+				packed.position[k] = glm::packUnorm1x16(position[k]);
+			glm::vec3 decodedPosition = mesh.boundsMin + glm::vec3{ glm::unpackUnorm1x16(packed.position[0]), glm::unpackUnorm1x16(packed.position[1]),
+				glm::unpackUnorm1x16(packed.position[2]) } * extent;
+			positionError = std::max(positionError, glm::length(decodedPosition - vertex.position));
+
+			glm::vec3 normal = glm::length(vertex.normal) > 0.0f ? glm::normalize(vertex.normal) : glm::vec3{ 0.0f, 0.0f, 1.0f };
+			glm::vec2 octahedral = OctahedralEncode(normal);
+			packed.normal[0] = static_cast<int8_t>(glm::packSnorm1x8(octahedral.x));
+			packed.normal[1] = static_cast<int8_t>(glm::packSnorm1x8(octahedral.y));
+			glm::vec3 decodedNormal = OctahedralDecode({ glm::unpackSnorm1x8(packed.normal[0]), glm::unpackSnorm1x8(packed.normal[1]) });
+			normalError = std::max(normalError, std::acos(glm::clamp(glm::dot(normal, decodedNormal), -1.0f, 1.0f)));
+
+			uint32_t color = glm::packUnorm4x8(vertex.color);
+			std::memcpy(packed.color, &color, sizeof(color));
+
+			packed.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+			packed.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+			glm::vec2 decodedTexCoord{ glm::unpackHalf1x16(packed.texCoord[0]), glm::unpackHalf1x16(packed.texCoord[1]) };
+			texCoordError = std::max(texCoordError, glm::length(decodedTexCoord - vertex.texCoord));
+		}
+
+		HYPER_LOG(Severity::Info, "Mesh \"{}\" packed to {} bytes per vertex, max error: position {}, normal {} degrees, uv {}", mesh.name, sizeof(PackedVertex),
+			positionError, glm::degrees(normalError), texCoordError);
+	}
+
+	// Runs before upload, surfaces are reordered separately so their index ranges stay where they were
+	static void OptimizeMesh(MeshData& mesh, const MeshOptimizeSettings& settings)
+	{
+		if (mesh.indices.empty())
+			return;
+		size_t vertexCount = mesh.vertices.size();
+		VertexCacheStats before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount, settings.CacheSize);
+
+		if (settings.RemoveDuplicates)
+		{
+			std::vector<uint32_t> remap;
+			std::vector<Vertex> vertices(GenerateVertexRemap(remap, mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex)));
+			RemapIndices(mesh.indices.data(), mesh.indices.size(), remap);
+			RemapVertices(vertices.data(), mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex), remap);
+			mesh.vertices = std::move(vertices);
+		}
+
+		for (const GeoSurface& surface : mesh.surfaces)
+		{
+			uint32_t* indices = mesh.indices.data() + surface.startIndex;
+			std::vector<uint32_t> clusters;
+			if (settings.OptimizeVertexCache)
+				clusters = OptimizeVertexCache(indices, surface.count, mesh.vertices.size(), settings.CacheSize);
+			if (settings.OptimizeOverdraw)
+				OptimizeOverdraw(indices, surface.count, &mesh.vertices[0].position.x, mesh.vertices.size(), sizeof(Vertex), clusters,
+					settings.CacheSize, settings.OverdrawThreshold);
+		}
+
+		if (settings.OptimizeVertexFetch)
+		{
+			std::vector<Vertex> vertices(mesh.vertices.size());
+			vertices.resize(OptimizeVertexFetch(vertices.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size(),
+				sizeof(Vertex)));
+			mesh.vertices = std::move(vertices);
+		}
+
+		VertexCacheStats after = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), settings.CacheSize);
+		HYPER_LOG(Severity::Info, "Mesh \"{}\": {} -> {} vertices, ACMR {} -> {}, ATVR {} -> {}", mesh.name, vertexCount, mesh.vertices.size(),
+			before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+	}
+
+	// AABB from the vertices each surface actually uses, the sphere is centred on the box but only as big as the furthest vertex
+	static void ComputeSurfaceBounds(MeshData& mesh)
+	{
+		for (GeoSurface& surface : mesh.surfaces)
+		{
+			if (surface.count == 0)
+				continue;
+			surface.boundsMin = surface.boundsMax = mesh.vertices[mesh.indices[surface.startIndex]].position;
+			for (uint32_t i = surface.startIndex; i < surface.startIndex + surface.count; i++)
+			{
+				surface.boundsMin = glm::min(surface.boundsMin, mesh.vertices[mesh.indices[i]].position);
+				surface.boundsMax = glm::max(surface.boundsMax, mesh.vertices[mesh.indices[i]].position);
+			}
+			glm::vec3 center = (surface.boundsMin + surface.boundsMax) * 0.5f;
+			float radius = 0.0f;
+			for (uint32_t i = surface.startIndex; i < surface.startIndex + surface.count; i++)
+				radius = std::max(radius, glm::length(mesh.vertices[mesh.indices[i]].position - center));
+			surface.boundingSphere = glm::vec4(center, radius);
+		}
+	}
+
+	// Node tree from the default scene (or the first one), mesh indices line up with the order ParseModel outputs meshes in
+	static void ImportScene(const fastgltf::Asset& gltf, Scene& scene)
+	{
+		if (gltf.scenes.empty())
+			return;
+		const fastgltf::Scene& gltfScene = gltf.scenes[gltf.defaultScene.has_value() ? gltf.defaultScene.value() : 0];
+
+		// Explicit stack instead of recursion so deep hierarchies can't blow the call stack, children go on backwards so they come off in order
+		std::vector<std::pair<size_t, uint32_t>> stack; // glTF node, parent in the scene
+		for (size_t i = gltfScene.nodeIndices.size(); i-- > 0;)
+			stack.push_back({ gltfScene.nodeIndices[i], Scene::NoParent });
+		while (!stack.empty())
+		{
+			std::pair<size_t, uint32_t> entry = stack.back();
+			stack.pop_back();
+			const fastgltf::Node& node = gltf.nodes[entry.first];
+
+			glm::vec3 translation{ 0.0f }, scale{ 1.0f };
+			glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+			if (const fastgltf::TRS* trs = std::get_if<fastgltf::TRS>(&node.transform)) // Always TRS, matrices get decomposed by the parser
+			{
+				translation = glm::vec3{ trs->translation[0], trs->translation[1], trs->translation[2] };
+				rotation = glm::quat{ trs->rotation[3], trs->rotation[0], trs->rotation[1], trs->rotation[2] }; // glm wants w first
+				scale = glm::vec3{ trs->scale[0], trs->scale[1], trs->scale[2] };
+			}
+			uint32_t sceneNode = scene.AddNode(entry.second, std::string(node.name), translation, rotation, scale,
+				node.meshIndex.has_value() ? static_cast<int32_t>(node.meshIndex.value()) : -1);
+
+			for (size_t i = node.children.size(); i-- > 0;)
+				stack.push_back({ node.children[i], sceneNode });
+		}
+	}
+
+	// Every image in the file, in glTF order so material texture indices line up, still encoded, decoding is left to CreateImagesParallel (and DecodeTexture when cooking)
+	static void ImportImages(const fastgltf::Asset& gltf, const std::filesystem::path& directory, std::vector<TextureSource>& images)
+	{
+		for (const fastgltf::Image& gltfImage : gltf.images)
+		{
+			TextureSource& source = images.emplace_back();
+			source.Name = gltfImage.name.empty() ? "image " + std::to_string(images.size() - 1) : std::string(gltfImage.name);
+			std::visit(fastgltf::visitor{
+				[](const auto&) {},
+				[&](const fastgltf::sources::BufferView& view)
+				{ // Embedded in a glb, the usual case
+					fastgltf::span<const std::byte> bytes = fastgltf::DefaultBufferDataAdapter{}(gltf, view.bufferViewIndex);
+					const uint8_t* data = reinterpret_cast<const uint8_t*>(bytes.data());
+					source.Encoded.assign(data, data + bytes.size());
+				},
+				[&](const fastgltf::sources::Array& array)
+				{ // Base64 data uri
+					const uint8_t* data = reinterpret_cast<const uint8_t*>(array.bytes.data());
+					source.Encoded.assign(data, data + array.bytes.size());
+				},
+				[&](const fastgltf::sources::URI& uri)
+				{ // Separate file, left for the decode so it's read on the pool too
+					source.Path = directory / uri.uri.fspath();
+					source.Name = source.Path.string();
+				} }, gltfImage.data);
+		}
+	}
+
+	// Pure cpu work, so it's safe to run on any thread
+	static bool ParseModel(std::filesystem::path filePath, std::vector<MeshData>& meshes, const MeshOptimizeSettings& settings = {},
+		Scene* scene = nullptr, std::vector<TextureSource>* images = nullptr)
 	{
 		auto gltfFile = fastgltf::GltfDataBuffer::FromPath(filePath);
-		constexpr auto gltfOptions = fastgltf::Options::LoadExternalBuffers;
+		if (gltfFile.error() != fastgltf::Error::None)
+		{
+			Logger::logger->Log("Failed to open \"" + filePath.string() + "\": " + std::string(fastgltf::getErrorMessage(gltfFile.error())), Severity::Error);
+			return false;
+		}
+		constexpr auto gltfOptions = fastgltf::Options::LoadExternalBuffers | fastgltf::Options::DecomposeNodeMatrices;
 		fastgltf::Parser parser{};
-		fastgltf::Asset gltf = std::move(parser.loadGltfBinary(gltfFile.get(), filePath.parent_path(), gltfOptions).get());
-		std::vector<std::shared_ptr<MeshAsset>> meshes;
-		std::vector<uint32_t> indices;
-		std::vector<Vertex> vertices;
+		auto asset = parser.loadGltfBinary(gltfFile.get(), filePath.parent_path(), gltfOptions);
+		if (asset.error() != fastgltf::Error::None)
+		{
+			Logger::logger->Log("Failed to parse \"" + filePath.string() + "\": " + std::string(fastgltf::getErrorMessage(asset.error())), Severity::Error);
+			return false;
+		}
+		fastgltf::Asset gltf = std::move(asset.get());
 
 		for (fastgltf::Mesh& mesh : gltf.meshes)
 		{
-			MeshAsset newmesh;
+			MeshData newmesh;
 			newmesh.name = mesh.name;
-
-			indices.clear();
-			vertices.clear();
+			std::vector<uint32_t>& indices = newmesh.indices;
+			std::vector<Vertex>& vertices = newmesh.vertices;
 
 			for (auto&& p : mesh.primitives)
 			{
 				GeoSurface newSurface = { (uint32_t)indices.size(), (uint32_t)gltf.accessors[p.indicesAccessor.value()].count };
 				size_t initial_vtx = vertices.size();
 
+				// Only the base colour texture for now, it's the image behind it that matters since those are what get uploaded
+				if (p.materialIndex && *p.materialIndex < gltf.materials.size())
+				{
+					const auto& baseColor = gltf.materials[*p.materialIndex].pbrData.baseColorTexture;
+					if (baseColor && baseColor->textureIndex < gltf.textures.size() && gltf.textures[baseColor->textureIndex].imageIndex)
+						newSurface.image = static_cast<uint32_t>(*gltf.textures[baseColor->textureIndex].imageIndex);
+				}
+
 				// Load indices
 				fastgltf::Accessor& indexaccessor = gltf.accessors[p.indicesAccessor.value()];
 				indices.reserve(indices.size() + indexaccessor.count);
@@ -105,8 +388,11 @@ namespace hyper
 				fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, posAccessor,
 					[&](glm::vec3 v, size_t index)
 					{
-						Vertex newvtx{ v, { 1, 0, 0 }, glm::vec4{ 1.0f }, { 0 , 0 } };
-						vertices[initial_vtx + index] = newvtx;
+						Vertex& newvtx = vertices[initial_vtx + index]; // Set in place, the resize zeroed the padding
+						newvtx.position = v;
+						newvtx.normal = { 1, 0, 0 };
+						newvtx.color = glm::vec4{ 1.0f };
+						newvtx.texCoord = { 0, 0 };
 					});
 
 				fastgltf::Attribute* normals = p.findAttribute("NORMAL"); // Vertex normals
@@ -141,14 +427,129 @@ namespace hyper
 				for (Vertex& vtx : vertices)
 					vtx.color = glm::vec4(vtx.normal, 1.f);
 
-			newmesh.vertexBuffer = CreateBufferStaged(allocator, commandPool, device, queue, vertices.size() * sizeof(vertices[0]),
-				vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress, vertices.data());
-			newmesh.indexBuffer = CreateBufferStaged(allocator, commandPool, device, queue, indices.size() * sizeof(indices[0]),
-				vk::BufferUsageFlagBits::eIndexBuffer, indices.data());
-			
-			meshes.push_back(std::make_shared<MeshAsset>(newmesh));
+			OptimizeMesh(newmesh, settings);
+			ComputeSurfaceBounds(newmesh);
+			if (settings.PackVertices)
+				PackMesh(newmesh);
+			meshes.push_back(std::move(newmesh));
 		}
 
+		if (scene)
+			ImportScene(gltf, *scene);
+		if (images)
+			ImportImages(gltf, filePath.parent_path(), *images);
+
+		return true;
+	}
+
+	// Uploads go into the upload context's current batch, flush and wait on it before drawing
+	static std::shared_ptr<MeshAsset> UploadMesh(GeometryPool& pool, UploadContext& upload, const MeshBlob& mesh)
+	{
+		std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
+		newmesh->name = mesh.name;
+		newmesh->surfaces.assign(mesh.surfaces, mesh.surfaces + mesh.surfaceCount);
+		newmesh->firstSurfaceId = NextSurfaceId.fetch_add(mesh.surfaceCount);
+		newmesh->vertexFormat = mesh.vertexFormat;
+		newmesh->positionOffset = mesh.positionOffset;
+		newmesh->positionScale = mesh.positionScale;
+		newmesh->indexType = mesh.indexType;
+
+		// Vertices are aligned to their own stride so the offset into the block is a whole number of vertices
+		vk::DeviceSize vertexStride = mesh.vertexFormat == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+		vk::DeviceSize indexSize = mesh.indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		newmesh->vertices = pool.Allocate(mesh.vertexCount * vertexStride, vertexStride);
+		pool.Upload(upload, newmesh->vertices, mesh.vertices);
+		newmesh->indices = pool.Allocate(mesh.indexCount * indexSize, sizeof(uint32_t), newmesh->vertices.Block);
+		pool.Upload(upload, newmesh->indices, mesh.indices);
+
+		if (newmesh->vertices.Block != ~0u)
+		{
+			newmesh->vertexBufferAddress = pool.GetAddress(newmesh->vertices.Block);
+			newmesh->vertexOffset = static_cast<int32_t>(newmesh->vertices.Offset / vertexStride);
+		}
+		if (newmesh->indices.Block != ~0u)
+		{
+			newmesh->indexBuffer = pool.GetBuffer(newmesh->indices.Block);
+			newmesh->firstIndex = static_cast<uint32_t>(newmesh->indices.Offset / indexSize);
+		}
+		return newmesh;
+	}
+
+	// Picks the vertex format and index size a MeshData gets uploaded with, shortIndices is the storage for 16 bit indices if they're used
+	static MeshBlob MakeMeshBlob(const MeshData& mesh, std::vector<uint16_t>& shortIndices)
+	{
+		MeshBlob blob{ mesh.name, mesh.surfaces.data(), static_cast<uint32_t>(mesh.surfaces.size()), mesh.vertices.data(), mesh.vertices.size() };
+		if (!mesh.packedVertices.empty())
+		{
+			blob.vertexFormat = VertexFormat::Packed;
+			blob.positionOffset = mesh.boundsMin;
+			blob.positionScale = glm::max(mesh.boundsMax - mesh.boundsMin, glm::vec3{ 1e-8f }); // Same as PackMesh
+			blob.vertices = mesh.packedVertices.data();
+			blob.vertexCount = mesh.packedVertices.size();
+		}
+
+		// Half the index bandwidth whenever every index fits in 16 bits
+		blob.indices = mesh.indices.data();
+		blob.indexCount = mesh.indices.size();
+		if (blob.vertexCount <= 65536)
+		{
+			shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+			blob.indices = shortIndices.data();
+			blob.indexType = vk::IndexType::eUint16;
+		}
+		return blob;
+	}
+
+	static std::shared_ptr<MeshAsset> UploadMesh(GeometryPool& pool, UploadContext& upload, const MeshData& mesh)
+	{
+		std::vector<uint16_t> shortIndices;
+		return UploadMesh(pool, upload, MakeMeshBlob(mesh, shortIndices));
+	}
+
+	static void FreeMesh(GeometryPool& pool, MeshAsset& mesh) // Only once the gpu is done with it
+	{
+		pool.Free(mesh.vertices);
+		pool.Free(mesh.indices);
+		mesh.vertices = mesh.indices = GeometryAllocation{};
+	}
+
+	// Blocking version, parses on the calling thread
+	static std::vector<std::shared_ptr<MeshAsset>> LoadModel(GeometryPool& pool, UploadContext& upload, std::filesystem::path filePath,
+		const MeshOptimizeSettings& settings = {})
+	{
+		std::vector<MeshData> meshData;
+		std::vector<std::shared_ptr<MeshAsset>> meshes;
+		if (!ParseModel(filePath, meshData, settings))
+			return meshes;
+		for (const MeshData& mesh : meshData)
+			meshes.push_back(UploadMesh(pool, upload, mesh));
 		return meshes;
 	}
+
+	// Unit cube, stands in for models that haven't finished loading yet
+	static MeshData MakePlaceholderMesh()
+	{
+		MeshData mesh;
+		mesh.name = "placeholder";
+		const std::array<glm::vec3, 6> normals{ glm::vec3{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		for (const glm::vec3& n : normals)
+		{ // Two axes perpendicular to the face normal, wound counter-clockwise when looking at the face
+			glm::vec3 u = glm::vec3{ n.y, n.z, n.x };
+			glm::vec3 v = glm::cross(n, u);
+			uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+			for (const glm::vec2& corner : { glm::vec2{ -1, -1 }, glm::vec2{ 1, -1 }, glm::vec2{ 1, 1 }, glm::vec2{ -1, 1 } })
+			{
+				Vertex& vertex = mesh.vertices.emplace_back();
+				vertex.position = (n + u * corner.x + v * corner.y) * 0.5f;
+				vertex.normal = n;
+				vertex.color = glm::vec4(n, 1.0f);
+				vertex.texCoord = corner * 0.5f + 0.5f;
+			}
+			for (uint32_t i : { 0u, 1u, 2u, 2u, 3u, 0u })
+				mesh.indices.push_back(base + i);
+		}
+		mesh.surfaces.push_back(GeoSurface{ 0, static_cast<uint32_t>(mesh.indices.size()) });
+		ComputeSurfaceBounds(mesh);
+		return mesh;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
+
+namespace hyper
+{
+	namespace
+	{
+		struct FifoCache // Timestamps instead of an actual queue, a vertex is cached if it missed less than cacheSize misses ago
+		{
+			std::vector<uint32_t> Stamps;
+			uint32_t Time;
+			uint32_t Size;
+
+			FifoCache(size_t vertexCount, uint32_t cacheSize) : Stamps(vertexCount, 0), Time(cacheSize + 1), Size(cacheSize) {}
+
+			bool Access(uint32_t vertex) // Returns true on a miss
+			{
+				if (Time - Stamps[vertex] <= Size)
+					return false;
+				Stamps[vertex] = Time++;
+				return true;
+			}
+			void Clear() { Time += Size + 1; }
+		};
+
+		uint64_t HashVertex(const unsigned char* vertex, size_t size)
+		{ // FNV-1a
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < size; i++)
+				hash = (hash ^ vertex[i]) * 1099511628211ull;
+			return hash;
+		}
+
+		void ReadPosition(const float* positions, size_t stride, uint32_t vertex, float out[3])
+		{
+			const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * stride);
+			out[0] = p[0]; out[1] = p[1]; out[2] = p[2];
+		}
+	}
+
+	VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheStats stats;
+		if (indexCount == 0 || vertexCount == 0)
+			return stats;
+
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<bool> used(vertexCount, false);
+		size_t usedCount = 0;
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			stats.Misses += cache.Access(indices[i]);
+			if (!used[indices[i]])
+			{
+				used[indices[i]] = true;
+				usedCount++;
+			}
+		}
+		stats.ACMR = static_cast<float>(stats.Misses) / static_cast<float>(indexCount / 3);
+		stats.ATVR = static_cast<float>(stats.Misses) / static_cast<float>(usedCount);
+		return stats;
+	}
+
+	size_t GenerateVertexRemap(std::vector<uint32_t>& remap, const void* vertices, size_t vertexCount, size_t vertexSize)
+	{
+		const unsigned char* data = static_cast<const unsigned char*>(vertices);
+		remap.assign(vertexCount, ~0u);
+
+		// Open addressing, power of two so the probe can just mask
+		size_t tableSize = 1;
+		while (tableSize < vertexCount * 2)
+			tableSize *= 2;
+		std::vector<uint32_t> table(tableSize, ~0u);
+
+		size_t unique = 0;
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			const unsigned char* vertex = data + i * vertexSize;
+			size_t slot = HashVertex(vertex, vertexSize) & (tableSize - 1);
+			while (table[slot] != ~0u && std::memcmp(data + table[slot] * vertexSize, vertex, vertexSize) != 0)
+				slot = (slot + 1) & (tableSize - 1);
+
+			if (table[slot] == ~0u)
+			{
+				table[slot] = static_cast<uint32_t>(i);
+				remap[i] = static_cast<uint32_t>(unique++);
+			}
+			else
+				remap[i] = remap[table[slot]];
+		}
+		return unique;
+	}
+
+	void RemapIndices(uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& remap)
+	{
+		for (size_t i = 0; i < indexCount; i++)
+			indices[i] = remap[indices[i]];
+	}
+
+	void RemapVertices(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const std::vector<uint32_t>& remap)
+	{ // destination can't be vertices, a later vertex could land on one that hasn't been read yet
+		for (size_t i = 0; i < vertexCount; i++)
+			if (remap[i] != ~0u)
+				std::memcpy(static_cast<unsigned char*>(destination) + remap[i] * vertexSize, static_cast<const unsigned char*>(vertices) + i * vertexSize,
+					vertexSize);
+	}
+
+	std::vector<uint32_t> OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		std::vector<uint32_t> clusters;
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return clusters;
+
+		// Vertex -> triangle adjacency, flattened
+		std::vector<uint32_t> liveTriangles(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; i++)
+			liveTriangles[indices[i]]++;
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] = offsets[v] + liveTriangles[v];
+		std::vector<uint32_t> adjacency(indexCount);
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++)
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnd; // Recently used vertices, the first place to look when fanning runs out
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+		uint32_t time = cacheSize + 1;
+		uint32_t cursor = 0;
+
+		int64_t fanning = indices[0];
+		clusters.push_back(0);
+		while (fanning >= 0)
+		{
+			candidates.clear();
+			for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+			{
+				uint32_t triangle = adjacency[a];
+				if (emitted[triangle])
+					continue;
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t v = indices[triangle * 3 + k];
+					output.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+					if (time - cacheTime[v] > cacheSize)
+						cacheTime[v] = time++;
+				}
+				emitted[triangle] = true;
+			}
+
+			// Next fanning vertex is whichever candidate will still be in the cache after its remaining triangles go out
+			int64_t next = -1;
+			int64_t best = -1;
+			for (uint32_t v : candidates)
+			{
+				if (liveTriangles[v] == 0)
+					continue;
+				int64_t priority = 0;
+				if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+					priority = time - cacheTime[v];
+				if (priority > best)
+				{
+					best = priority;
+					next = v;
+				}
+			}
+			if (next == -1)
+			{ // Dead end, nothing here is worth fanning around, which is a good spot for a cluster boundary
+				while (!deadEnd.empty() && next == -1)
+				{
+					uint32_t v = deadEnd.back();
+					deadEnd.pop_back();
+					if (liveTriangles[v] > 0)
+						next = v;
+				}
+				while (next == -1 && cursor < vertexCount)
+				{
+					if (liveTriangles[cursor] > 0)
+						next = cursor;
+					cursor++;
+				}
+				if (next != -1 && output.size() < indexCount)
+					clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+			}
+			fanning = next;
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+		return clusters;
+	}
+
+	void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t stride,
+		const std::vector<uint32_t>& clusters, uint32_t cacheSize, float threshold)
+	{
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Soft boundaries, the hard clusters are split again wherever the running ACMR is already good enough
+		std::vector<uint32_t> hard = clusters.empty() ? std::vector<uint32_t>{ 0 } : clusters;
+		hard.push_back(static_cast<uint32_t>(triangleCount));
+		std::vector<uint32_t> soft;
+		FifoCache cache(vertexCount, cacheSize);
+		for (size_t c = 0; c + 1 < hard.size(); c++)
+		{
+			uint32_t begin = hard[c], end = hard[c + 1];
+			uint32_t clusterMisses = 0;
+			cache.Clear();
+			for (uint32_t t = begin; t < end; t++)
+				for (uint32_t k = 0; k < 3; k++)
+					clusterMisses += cache.Access(indices[t * 3 + k]);
+			float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+			soft.push_back(begin);
+			uint32_t start = begin, misses = 0;
+			cache.Clear();
+			for (uint32_t t = begin; t < end; t++)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+					misses += cache.Access(indices[t * 3 + k]);
+				if (t + 1 < end && static_cast<float>(misses) / static_cast<float>(t + 1 - start) <= clusterThreshold)
+				{
+					soft.push_back(t + 1);
+					start = t + 1;
+					misses = 0;
+					cache.Clear();
+				}
+			}
+		}
+		soft.push_back(static_cast<uint32_t>(triangleCount));
+
+		// Mesh centroid, area weighted
+		float meshCentroid[3] = { 0, 0, 0 };
+		float meshArea = 0;
+		std::vector<float> clusterSort(soft.size() - 1);
+		std::vector<float> clusterData((soft.size() - 1) * 6, 0.0f); // Centroid * area, normal * area
+		for (size_t c = 0; c + 1 < soft.size(); c++)
+		{
+			float* data = &clusterData[c * 6];
+			for (uint32_t t = soft[c]; t < soft[c + 1]; t++)
+			{
+				float a[3], b[3], d[3];
+				ReadPosition(positions, stride, indices[t * 3 + 0], a);
+				ReadPosition(positions, stride, indices[t * 3 + 1], b);
+				ReadPosition(positions, stride, indices[t * 3 + 2], d);
+				float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+				float e1[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+				float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] }; // Length is twice the area
+				float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					float centroid = (a[k] + b[k] + d[k]) / 3.0f;
+					data[k] += centroid * area;
+					data[3 + k] += n[k];
+					meshCentroid[k] += centroid * area;
+				}
+				meshArea += area;
+			}
+		}
+		if (meshArea > 0)
+			for (float& k : meshCentroid)
+				k /= meshArea;
+
+		// Clusters further out along their own normal are more likely to be in front of the rest, so they go first
+		for (size_t c = 0; c + 1 < soft.size(); c++)
+		{
+			const float* data = &clusterData[c * 6];
+			float area = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+			float dot = 0;
+			if (area > 0)
+				for (uint32_t k = 0; k < 3; k++)
+					dot += (data[k] / area - meshCentroid[k]) * (data[3 + k] / area);
+			clusterSort[c] = dot;
+		}
+		std::vector<uint32_t> order(soft.size() - 1);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return clusterSort[a] > clusterSort[b]; });
+
+		std::vector<uint32_t> output;
+		output.reserve(triangleCount * 3);
+		for (uint32_t c : order)
+			output.insert(output.end(), indices + soft[c] * 3, indices + soft[c + 1] * 3);
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	size_t OptimizeVertexFetch(void* destination, uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize)
+	{
+		std::vector<uint32_t> remap(vertexCount, ~0u);
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			if (remap[indices[i]] == ~0u)
+				remap[indices[i]] = next++;
+			indices[i] = remap[indices[i]];
+		}
+		RemapVertices(destination, vertices, vertexCount, vertexSize, remap);
+		return next;
+	}
+}
\ No newline at end of file
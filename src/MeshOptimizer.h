@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace hyper
+{
+	// Load time index/vertex reordering, works on raw buffers so it doesn't care what the vertex layout is
+	// Order matters: dedup -> vertex cache -> overdraw -> vertex fetch, each step relies on the one before it
+	struct MeshOptimizeSettings
+	{
+		bool RemoveDuplicates = true;
+		bool OptimizeVertexCache = true;
+		bool OptimizeOverdraw = true;	// Needs the vertex cache pass to be useful, it sorts the clusters that pass makes
+		bool OptimizeVertexFetch = true;
+		uint32_t CacheSize = 16;		// Simulated post transform cache, 16 is a safe guess for most gpus
+		float OverdrawThreshold = 1.05f;	// How much worse the ACMR is allowed to get for better overdraw, 1 is no worse
+		bool PackVertices = true;		// Quantizes into PackedVertex after optimizing, see Mesh.h
+
+		static MeshOptimizeSettings None() { return { false, false, false, false, 16, 1.05f, false }; }
+	};
+
+	struct VertexCacheStats
+	{
+		uint32_t Misses = 0;
+		float ACMR = 0.0f; // Average cache miss ratio, misses per triangle, 0.5 is the best possible and 3 is the worst
+		float ATVR = 0.0f; // Average transformed vertex ratio, misses per vertex, 1 is perfect
+	};
+
+	VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+
+	// Fills remap with the new index of every vertex, identical vertices (bitwise) share one, returns how many are left
+	size_t GenerateVertexRemap(std::vector<uint32_t>& remap, const void* vertices, size_t vertexCount, size_t vertexSize);
+	void RemapIndices(uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& remap);
+	void RemapVertices(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const std::vector<uint32_t>& remap);
+
+	// Tipsify (Sander et al. 2007), linear time, reorders triangles in place and returns where each cluster of triangles starts
+	std::vector<uint32_t> OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+	// Splits the clusters up further, then sorts them so the ones facing out from the middle of the mesh are drawn first
+	// positions points at the first vertex's position (3 floats), stride is the vertex size
+	void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t stride,
+		const std::vector<uint32_t>& clusters, uint32_t cacheSize, float threshold);
+	// Reorders vertices into the order they're first used and drops unused ones, returns the new vertex count
+	size_t OptimizeVertexFetch(void* destination, uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize);
+}
\ No newline at end of file
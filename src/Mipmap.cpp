@@ -0,0 +1,233 @@
+#include "Mipmap.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HYPER_MIP_SSE
+#endif
+
+namespace hyper
+{
+	namespace
+	{
+		constexpr float KaiserRadius = 2.0f; // In destination pixels
+		constexpr float KaiserBeta = 4.0f;
+
+		struct Float4 // One RGBA pixel, a single register when there's SSE
+		{
+#if defined(HYPER_MIP_SSE)
+			__m128 V;
+			static Float4 Zero() { return { _mm_setzero_ps() }; }
+			static Float4 Load(const float* p) { return { _mm_loadu_ps(p) }; }
+			void Store(float* p) const { _mm_storeu_ps(p, V); }
+			void MulAdd(Float4 a, float w) { V = _mm_add_ps(V, _mm_mul_ps(a.V, _mm_set1_ps(w))); }
+#else
+			float V[4];
+			static Float4 Zero() { return { { 0, 0, 0, 0 } }; }
+			static Float4 Load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+			void Store(float* p) const { std::memcpy(p, V, sizeof(V)); }
+			void MulAdd(Float4 a, float w) { for (int i = 0; i < 4; i++) V[i] += a.V[i] * w; }
+#endif
+		};
+
+		struct Tap
+		{
+			uint32_t First, Count;
+			uint32_t Weights; // Into the weights array
+		};
+
+		float BesselI0(float x)
+		{ // Series expansion, converges quickly for the small arguments a Kaiser window needs
+			float sum = 1.0f, term = 1.0f;
+			for (int k = 1; k < 16; k++)
+			{
+				term *= (x * 0.5f / k) * (x * 0.5f / k);
+				sum += term;
+			}
+			return sum;
+		}
+
+		float Kaiser(float t)
+		{
+			float x = t / KaiserRadius;
+			if (std::abs(x) >= 1.0f)
+				return 0.0f;
+			float sinc = t == 0.0f ? 1.0f : std::sin(3.14159265f * t) / (3.14159265f * t);
+			return sinc * BesselI0(KaiserBeta * std::sqrt(1.0f - x * x)) / BesselI0(KaiserBeta);
+		}
+
+		// Weights for every destination pixel along one axis, the same for every row so they only get worked out once per pass
+		void BuildTaps(uint32_t srcSize, uint32_t dstSize, MipFilter filter, std::vector<Tap>& taps, std::vector<float>& weights)
+		{
+			float scale = static_cast<float>(srcSize) / static_cast<float>(dstSize);
+			taps.resize(dstSize);
+			weights.clear();
+			for (uint32_t x = 0; x < dstSize; x++)
+			{
+				Tap& tap = taps[x];
+				tap.Weights = static_cast<uint32_t>(weights.size());
+				float begin = x * scale, end = (x + 1) * scale, centre = (x + 0.5f) * scale;
+				int32_t first, last;
+				if (filter == MipFilter::Box)
+				{
+					first = static_cast<int32_t>(std::floor(begin));
+					last = static_cast<int32_t>(std::ceil(end)) - 1;
+				}
+				else
+				{
+					first = static_cast<int32_t>(std::floor(centre - KaiserRadius * scale));
+					last = static_cast<int32_t>(std::ceil(centre + KaiserRadius * scale));
+				}
+
+				// Edges clamp, taps that land outside fold back onto the border pixel
+				int32_t lo = std::max(first, 0), hi = std::min(last, static_cast<int32_t>(srcSize) - 1);
+				tap.First = static_cast<uint32_t>(lo);
+				tap.Count = static_cast<uint32_t>(hi - lo + 1);
+				weights.resize(weights.size() + tap.Count, 0.0f);
+				float* w = &weights[tap.Weights];
+				float total = 0.0f;
+				for (int32_t s = first; s <= last; s++)
+				{
+					float weight = filter == MipFilter::Box
+						? std::min(end, s + 1.0f) - std::max(begin, static_cast<float>(s)) // How much of the source pixel the destination covers
+						: Kaiser((s + 0.5f - centre) / scale);
+					w[std::min(std::max(s, lo), hi) - lo] += weight;
+					total += weight;
+				}
+				for (uint32_t i = 0; i < tap.Count; i++)
+					w[i] /= total;
+			}
+		}
+
+		float SrgbToLinear(float c) { return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f); }
+		float LinearToSrgb(float c) { return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f; }
+
+		void BoxEvenRGBA8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst)
+		{
+			uint32_t dstWidth = srcWidth / 2, dstHeight = srcHeight / 2;
+			for (uint32_t y = 0; y < dstHeight; y++)
+			{
+				const uint8_t* row0 = src + (y * 2) * srcWidth * 4;
+				const uint8_t* row1 = row0 + srcWidth * 4;
+				uint8_t* out = dst + y * dstWidth * 4;
+				uint32_t x = 0;
+#if defined(HYPER_MIP_SSE)
+				// 8 source pixels from each row make 4 destination pixels, widened to 16 bits so the sum of 4 can't overflow
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i two = _mm_set1_epi16(2);
+				for (; x + 4 <= dstWidth; x += 4)
+				{
+					__m128i result[2];
+					for (int half = 0; half < 2; half++)
+					{
+						__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + half * 16));
+						__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + half * 16));
+						__m128i sum01 = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)); // Pixels 0 and 1, both rows
+						__m128i sum23 = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+						__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(sum01, sum23), _mm_unpackhi_epi64(sum01, sum23)); // 0+1, 2+3
+						result[half] = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+					}
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(result[0], result[1]));
+				}
+#endif
+				for (; x < dstWidth; x++)
+					for (uint32_t c = 0; c < 4; c++)
+						out[x * 4 + c] = static_cast<uint8_t>((row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c] + 2) >> 2);
+			}
+		}
+	}
+
+	uint32_t MipLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+			levels++;
+		return levels;
+	}
+
+	void DownsampleRGBA8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, MipFilter filter, bool srgb)
+	{
+		uint32_t dstWidth = std::max(srcWidth / 2, 1u), dstHeight = std::max(srcHeight / 2, 1u);
+		if (filter == MipFilter::Box && !srgb && srcWidth % 2 == 0 && srcHeight % 2 == 0)
+		{ // Most textures end up here, every level of a power of two texture is even until one side hits 1
+			BoxEvenRGBA8(src, srcWidth, srcHeight, dst);
+			return;
+		}
+
+		// Separable, horizontal into a float buffer then vertical out of it
+		float decode[256];
+		for (uint32_t i = 0; i < 256; i++)
+			decode[i] = srgb ? SrgbToLinear(i / 255.0f) : i / 255.0f;
+
+		std::vector<Tap> taps;
+		std::vector<float> weights;
+		BuildTaps(srcWidth, dstWidth, filter, taps, weights);
+		std::vector<float> horizontal(static_cast<size_t>(dstWidth) * srcHeight * 4);
+		std::vector<float> row(static_cast<size_t>(srcWidth) * 4);
+		for (uint32_t y = 0; y < srcHeight; y++)
+		{
+			const uint8_t* in = src + static_cast<size_t>(y) * srcWidth * 4;
+			for (uint32_t x = 0; x < srcWidth * 4; x += 4)
+			{
+				row[x + 0] = decode[in[x + 0]];
+				row[x + 1] = decode[in[x + 1]];
+				row[x + 2] = decode[in[x + 2]];
+				row[x + 3] = in[x + 3] / 255.0f;
+			}
+			for (uint32_t x = 0; x < dstWidth; x++)
+			{
+				const Tap& tap = taps[x];
+				Float4 sum = Float4::Zero();
+				for (uint32_t i = 0; i < tap.Count; i++)
+					sum.MulAdd(Float4::Load(&row[(tap.First + i) * 4]), weights[tap.Weights + i]);
+				sum.Store(&horizontal[(static_cast<size_t>(y) * dstWidth + x) * 4]);
+			}
+		}
+
+		BuildTaps(srcHeight, dstHeight, filter, taps, weights);
+		float pixel[4];
+		for (uint32_t y = 0; y < dstHeight; y++)
+		{
+			const Tap& tap = taps[y];
+			uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+			for (uint32_t x = 0; x < dstWidth; x++)
+			{
+				Float4 sum = Float4::Zero();
+				for (uint32_t i = 0; i < tap.Count; i++)
+					sum.MulAdd(Float4::Load(&horizontal[(static_cast<size_t>(tap.First + i) * dstWidth + x) * 4]), weights[tap.Weights + i]);
+				sum.Store(pixel);
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					float value = std::min(std::max(pixel[c], 0.0f), 1.0f); // Kaiser has negative lobes, so it can overshoot
+					if (srgb && c < 3)
+						value = LinearToSrgb(value);
+					out[x * 4 + c] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+				}
+			}
+		}
+	}
+
+	MipChain GenerateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, MipFilter filter, bool srgb)
+	{
+		MipChain chain;
+		uint32_t levelCount = MipLevelCount(width, height);
+		size_t size = 0;
+		for (uint32_t level = 0, w = width, h = height; level < levelCount; level++, w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+		{
+			chain.Levels.push_back(MipLevel{ size, w, h });
+			size += static_cast<size_t>(w) * h * 4;
+		}
+
+		chain.Data.resize(size);
+		std::memcpy(chain.Data.data(), pixels, static_cast<size_t>(width) * height * 4);
+		for (uint32_t level = 1; level < levelCount; level++)
+		{
+			const MipLevel& parent = chain.Levels[level - 1];
+			DownsampleRGBA8(&chain.Data[parent.Offset], parent.Width, parent.Height, &chain.Data[chain.Levels[level].Offset], filter, srgb);
+		}
+		return chain;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace hyper
+{
+	// CPU side mip generation for RGBA8, meant for cooking assets ahead of time, runtime loads get their mips from blits on the gpu (see Image.h)
+	enum class MipFilter
+	{
+		Box,	// Plain 2x2 average, SSE2 when the level is an even size and not sRGB
+		Kaiser	// Kaiser windowed sinc, sharper than box without much ringing, slower
+	};
+
+	struct MipLevel
+	{
+		size_t Offset; // Into MipChain::Data
+		uint32_t Width, Height;
+	};
+	struct MipChain // Every level packed one after the other, level 0 first, same layout a buffer to image copy wants
+	{
+		std::vector<uint8_t> Data;
+		std::vector<MipLevel> Levels;
+	};
+
+	uint32_t MipLevelCount(uint32_t width, uint32_t height); // Down to and including 1x1
+
+	// Halves (rounding down) into dst, sRGB colour is filtered in linear space, alpha never is
+	void DownsampleRGBA8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, MipFilter filter, bool srgb);
+	// Each level is filtered from the one above it
+	MipChain GenerateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, MipFilter filter, bool srgb);
+}
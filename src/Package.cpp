@@ -0,0 +1,373 @@
+#include "Package.h"
+
+#include <fstream>
+#include <cstring>
+#include <type_traits>
+
+#include "Logger.h"
+
+namespace hyper
+{
+	namespace
+	{
+		constexpr char PackageMagic[4] = { 'H', 'P', 'K', 'G' };
+		constexpr uint64_t BlobAlignment = 16;
+
+		struct PackageHeader
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint64_t SourceHash;
+			uint32_t MeshCount, SurfaceCount, NodeCount, TextureCount, LevelCount, Padding;
+			uint64_t MeshTable, SurfaceTable, NodeTable, TextureTable, LevelTable, StringTable;
+		};
+		struct PackageMesh
+		{
+			uint32_t Name, NameLength;
+			uint32_t FirstSurface, SurfaceCount;
+			uint32_t VertexFormat, IndexSize;
+			uint64_t Vertices, VertexCount;
+			uint64_t Indices, IndexCount;
+			float PositionOffset[3], PositionScale[3];
+		};
+		struct PackageNode // Depth first, same order Scene keeps them in
+		{
+			uint32_t Parent;
+			int32_t Mesh;
+			uint32_t Name, NameLength;
+			float Translation[3], Rotation[4], Scale[3]; // Rotation is xyzw
+		};
+		struct PackageTextureEntry
+		{
+			uint32_t Name, NameLength;
+			uint32_t Format;
+			uint32_t FirstLevel, LevelCount;
+			uint32_t Padding;
+			uint64_t Data, Size;
+		};
+		struct PackageLevel
+		{
+			uint64_t Offset; // From the texture's data
+			uint32_t Width, Height;
+		};
+		// Surfaces go in as they are, so they can be used straight out of the mapping
+		static_assert(std::is_trivially_copyable<GeoSurface>::value && sizeof(GeoSurface) == 64, "GeoSurface layout is part of the package format");
+
+		uint64_t Align(uint64_t value) { return (value + BlobAlignment - 1) / BlobAlignment * BlobAlignment; }
+
+		struct Builder // Everything gets appended into one buffer, then it's a single write
+		{
+			std::vector<uint8_t> Bytes;
+			std::string Strings;
+
+			uint64_t Append(const void* data, size_t size)
+			{
+				uint64_t offset = Align(Bytes.size());
+				Bytes.resize(offset + size);
+				if (size)
+					std::memcpy(&Bytes[offset], data, size);
+				return offset;
+			}
+			template<typename T>
+			uint64_t AppendArray(const std::vector<T>& values) { return Append(values.data(), values.size() * sizeof(T)); }
+			uint32_t AddString(const std::string& value)
+			{
+				uint32_t offset = static_cast<uint32_t>(Strings.size());
+				Strings += value;
+				return offset;
+			}
+		};
+	}
+
+	void PackageWriter::AddMesh(const MeshData& mesh)
+	{
+		m_Meshes.push_back(&mesh);
+	}
+
+	void PackageWriter::SetScene(const Scene& scene)
+	{
+		m_Scene = &scene;
+	}
+
+	void PackageWriter::AddTexture(const std::string& name, const TextureData& texture)
+	{
+		m_Textures.emplace_back(name, &texture);
+	}
+
+	bool PackageWriter::Write(const std::filesystem::path& path, uint64_t sourceHash)
+	{
+		Builder builder;
+		builder.Bytes.resize(sizeof(PackageHeader)); // Filled in last, once every table's offset is known
+
+		std::vector<PackageMesh> meshes;
+		std::vector<GeoSurface> surfaces;
+		for (const MeshData* mesh : m_Meshes)
+		{
+			std::vector<uint16_t> shortIndices;
+			MeshBlob blob = MakeMeshBlob(*mesh, shortIndices);
+			uint64_t vertexSize = blob.vertexFormat == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+			uint32_t indexSize = blob.indexType == vk::IndexType::eUint16 ? 2 : 4;
+
+			PackageMesh entry{ builder.AddString(blob.name), static_cast<uint32_t>(blob.name.size()), static_cast<uint32_t>(surfaces.size()),
+				blob.surfaceCount, static_cast<uint32_t>(blob.vertexFormat), indexSize };
+			entry.Vertices = builder.Append(blob.vertices, blob.vertexCount * vertexSize);
+			entry.VertexCount = blob.vertexCount;
+			entry.Indices = builder.Append(blob.indices, blob.indexCount * indexSize);
+			entry.IndexCount = blob.indexCount;
+			std::memcpy(entry.PositionOffset, &blob.positionOffset, sizeof(entry.PositionOffset));
+			std::memcpy(entry.PositionScale, &blob.positionScale, sizeof(entry.PositionScale));
+			meshes.push_back(entry);
+			surfaces.insert(surfaces.end(), blob.surfaces, blob.surfaces + blob.surfaceCount);
+		}
+
+		std::vector<PackageNode> nodes;
+		if (m_Scene)
+			for (uint32_t node = 0; node < m_Scene->GetNodeCount(); node++)
+			{
+				glm::vec3 translation = m_Scene->GetTranslation(node), scale = m_Scene->GetScale(node);
+				glm::quat rotation = m_Scene->GetRotation(node);
+				nodes.push_back(PackageNode{ m_Scene->GetParent(node), m_Scene->GetMesh(node), builder.AddString(m_Scene->GetName(node)),
+					static_cast<uint32_t>(m_Scene->GetName(node).size()), { translation.x, translation.y, translation.z },
+					{ rotation.x, rotation.y, rotation.z, rotation.w }, { scale.x, scale.y, scale.z } });
+			}
+
+		std::vector<PackageTextureEntry> textures;
+		std::vector<PackageLevel> levels;
+		for (const std::pair<std::string, const TextureData*>& texture : m_Textures)
+		{
+			const MipChain& chain = texture.second->Chain;
+			textures.push_back(PackageTextureEntry{ builder.AddString(texture.first), static_cast<uint32_t>(texture.first.size()),
+				static_cast<uint32_t>(texture.second->Format), static_cast<uint32_t>(levels.size()), static_cast<uint32_t>(chain.Levels.size()), 0,
+				builder.AppendArray(chain.Data), chain.Data.size() });
+			for (const MipLevel& level : chain.Levels)
+				levels.push_back(PackageLevel{ level.Offset, level.Width, level.Height });
+		}
+
+		PackageHeader header{ { PackageMagic[0], PackageMagic[1], PackageMagic[2], PackageMagic[3] }, PackageVersion, sourceHash,
+			static_cast<uint32_t>(meshes.size()), static_cast<uint32_t>(surfaces.size()), static_cast<uint32_t>(nodes.size()),
+			static_cast<uint32_t>(textures.size()), static_cast<uint32_t>(levels.size()), 0 };
+		header.MeshTable = builder.AppendArray(meshes);
+		header.SurfaceTable = builder.AppendArray(surfaces);
+		header.NodeTable = builder.AppendArray(nodes);
+		header.TextureTable = builder.AppendArray(textures);
+		header.LevelTable = builder.AppendArray(levels);
+		header.StringTable = builder.Append(builder.Strings.data(), builder.Strings.size());
+		std::memcpy(builder.Bytes.data(), &header, sizeof(header));
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open() || !file.write(reinterpret_cast<const char*>(builder.Bytes.data()), builder.Bytes.size()))
+		{
+			Logger::logger->Log("Couldn't write package " + path.string(), Severity::Error);
+			return false;
+		}
+		return true;
+	}
+
+	bool Package::Open(const std::filesystem::path& path)
+	{
+		if (!m_File.Open(path))
+			return false;
+		if (!Validate(path))
+		{ // Old or broken, either way it's getting cooked again
+			m_File.Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool Package::Validate(const std::filesystem::path& path) const
+	{
+		uint64_t fileSize = m_File.GetSize();
+		const PackageHeader* header = At<PackageHeader>(0);
+		if (fileSize < sizeof(PackageHeader) || std::memcmp(header->Magic, PackageMagic, sizeof(PackageMagic)) != 0 || header->Version != PackageVersion)
+			return false; // Not a package or an older one, nothing to warn about
+
+		auto corrupt = [&](const char* what)
+		{
+			HYPER_LOG(Severity::Warning, "Package {} is corrupt ({}), cooking it again", path, what);
+			return false;
+		};
+		// Everything is written 16 byte aligned, so anything that isn't is corrupt too (and couldn't be read in place anyway)
+		auto fits = [&](uint64_t offset, uint64_t count, uint64_t elementSize)
+		{
+			return offset % BlobAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+		};
+		if (!fits(header->MeshTable, header->MeshCount, sizeof(PackageMesh)) || !fits(header->SurfaceTable, header->SurfaceCount, sizeof(GeoSurface))
+			|| !fits(header->NodeTable, header->NodeCount, sizeof(PackageNode)) || !fits(header->TextureTable, header->TextureCount, sizeof(PackageTextureEntry))
+			|| !fits(header->LevelTable, header->LevelCount, sizeof(PackageLevel)) || !fits(header->StringTable, 0, 1))
+			return corrupt("a table runs past the end");
+		uint64_t stringsSize = fileSize - header->StringTable; // Always last
+		auto stringFits = [&](uint64_t offset, uint64_t length) { return offset <= stringsSize && length <= stringsSize - offset; };
+
+		const GeoSurface* surfaces = At<GeoSurface>(header->SurfaceTable);
+		for (uint32_t i = 0; i < header->MeshCount; i++)
+		{
+			const PackageMesh& mesh = At<PackageMesh>(header->MeshTable)[i];
+			if (!stringFits(mesh.Name, mesh.NameLength))
+				return corrupt("mesh name");
+			if (mesh.VertexFormat > static_cast<uint32_t>(VertexFormat::Packed) || (mesh.IndexSize != 2 && mesh.IndexSize != 4))
+				return corrupt("mesh format");
+			uint64_t vertexSize = mesh.VertexFormat == static_cast<uint32_t>(VertexFormat::Packed) ? sizeof(PackedVertex) : sizeof(Vertex);
+			if (!fits(mesh.Vertices, mesh.VertexCount, vertexSize) || !fits(mesh.Indices, mesh.IndexCount, mesh.IndexSize))
+				return corrupt("mesh data runs past the end");
+			if (static_cast<uint64_t>(mesh.FirstSurface) + mesh.SurfaceCount > header->SurfaceCount)
+				return corrupt("mesh surfaces");
+			for (uint32_t surface = mesh.FirstSurface; surface < mesh.FirstSurface + mesh.SurfaceCount; surface++)
+			{
+				if (static_cast<uint64_t>(surfaces[surface].startIndex) + surfaces[surface].count > mesh.IndexCount)
+					return corrupt("surface index range");
+				if (surfaces[surface].image != NoImage && surfaces[surface].image >= header->TextureCount)
+					return corrupt("surface image");
+			}
+
+			// The vertex shader pulls by index with nothing bounds checking it on the gpu, so a bad one here would read past the mesh
+			bool indicesFit = true;
+			if (mesh.IndexSize == 2)
+			{
+				const uint16_t* indices = At<uint16_t>(mesh.Indices);
+				for (uint64_t index = 0; index < mesh.IndexCount; index++)
+					indicesFit &= indices[index] < mesh.VertexCount;
+			}
+			else
+			{
+				const uint32_t* indices = At<uint32_t>(mesh.Indices);
+				for (uint64_t index = 0; index < mesh.IndexCount; index++)
+					indicesFit &= indices[index] < mesh.VertexCount;
+			}
+			if (!indicesFit)
+				return corrupt("index out of range");
+		}
+
+		for (uint32_t i = 0; i < header->NodeCount; i++)
+		{ // Depth first, so a parent always comes before its children
+			const PackageNode& node = At<PackageNode>(header->NodeTable)[i];
+			if (!stringFits(node.Name, node.NameLength))
+				return corrupt("node name");
+			if ((node.Parent != Scene::NoParent && node.Parent >= i) || node.Mesh < -1 || node.Mesh >= static_cast<int64_t>(header->MeshCount))
+				return corrupt("node links");
+		}
+
+		for (uint32_t i = 0; i < header->TextureCount; i++)
+		{
+			const PackageTextureEntry& texture = At<PackageTextureEntry>(header->TextureTable)[i];
+			vk::Format format = static_cast<vk::Format>(texture.Format);
+			if (!stringFits(texture.Name, texture.NameLength))
+				return corrupt("texture name");
+			if (TextureLevelBytes(format, 1, 1) == 0)
+				return corrupt("texture format");
+			if (!fits(texture.Data, texture.Size, 1) || static_cast<uint64_t>(texture.FirstLevel) + texture.LevelCount > header->LevelCount)
+				return corrupt("texture data runs past the end");
+			const PackageLevel* levels = At<PackageLevel>(header->LevelTable) + texture.FirstLevel;
+			if (texture.LevelCount == 0 || levels[0].Width == 0 || levels[0].Height == 0
+				|| texture.LevelCount > MipLevelCount(levels[0].Width, levels[0].Height))
+				return corrupt("texture level count");
+			for (uint32_t level = 0; level < texture.LevelCount; level++)
+			{
+				uint64_t bytes = TextureLevelBytes(format, levels[level].Width, levels[level].Height);
+				if (levels[level].Width == 0 || levels[level].Height == 0 || levels[level].Offset > texture.Size || bytes > texture.Size - levels[level].Offset)
+					return corrupt("texture level runs past its data");
+			}
+		}
+		return true;
+	}
+
+	uint64_t Package::GetSourceHash() const
+	{
+		return At<PackageHeader>(0)->SourceHash;
+	}
+
+	uint32_t Package::GetMeshCount() const
+	{
+		return At<PackageHeader>(0)->MeshCount;
+	}
+
+	MeshBlob Package::GetMesh(uint32_t index) const
+	{
+		const PackageHeader* header = At<PackageHeader>(0);
+		const PackageMesh& mesh = At<PackageMesh>(header->MeshTable)[index];
+		MeshBlob blob;
+		blob.name.assign(At<char>(header->StringTable + mesh.Name), mesh.NameLength);
+		blob.surfaces = At<GeoSurface>(header->SurfaceTable) + mesh.FirstSurface;
+		blob.surfaceCount = mesh.SurfaceCount;
+		blob.vertices = At<uint8_t>(mesh.Vertices);
+		blob.vertexCount = mesh.VertexCount;
+		blob.vertexFormat = static_cast<VertexFormat>(mesh.VertexFormat);
+		blob.positionOffset = glm::vec3{ mesh.PositionOffset[0], mesh.PositionOffset[1], mesh.PositionOffset[2] };
+		blob.positionScale = glm::vec3{ mesh.PositionScale[0], mesh.PositionScale[1], mesh.PositionScale[2] };
+		blob.indices = At<uint8_t>(mesh.Indices);
+		blob.indexCount = mesh.IndexCount;
+		blob.indexType = mesh.IndexSize == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+		return blob;
+	}
+
+	void Package::LoadScene(Scene& scene) const
+	{
+		const PackageHeader* header = At<PackageHeader>(0);
+		const PackageNode* nodes = At<PackageNode>(header->NodeTable);
+		scene.Clear();
+		for (uint32_t i = 0; i < header->NodeCount; i++)
+		{
+			const PackageNode& node = nodes[i];
+			scene.AddNode(node.Parent, std::string(At<char>(header->StringTable + node.Name), node.NameLength),
+				glm::vec3{ node.Translation[0], node.Translation[1], node.Translation[2] },
+				glm::quat{ node.Rotation[3], node.Rotation[0], node.Rotation[1], node.Rotation[2] }, // glm's constructor is wxyz
+				glm::vec3{ node.Scale[0], node.Scale[1], node.Scale[2] }, node.Mesh);
+		}
+	}
+
+	uint32_t Package::GetTextureCount() const
+	{
+		return At<PackageHeader>(0)->TextureCount;
+	}
+
+	PackageTexture Package::GetTexture(uint32_t index) const
+	{
+		const PackageHeader* header = At<PackageHeader>(0);
+		const PackageTextureEntry& entry = At<PackageTextureEntry>(header->TextureTable)[index];
+		PackageTexture texture{ std::string(At<char>(header->StringTable + entry.Name), entry.NameLength), static_cast<vk::Format>(entry.Format),
+			At<uint8_t>(entry.Data), entry.Size };
+		const PackageLevel* levels = At<PackageLevel>(header->LevelTable) + entry.FirstLevel;
+		for (uint32_t level = 0; level < entry.LevelCount; level++)
+			texture.Levels.push_back(MipLevel{ levels[level].Offset, levels[level].Width, levels[level].Height });
+		return texture;
+	}
+
+	uint64_t HashModelSource(const std::filesystem::path& path, const MeshOptimizeSettings& settings)
+	{
+		MappedFile source;
+		if (!source.Open(path))
+			return 0;
+		uint64_t hash = HashBytes(source.GetData(), source.GetSize());
+
+		// Buffers and images can be files of their own, so they go into the hash too, only their lists get parsed for it
+		auto gltfFile = fastgltf::GltfDataBuffer::FromBytes(reinterpret_cast<const std::byte*>(source.GetData()), source.GetSize());
+		if (gltfFile.error() != fastgltf::Error::None)
+			return 0;
+		fastgltf::Parser parser{};
+		auto asset = parser.loadGltf(gltfFile.get(), path.parent_path(), fastgltf::Options::None,
+			fastgltf::Category::Buffers | fastgltf::Category::BufferViews | fastgltf::Category::Images);
+		if (asset.error() != fastgltf::Error::None)
+			return 0; // Parsing it for real fails too and says why, 0 never matches a package so nothing gets used or written
+		std::vector<const fastgltf::URI*> external;
+		for (const fastgltf::Buffer& buffer : asset->buffers)
+			if (const fastgltf::sources::URI* uri = std::get_if<fastgltf::sources::URI>(&buffer.data))
+				external.push_back(&uri->uri);
+		for (const fastgltf::Image& image : asset->images)
+			if (const fastgltf::sources::URI* uri = std::get_if<fastgltf::sources::URI>(&image.data))
+				external.push_back(&uri->uri);
+		for (const fastgltf::URI* uri : external)
+		{
+			MappedFile file;
+			if (!uri->isLocalPath() || !file.Open(path.parent_path() / uri->fspath()))
+				return 0; // Missing, the model can't load fully so it shouldn't be cooked
+			hash = HashBytes(file.GetData(), file.GetSize(), hash);
+		}
+
+		// Field by field, the struct has padding in it
+		uint32_t flags = settings.RemoveDuplicates | settings.OptimizeVertexCache << 1 | settings.OptimizeOverdraw << 2 | settings.OptimizeVertexFetch << 3
+			| settings.PackVertices << 4;
+		uint32_t values[4] = { flags, settings.CacheSize, 0, PackageVersion };
+		std::memcpy(&values[2], &settings.OverdrawThreshold, sizeof(float));
+		return HashBytes(values, sizeof(values), hash);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <filesystem>
+
+#include "Mesh.h"
+#include "Ktx.h"
+#include "MappedFile.h"
+#include "Hash.h"
+
+namespace hyper
+{
+	// Cooked asset package (.hpkg), everything in it is already in the layout the gpu wants so loading is a memory map and some memcpys
+	// Little endian, blobs are 16 byte aligned so they can go straight into staging memory
+	// The header holds a hash of whatever it was cooked from, a package with the wrong hash or version is stale and gets cooked again
+	constexpr uint32_t PackageVersion = 3; // 2: the model's own images get cooked in, 3: surfaces know which of them they're drawn with
+
+	struct PackageTexture // Points into the mapped file, only valid while the package is open
+	{
+		std::string Name;
+		vk::Format Format;
+		const uint8_t* Data;
+		size_t Size;
+		std::vector<MipLevel> Levels; // Offsets are from Data
+	};
+
+	class PackageWriter // Only keeps pointers, everything added has to outlive Write
+	{
+	public:
+		void AddMesh(const MeshData& mesh); // Stored exactly as UploadMesh would upload it
+		void SetScene(const Scene& scene);
+		void AddTexture(const std::string& name, const TextureData& texture);
+		bool Write(const std::filesystem::path& path, uint64_t sourceHash);
+
+	private:
+		std::vector<const MeshData*> m_Meshes;
+		const Scene* m_Scene = nullptr;
+		std::vector<std::pair<std::string, const TextureData*>> m_Textures;
+	};
+
+	class Package
+	{
+	public:
+		// False for anything that isn't a package of this version, or is corrupt, every table, blob, string and index is checked against the file here so the getters can trust it
+		bool Open(const std::filesystem::path& path);
+		void Close() { m_File.Close(); }
+
+		uint64_t GetSourceHash() const;
+		uint32_t GetMeshCount() const;
+		MeshBlob GetMesh(uint32_t index) const; // Pointers into the mapped file
+		void LoadScene(Scene& scene) const;
+		uint32_t GetTextureCount() const;
+		PackageTexture GetTexture(uint32_t index) const;
+
+	private:
+		bool Validate(const std::filesystem::path& path) const;
+		template<typename T>
+		const T* At(uint64_t offset) const { return reinterpret_cast<const T*>(m_File.GetData() + offset); }
+
+		MappedFile m_File;
+	};
+
+	// The source file's contents, every buffer and image file it points to, the optimize settings and the package version, any of them changing means a recook
+	uint64_t HashModelSource(const std::filesystem::path& path, const MeshOptimizeSettings& settings);
+}
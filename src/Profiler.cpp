@@ -0,0 +1,269 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <cfloat>
+
+#include "imgui.h"
+
+#include "Logger.h"
+
+namespace hyper
+{
+	Profiler* Profiler::profiler; // Same deal as the logger
+
+	namespace
+	{
+		std::atomic<uint32_t> nextThread{ 0 };
+		thread_local uint32_t threadIndex = nextThread++; // Small and stable, so the trace groups scopes by thread
+		thread_local uint32_t threadDepth = 0;
+
+		float Percentile(std::vector<float> values, float percentile) // By value, nth_element shuffles it
+		{
+			if (values.empty())
+				return 0.0f;
+			size_t index = std::min(values.size() - 1, static_cast<size_t>(percentile * values.size()));
+			std::nth_element(values.begin(), values.begin() + index, values.end());
+			return values[index];
+		}
+
+		void WriteEscaped(std::ofstream& file, const char* text)
+		{
+			for (; *text; text++)
+			{
+				if (*text == '"' || *text == '\\')
+					file << '\\';
+				file << *text;
+			}
+		}
+
+		void WriteTraceEvent(std::ofstream& file, bool& first, const ProfileEvent& event, uint32_t thread)
+		{ // Complete events, ts and dur are in microseconds
+			file << (first ? "\n" : ",\n") << "{\"name\":\"";
+			WriteEscaped(file, event.Name);
+			file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread << ",\"ts\":" << event.Start / 1000.0 << ",\"dur\":" << (event.End - event.Start) / 1000.0 << "}";
+			first = false;
+		}
+	}
+
+	void Profiler::CreateProfiler(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight)
+	{
+		m_Device = device;
+		uint32_t validBits = physicalDevice.getQueueFamilyProperties()[queueFamily].timestampValidBits;
+		vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+		if (validBits == 0 || limits.timestampPeriod == 0.0f)
+		{
+			Logger::logger->Log("Queue family " + std::to_string(queueFamily) + " can't write timestamps, only cpu scopes will be profiled", Severity::Warning);
+			return;
+		}
+		m_TimestampPeriod = limits.timestampPeriod;
+		m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		m_GpuFrames.resize(framesInFlight);
+		m_QueryPool = m_Device.createQueryPoolUnique(vk::QueryPoolCreateInfo{ {}, vk::QueryType::eTimestamp,
+			framesInFlight * ProfileFrame::MaxGpuEvents * 2 }); // A begin and an end for every scope
+		Logger::logger->Log("Profiler created: " + std::to_string(validBits) + " bit timestamps, " + std::to_string(m_TimestampPeriod) + "ns per tick");
+	}
+
+	void Profiler::DestroyProfiler()
+	{
+		m_QueryPool.reset();
+		m_GpuFrames.clear();
+	}
+
+	void Profiler::BeginFrame()
+	{
+		uint64_t number = m_FrameNumber.load(std::memory_order_relaxed) + 1;
+		ProfileFrame& frame = m_Frames[number % FrameHistory];
+		frame.Number = number;
+		frame.Start = Now();
+		frame.End = 0;
+		frame.CpuCount.store(0, std::memory_order_relaxed);
+		frame.GpuCount = 0;
+		m_MainThread = threadIndex;
+		m_FrameNumber.store(number, std::memory_order_release); // Scopes can only find the slot once it's been cleared
+	}
+
+	void Profiler::EndFrame()
+	{
+		uint64_t number = m_FrameNumber.load(std::memory_order_relaxed);
+		if (number != 0)
+			m_Frames[number % FrameHistory].End = Now();
+	}
+
+	ProfileEvent* Profiler::BeginScope(const char* name)
+	{
+		uint64_t number = m_FrameNumber.load(std::memory_order_acquire);
+		if (number == 0)
+			return nullptr;
+		ProfileFrame& frame = m_Frames[number % FrameHistory];
+		uint32_t slot = frame.CpuCount.fetch_add(1, std::memory_order_relaxed);
+		if (slot >= ProfileFrame::MaxCpuEvents)
+			return nullptr; // Count keeps going past the end, readers clamp it
+
+		ProfileEvent& event = frame.Cpu[slot];
+		event = ProfileEvent{ name, Now(), 0, threadIndex, threadDepth++ };
+		return &event;
+	}
+
+	void Profiler::EndScope(ProfileEvent* event)
+	{
+		event->End = Now();
+		threadDepth--;
+	}
+
+	void Profiler::BeginGpuFrame(vk::CommandBuffer commandBuffer, uint32_t frameSlot)
+	{
+		if (!m_QueryPool)
+			return;
+		m_GpuSlot = frameSlot;
+		GpuFrame& gpuFrame = m_GpuFrames[frameSlot];
+		gpuFrame.FrameNumber = m_FrameNumber.load(std::memory_order_relaxed);
+		gpuFrame.Count = 0;
+		commandBuffer.resetQueryPool(m_QueryPool.get(), frameSlot * ProfileFrame::MaxGpuEvents * 2, ProfileFrame::MaxGpuEvents * 2);
+	}
+
+	uint32_t Profiler::BeginGpuScope(vk::CommandBuffer commandBuffer, const char* name)
+	{
+		if (!m_QueryPool || m_GpuFrames[m_GpuSlot].Count >= ProfileFrame::MaxGpuEvents)
+			return ~0u;
+		GpuFrame& gpuFrame = m_GpuFrames[m_GpuSlot];
+		uint32_t scope = gpuFrame.Count++;
+		gpuFrame.Names[scope] = name;
+		commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, m_QueryPool.get(), (m_GpuSlot * ProfileFrame::MaxGpuEvents + scope) * 2);
+		return scope;
+	}
+
+	void Profiler::EndGpuScope(vk::CommandBuffer commandBuffer, uint32_t scope)
+	{
+		if (scope == ~0u)
+			return;
+		commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, m_QueryPool.get(), (m_GpuSlot * ProfileFrame::MaxGpuEvents + scope) * 2 + 1);
+	}
+
+	void Profiler::SubmitGpuFrame()
+	{
+		if (m_QueryPool)
+			m_GpuFrames[m_GpuSlot].SubmitTime = Now();
+	}
+
+	void Profiler::CollectGpu(uint32_t frameSlot)
+	{
+		if (!m_QueryPool)
+			return;
+		GpuFrame& gpuFrame = m_GpuFrames[frameSlot];
+		uint64_t number = gpuFrame.FrameNumber;
+		gpuFrame.FrameNumber = 0;
+		if (number == 0 || gpuFrame.Count == 0)
+			return;
+
+		// No wait flag, the fence already covered it, and a scope that never got ended shouldn't hang the frame
+		std::vector<uint64_t> timestamps(gpuFrame.Count * 2);
+		vk::Result result = m_Device.getQueryPoolResults(m_QueryPool.get(), frameSlot * ProfileFrame::MaxGpuEvents * 2, gpuFrame.Count * 2,
+			timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+		ProfileFrame& frame = m_Frames[number % FrameHistory];
+		if (result != vk::Result::eSuccess || frame.Number != number)
+			return; // Not ready, or the frame it belongs to already fell out of the ring
+
+		auto toCpu = [&](uint64_t timestamp)
+			{
+				uint64_t ticks = (timestamp - timestamps[0]) & m_TimestampMask; // Masked so a counter wrapping mid frame still comes out right
+				return gpuFrame.SubmitTime + static_cast<uint64_t>(ticks * static_cast<double>(m_TimestampPeriod));
+			};
+		for (uint32_t scope = 0; scope < gpuFrame.Count; scope++)
+			frame.Gpu[scope] = ProfileEvent{ gpuFrame.Names[scope], toCpu(timestamps[scope * 2]), toCpu(timestamps[scope * 2 + 1]), 0, 0 };
+		frame.GpuCount = gpuFrame.Count;
+	}
+
+	void Profiler::DrawImGui()
+	{
+		uint64_t current = m_FrameNumber.load(std::memory_order_relaxed);
+		std::vector<float> cpuTimes, gpuTimes; // Milliseconds, oldest first
+		cpuTimes.reserve(FrameHistory);
+		gpuTimes.reserve(FrameHistory);
+		const ProfileFrame* latest = nullptr;
+		for (uint64_t number = current > FrameHistory ? current - FrameHistory + 1 : 1; number < current; number++)
+			if (const ProfileFrame* frame = GetFrame(number))
+			{
+				cpuTimes.push_back((frame->End - frame->Start) / 1e6f);
+				if (frame->GpuCount > 0) // The first gpu scope is the one around the whole command buffer
+					gpuTimes.push_back((frame->Gpu[0].End - frame->Gpu[0].Start) / 1e6f);
+				latest = frame;
+			}
+
+		ImGui::Begin("Profiler");
+		char overlay[96];
+		snprintf(overlay, sizeof(overlay), "p50 %.2f  p95 %.2f  p99 %.2f", Percentile(cpuTimes, 0.5f), Percentile(cpuTimes, 0.95f), Percentile(cpuTimes, 0.99f));
+		ImGui::PlotLines("Cpu (ms)", cpuTimes.data(), static_cast<int>(cpuTimes.size()), 0, overlay, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+		snprintf(overlay, sizeof(overlay), "p50 %.2f  p95 %.2f  p99 %.2f", Percentile(gpuTimes, 0.5f), Percentile(gpuTimes, 0.95f), Percentile(gpuTimes, 0.99f));
+		ImGui::PlotLines("Gpu (ms)", gpuTimes.data(), static_cast<int>(gpuTimes.size()), 0, overlay, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+
+		if (latest && ImGui::CollapsingHeader("Last frame", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			uint32_t cpuCount = std::min(latest->CpuCount.load(std::memory_order_relaxed), ProfileFrame::MaxCpuEvents);
+			for (uint32_t i = 0; i < cpuCount; i++)
+			{
+				const ProfileEvent& event = latest->Cpu[i];
+				if (event.End != 0)
+					ImGui::Text("%*s%s: %.3fms (thread %u)", event.Depth * 2, "", event.Name, (event.End - event.Start) / 1e6f, event.Thread);
+			}
+			for (uint32_t i = 0; i < latest->GpuCount; i++)
+				ImGui::Text("gpu %s: %.3fms", latest->Gpu[i].Name, (latest->Gpu[i].End - latest->Gpu[i].Start) / 1e6f);
+		}
+
+		if (ImGui::Button("Write Chrome trace"))
+			m_TraceStatus = WriteChromeTrace("profile.json") ? "Wrote profile.json" : "Couldn't write profile.json";
+		if (!m_TraceStatus.empty())
+			ImGui::Text("%s", m_TraceStatus.c_str());
+		ImGui::End();
+	}
+
+	bool Profiler::WriteChromeTrace(const std::filesystem::path& path) const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open())
+		{
+			Logger::logger->Log("Couldn't open " + path.string() + " to write a trace to", Severity::Error);
+			return false;
+		}
+
+		constexpr uint32_t GpuThread = 1000; // Its own row below the cpu threads
+		file << std::fixed << std::setprecision(3); // Default precision goes to scientific notation a few seconds in
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		file << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GpuThread << ",\"args\":{\"name\":\"Gpu\"}}";
+		bool first = false; // The metadata went first
+		uint64_t current = m_FrameNumber.load(std::memory_order_relaxed);
+		for (uint64_t number = current > FrameHistory ? current - FrameHistory + 1 : 1; number < current; number++)
+		{
+			const ProfileFrame* frame = GetFrame(number);
+			if (!frame)
+				continue;
+			WriteTraceEvent(file, first, ProfileEvent{ "Frame", frame->Start, frame->End, 0, 0 }, m_MainThread); // Everything on the main thread nests under it
+			uint32_t cpuCount = std::min(frame->CpuCount.load(std::memory_order_relaxed), ProfileFrame::MaxCpuEvents);
+			for (uint32_t i = 0; i < cpuCount; i++)
+				if (frame->Cpu[i].End != 0)
+					WriteTraceEvent(file, first, frame->Cpu[i], frame->Cpu[i].Thread);
+			for (uint32_t i = 0; i < frame->GpuCount; i++)
+				WriteTraceEvent(file, first, frame->Gpu[i], GpuThread);
+		}
+		file << "\n]}\n";
+
+		Logger::logger->Log("Trace written to " + path.string());
+		return static_cast<bool>(file);
+	}
+
+	uint64_t Profiler::Now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Epoch).count();
+	}
+
+	const ProfileFrame* Profiler::GetFrame(uint64_t number) const
+	{
+		uint64_t current = m_FrameNumber.load(std::memory_order_relaxed);
+		if (number == 0 || number >= current || number + FrameHistory <= current)
+			return nullptr;
+		const ProfileFrame& frame = m_Frames[number % FrameHistory];
+		return frame.Number == number && frame.End != 0 ? &frame : nullptr;
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <filesystem>
+#include <vulkan/vulkan.hpp>
+
+namespace hyper
+{
+	struct ProfileEvent // Nanoseconds since the profiler was made, gpu events get moved onto the same clock
+	{
+		const char* Name; // String literals only, nothing gets copied
+		uint64_t Start;
+		uint64_t End;
+		uint32_t Thread;
+		uint32_t Depth;
+	};
+
+	struct ProfileFrame
+	{
+		static constexpr uint32_t MaxCpuEvents = 128, MaxGpuEvents = 16;
+
+		uint64_t Number = 0;
+		uint64_t Start = 0, End = 0;
+		std::array<ProfileEvent, MaxCpuEvents> Cpu;
+		std::atomic<uint32_t> CpuCount{ 0 }; // Claimed with a fetch_add, so any thread can add a scope without a lock
+		std::array<ProfileEvent, MaxGpuEvents> Gpu;
+		uint32_t GpuCount = 0; // Filled in a few frames later, once the gpu's done with it
+	};
+
+	// Scoped cpu timers and gpu timestamp queries, the last FrameHistory frames are kept in a ring
+	// Only the current frame's slot is ever written to, so threads recording scopes never wait on each other or on the ui reading older frames
+	class Profiler
+	{
+	public:
+		static Profiler* profiler; // Global like the logger, so scopes can go anywhere without passing it around
+		static constexpr uint32_t FrameHistory = 256;
+
+		Profiler() { profiler = this; }
+		~Profiler() { if (profiler == this) profiler = nullptr; } // Scopes after this just don't record
+
+		// Queries are optional, without a device (or timestamp support) only the cpu side works
+		void CreateProfiler(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight);
+		void DestroyProfiler();
+
+		void BeginFrame(); // Main thread, before anything else that frame
+		void EndFrame();
+
+		ProfileEvent* BeginScope(const char* name); // nullptr if the frame's full, any thread
+		void EndScope(ProfileEvent* event);
+
+		// frameSlot is the frame in flight, its queries get reset here so call it first thing in the command buffer, outside of rendering
+		void BeginGpuFrame(vk::CommandBuffer commandBuffer, uint32_t frameSlot);
+		uint32_t BeginGpuScope(vk::CommandBuffer commandBuffer, const char* name); // ~0u if there's no room, same command buffer as BeginGpuFrame
+		void EndGpuScope(vk::CommandBuffer commandBuffer, uint32_t scope);
+		void SubmitGpuFrame(); // Right after the submit, it's the closest cpu time the gpu events can be lined up with
+		// Once the frame slot's fence has been waited on, reads back whatever it wrote last time round
+		void CollectGpu(uint32_t frameSlot);
+
+		void DrawImGui(); // Its own window, frame time graphs, percentiles and the last frame's scopes
+		bool WriteChromeTrace(const std::filesystem::path& path) const; // Every frame in the ring, open it in chrome://tracing or Perfetto
+
+		uint64_t GetFrameNumber() const { return m_FrameNumber.load(std::memory_order_relaxed); } // The one being written
+		// nullptr once it's fallen out of the ring, or if it's still being written, gpu events only show up a few frames in flight later
+		const ProfileFrame* GetFrame(uint64_t number) const;
+
+	private:
+		struct GpuFrame
+		{
+			uint64_t FrameNumber = 0; // Which ProfileFrame these queries belong to, 0 if nothing is waiting on them
+			uint64_t SubmitTime = 0; // The first timestamp gets put here, there's no calibrated clock to do it properly
+			uint32_t Count = 0;
+			std::array<const char*, ProfileFrame::MaxGpuEvents> Names;
+		};
+
+		uint64_t Now() const;
+
+		std::chrono::steady_clock::time_point m_Epoch = std::chrono::steady_clock::now();
+		std::vector<ProfileFrame> m_Frames = std::vector<ProfileFrame>(FrameHistory);
+		std::atomic<uint64_t> m_FrameNumber{ 0 }; // The frame being written, numbers start at 1
+		uint32_t m_MainThread = 0; // Whichever thread calls BeginFrame
+
+		vk::Device m_Device;
+		vk::UniqueQueryPool m_QueryPool;
+		float m_TimestampPeriod = 1.0f; // Nanoseconds per tick
+		uint64_t m_TimestampMask = ~0ull;
+		std::vector<GpuFrame> m_GpuFrames;
+		uint32_t m_GpuSlot = 0; // Frame slot the current command buffer is writing
+		std::string m_TraceStatus; // Shown under the export button
+	};
+
+	class ProfileScope // Times whatever's left of the scope it's declared in
+	{
+	public:
+		explicit ProfileScope(const char* name) : m_Event(Profiler::profiler ? Profiler::profiler->BeginScope(name) : nullptr) {}
+		~ProfileScope() { if (m_Event) Profiler::profiler->EndScope(m_Event); }
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		ProfileEvent* m_Event; // Stays pointing at the frame it started in, even if it ends after the next one began
+	};
+}
+
+#define HYPER_PROFILE_CONCAT_INNER(a, b) a##b
+#define HYPER_PROFILE_CONCAT(a, b) HYPER_PROFILE_CONCAT_INNER(a, b)
+#define HYPER_PROFILE_SCOPE(name) hyper::ProfileScope HYPER_PROFILE_CONCAT(profileScope, __LINE__)(name)
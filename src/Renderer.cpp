@@ -1,5 +1,9 @@
 #include "Renderer.h"
 
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #define VMA_IMPLEMENTATION
@@ -10,7 +14,7 @@
 #include "imgui_impl_glfw.h"
 
 #include "Logger.h"
-#include "File.h"
+#include "Ktx.h"
 
 namespace hyper
 {
@@ -18,28 +22,47 @@ namespace hyper
 	{
 #pragma region StuffThatDoesntReallyNeedToBeTouchedOrSeenAfterBeingSetup
 		m_Spec = _spec;
+		m_Spec.FramesInFlight = std::max(m_Spec.FramesInFlight, 1u);
 		m_Window = _window;
 
 		vk::ApplicationInfo appInfo{ m_Spec.Title.c_str(), m_Spec.ApiVersion, "hyper", m_Spec.ApiVersion, m_Spec.ApiVersion };
 
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-		std::vector<const char*> glfwExtensionsVector(glfwExtensions, glfwExtensions + glfwExtensionCount), layers;
+		std::vector<const char*> instanceExtensions, layers;
+		if (!m_Spec.Headless) // Headless never touches glfw, there might not be a display to init it with
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			instanceExtensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
+
+		// Layers only get asked for if they're installed, ci boxes tend to just have the driver
+		std::vector<vk::LayerProperties> availableLayers = vk::enumerateInstanceLayerProperties();
+		auto addLayer = [&](const char* name)
+			{
+				for (const vk::LayerProperties& layer : availableLayers)
+					if (std::strcmp(layer.layerName.data(), name) == 0)
+					{
+						layers.push_back(name);
+						return;
+					}
+				Logger::logger->Log(std::string(name) + " isn't installed, going without it", Severity::Warning);
+			};
 
 		Logger::logger->Log("Debug Enabled");
 		if (m_Spec.Debug)
 		{
-			glfwExtensionsVector.push_back(vk::EXTDebugUtilsExtensionName);
-			layers.push_back("VK_LAYER_KHRONOS_validation");
+			instanceExtensions.push_back(vk::EXTDebugUtilsExtensionName);
+			if (m_Spec.Validation)
+				addLayer("VK_LAYER_KHRONOS_validation");
 		}
-		layers.push_back("VK_LAYER_KHRONOS_shader_object"); // shader object emulation fallback
+		addLayer("VK_LAYER_KHRONOS_shader_object"); // shader object emulation fallback
 
-		Logger::logger->Log("Extensions used: "); for (uint32_t i = 0; i < glfwExtensionCount; i++) Logger::logger->Log(" - " + std::string(glfwExtensions[i]));
+		Logger::logger->Log("Extensions used: "); for (auto& e : instanceExtensions) Logger::logger->Log(" - " + std::string(e));
 		Logger::logger->Log("Layers used: "); for (auto& l : layers) Logger::logger->Log(" - " + std::string(l));
 
 		// Instance
 		m_Instance = vk::createInstanceUnique(vk::InstanceCreateInfo{ vk::InstanceCreateFlags(), &appInfo, static_cast<uint32_t>(layers.size()), layers.data(),
-			static_cast<uint32_t>(glfwExtensionsVector.size()), glfwExtensionsVector.data() });
+			static_cast<uint32_t>(instanceExtensions.size()), instanceExtensions.data() });
 
 		// DLDI and debug messenger
 		m_DLDI = vk::detail::DispatchLoaderDynamic(*m_Instance, vkGetInstanceProcAddr);
@@ -47,9 +70,12 @@ namespace hyper
 			m_DebugMessenger = Logger::logger->MakeDebugMessenger(m_Instance, m_DLDI);
 
 		// Surface
-		VkSurfaceKHR surfaceTmp;
-		glfwCreateWindowSurface(*m_Instance, m_Window, nullptr, &surfaceTmp);
-		m_Surface = vk::UniqueSurfaceKHR(surfaceTmp, *m_Instance);
+		if (!m_Spec.Headless)
+		{
+			VkSurfaceKHR surfaceTmp;
+			glfwCreateWindowSurface(*m_Instance, m_Window, nullptr, &surfaceTmp);
+			m_Surface = vk::UniqueSurfaceKHR(surfaceTmp, *m_Instance);
+		}
 
 		// Physical device
 		std::vector<vk::PhysicalDevice> physicalDevices = m_Instance->enumeratePhysicalDevices();
@@ -60,22 +86,47 @@ namespace hyper
 		for (auto& d : physicalDevices)
 			if (d.getProperties().deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
 				m_PhysicalDevice = d;
+		if (!m_Spec.DeviceName.empty())
+		{
+			auto named = std::find_if(physicalDevices.begin(), physicalDevices.end(), [&](const vk::PhysicalDevice& d)
+				{ return std::string(d.getProperties().deviceName.data()).find(m_Spec.DeviceName) != std::string::npos; });
+			if (named != physicalDevices.end())
+				m_PhysicalDevice = *named;
+			else
+				Logger::logger->Log("No device has \"" + m_Spec.DeviceName + "\" in its name, using the default", Severity::Warning);
+		}
 		Logger::logger->Log("Chose device: " + std::string(m_PhysicalDevice.getProperties().deviceName.data()));
 
-		// Queue families
+		// Queue families, dedicated transfer and compute families get used when they exist so uploads and compute don't queue up behind graphics
 		std::vector<vk::QueueFamilyProperties> queueFamilyProperties = m_PhysicalDevice.getQueueFamilyProperties();
-		for (uint32_t i = 0; i < queueFamilyProperties.size(); i++)
-			if (queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eCompute)
+		auto findQueueFamily = [&](vk::QueueFlags required, vk::QueueFlags avoid)
 			{
-				m_GraphicsIndex = i;
-				break;
-			}
-		for (uint32_t i = 0; i < queueFamilyProperties.size(); i++)
-			if (m_PhysicalDevice.getSurfaceSupportKHR(i, m_Surface.get()))
-				m_PresentIndex = i;
+				for (uint32_t i = 0; i < queueFamilyProperties.size(); i++)
+					if ((queueFamilyProperties[i].queueFlags & required) == required && !(queueFamilyProperties[i].queueFlags & avoid))
+						return i;
+				return UINT32_MAX;
+			};
+		m_GraphicsIndex = findQueueFamily(vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute, {});
+		m_ComputeIndex = findQueueFamily(vk::QueueFlagBits::eCompute, vk::QueueFlagBits::eGraphics);
+		if (m_ComputeIndex == UINT32_MAX)
+			m_ComputeIndex = m_GraphicsIndex;
+		m_TransferIndex = findQueueFamily(vk::QueueFlagBits::eTransfer, vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute);
+		if (m_TransferIndex == UINT32_MAX) // Compute queues can always do transfers, even if they don't say so
+			m_TransferIndex = m_ComputeIndex;
+
+		if (m_Spec.Headless || m_PhysicalDevice.getSurfaceSupportKHR(m_GraphicsIndex, m_Surface.get())) // Presenting from the graphics family saves sharing the swapchain
+			m_PresentIndex = m_GraphicsIndex;
+		else
+			for (uint32_t i = 0; i < queueFamilyProperties.size(); i++)
+				if (m_PhysicalDevice.getSurfaceSupportKHR(i, m_Surface.get()))
+					m_PresentIndex = i;
+		Logger::logger->Log("Queue families: graphics " + std::to_string(m_GraphicsIndex) + ", present " + std::to_string(m_PresentIndex)
+			+ ", transfer " + std::to_string(m_TransferIndex) + ", compute " + std::to_string(m_ComputeIndex));
+
 		std::vector<uint32_t> familyIndices{ m_GraphicsIndex };
-		if (m_GraphicsIndex != m_PresentIndex)
-			familyIndices.push_back(m_PresentIndex);
+		for (uint32_t index : { m_PresentIndex, m_TransferIndex, m_ComputeIndex })
+			if (std::find(familyIndices.begin(), familyIndices.end(), index) == familyIndices.end())
+				familyIndices.push_back(index);
 
 		std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
 		float queuePriority = 0.0f;
@@ -83,14 +134,30 @@ namespace hyper
 			queueCreateInfos.push_back(vk::DeviceQueueCreateInfo{ vk::DeviceQueueCreateFlags(), static_cast<uint32_t>(queueFamilyIndex), 1, &queuePriority });
 
 		// Logical device
-		const std::vector<const char*> deviceExtensions = { vk::KHRSwapchainExtensionName, vk::KHRDynamicRenderingExtensionName,
-			vk::EXTShaderObjectExtensionName, vk::KHRBufferDeviceAddressExtensionName, vk::KHRSynchronization2ExtensionName };//, vk::EXTDescriptorIndexingExtensionName }; // For later
+		std::vector<const char*> deviceExtensions = { vk::KHRDynamicRenderingExtensionName, vk::EXTShaderObjectExtensionName,
+			vk::KHRBufferDeviceAddressExtensionName, vk::KHRSynchronization2ExtensionName, vk::EXTDescriptorIndexingExtensionName };
+		if (!m_Spec.Headless)
+			deviceExtensions.push_back(vk::KHRSwapchainExtensionName);
+		std::vector<vk::ExtensionProperties> availableExtensions = m_PhysicalDevice.enumerateDeviceExtensionProperties();
+		m_SupportsMemoryBudget = std::any_of(availableExtensions.begin(), availableExtensions.end(),
+			[](const vk::ExtensionProperties& extension) { return strcmp(extension.extensionName.data(), vk::EXTMemoryBudgetExtensionName) == 0; });
+		if (m_SupportsMemoryBudget) // Optional, VMA estimates usage and budgets itself without it
+			deviceExtensions.push_back(vk::EXTMemoryBudgetExtensionName);
 		Logger::logger->Log("Device extensions used: "); for (auto& e : deviceExtensions) Logger::logger->Log(" - " + std::string(e));
 		
 		vk::PhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
-		//vk::PhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = vk::PhysicalDeviceDescriptorIndexingFeatures(); // For later
-		vk::PhysicalDeviceSynchronization2Features synchronization2Features = vk::PhysicalDeviceSynchronization2Features(1); // , & descriptorIndexingFeatures);  // For later
+		m_SupportsBC = m_PhysicalDevice.getFeatures().textureCompressionBC; // Every desktop gpu, but cooked textures fall back to the source image without it
+		deviceFeatures.textureCompressionBC = m_SupportsBC;
+		vk::PhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{}; // Everything the bindless table needs
+		descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = vk::PhysicalDeviceTimelineSemaphoreFeatures(1, &descriptorIndexingFeatures);
+		vk::PhysicalDeviceSynchronization2Features synchronization2Features = vk::PhysicalDeviceSynchronization2Features(1, &timelineSemaphoreFeatures);
 		vk::PhysicalDeviceBufferDeviceAddressFeatures bufferAddressFeatures = vk::PhysicalDeviceBufferDeviceAddressFeatures(1, {}, {}, &synchronization2Features);
 		vk::PhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures = vk::PhysicalDeviceShaderObjectFeaturesEXT(1, &bufferAddressFeatures);
 		vk::PhysicalDeviceDynamicRenderingFeatures dynamicFeatures = vk::PhysicalDeviceDynamicRenderingFeatures(1, &shaderObjectFeatures);
@@ -100,49 +167,98 @@ namespace hyper
 		// Queues
 		m_DeviceQueue = m_Device->getQueue(m_GraphicsIndex, 0);
 		m_PresentQueue = m_Device->getQueue(m_PresentIndex, 0);
+		m_TransferQueue = m_Device->getQueue(m_TransferIndex, 0);
+		m_ComputeQueue = m_Device->getQueue(m_ComputeIndex, 0);
 
 		// VMA Allocator
-		VmaAllocatorCreateInfo allocatorInfo{ VmaAllocatorCreateFlags{} | VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
-			m_PhysicalDevice, m_Device.get(), {}, {}, {}, {}, {}, m_Instance.get(), m_Spec.ApiVersion };
+		VmaAllocatorCreateFlags allocatorFlags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+		if (m_SupportsMemoryBudget)
+			allocatorFlags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		VmaAllocatorCreateInfo allocatorInfo{ allocatorFlags, m_PhysicalDevice, m_Device.get(), {}, {}, {}, {}, {}, m_Instance.get(), m_Spec.ApiVersion };
 		vmaCreateAllocator(&allocatorInfo, &m_Allocator);
+		m_MemoryTracker.CreateMemoryTracker(m_Allocator, m_SupportsMemoryBudget, m_Spec.MemoryPressureThreshold);
+
+		// Upload context, every staged buffer and image during setup goes through here and gets submitted in one go
+		m_UploadContext.CreateUploadContext(m_Allocator, m_Device.get(), m_TransferQueue, m_TransferIndex, m_DeviceQueue, m_GraphicsIndex, m_QueueMutex,
+			m_Spec.StagingBufferSize);
+		m_GeometryPool.CreateGeometryPool(m_Allocator, m_Device.get(), { m_GraphicsIndex, m_TransferIndex }, m_Spec.GeometryBlockSize);
 				
-		// Swapchain
-		m_Swapchain.CreateSwapchain(2, vk::Format::eB8G8R8A8Unorm, { m_Spec.Width, m_Spec.Height }, m_Window, m_Device.get(),
-			m_GraphicsIndex, m_PresentIndex, m_Surface.get());
-		Logger::logger->Log("Swapchain created: Using " + std::to_string(m_Swapchain.ImageCount) + " frames in flight");
+		// Swapchain, or images standing in for one
+		if (m_Spec.Headless)
+			m_Swapchain.CreateOffscreen(m_Spec.FramesInFlight, vk::Format::eB8G8R8A8Unorm, { m_Spec.Width, m_Spec.Height }, m_Allocator, m_Device.get());
+		else
+			m_Swapchain.CreateSwapchain(2, vk::Format::eB8G8R8A8Unorm, { m_Spec.Width, m_Spec.Height }, m_Window, m_Device.get(),
+				m_GraphicsIndex, m_PresentIndex, m_Surface.get());
+		Logger::logger->Log(std::string(m_Spec.Headless ? "Offscreen targets" : "Swapchain") + " created: Using " + std::to_string(m_Swapchain.ImageCount)
+			+ " images and " + std::to_string(m_Spec.FramesInFlight) + " frames in flight");
 
 		m_DepthImage = CreateImage(m_Allocator, m_Device.get(), m_Swapchain.Extent, vk::Format::eD32Sfloat, vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eDepthStencilAttachment, VMA_MEMORY_USAGE_GPU_ONLY);
+			vk::ImageUsageFlagBits::eDepthStencilAttachment, VMA_MEMORY_USAGE_GPU_ONLY, { MemoryCategory::RenderTarget, "Depth" });
 
 		// Command pool
 		m_CommandPool = m_Device->createCommandPoolUnique({ { vk::CommandPoolCreateFlags() | vk::CommandPoolCreateFlagBits::eResetCommandBuffer },
 			static_cast<uint32_t>(m_GraphicsIndex) });
 
-		// Fence and semaphores
-		m_InFlightFence = m_Device->createFenceUnique({ vk::FenceCreateFlagBits::eSignaled });
-		m_ImageAvailableSemaphore = m_Device->createSemaphoreUnique({});
-		m_RenderFinishedSemaphore = m_Device->createSemaphoreUnique({});
+		// Fences and semaphores, fences start signaled so the first wait on each frame slot falls straight through
+		m_Frames = std::vector<FrameData>(m_Spec.FramesInFlight); // Not resize, the frame allocator can't be moved
+		for (FrameData& frame : m_Frames)
+		{
+			frame.InFlightFence = m_Device->createFenceUnique({ vk::FenceCreateFlagBits::eSignaled });
+			frame.ImageAvailableSemaphore = m_Device->createSemaphoreUnique({});
+		}
+		m_RenderFinishedSemaphores.resize(m_Swapchain.ImageCount);
+		for (vk::UniqueSemaphore& semaphore : m_RenderFinishedSemaphores)
+			semaphore = m_Device->createSemaphoreUnique({});
 #pragma endregion
 
-		// Descriptor set layout
-		vk::DescriptorSetLayoutBinding uboLayoutBinding{ 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex };
-		vk::DescriptorSetLayoutBinding samplerLayoutBinding{ 1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment };
-		std::array<vk::DescriptorSetLayoutBinding, 2> bindings{ uboLayoutBinding, samplerLayoutBinding };
-		m_DescriptorSetLayout = m_Device->createDescriptorSetLayoutUnique({ {}, static_cast<uint32_t>(bindings.size()), bindings.data() });
+		// Error checkerboard and samplers first, they're the bindless table's fallbacks
+		std::array<uint32_t, 16 * 16 > pixels = { 0 };
+		for (int x = 0; x < 16; x++) 
+			for (int y = 0; y < 16; y++) 
+				pixels[y * 16 + x] = ((x % 2) ^ (y % 2)) ? glm::packUnorm4x8(glm::vec4(1, 0, 1, 1)) : glm::packUnorm4x8(glm::vec4(0, 0, 0, 0));
+		m_ErrorCheckerboardImage = CreateImageStaged(m_Allocator, m_Device.get(), m_UploadContext, { 16, 16 }, pixels.data(),
+			vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled, { MemoryCategory::Texture, "Error checkerboard" });
+
+		// Texture samplers
+		// Trilinear between mips for both, nearest only changes the filtering inside a level, maxLod is unclamped so every level gets used
+		vk::SamplerCreateInfo samplerInfo{ {}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eLinear,
+			vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, 0.0f, VK_TRUE,
+			m_PhysicalDevice.getProperties().limits.maxSamplerAnisotropy, VK_FALSE, vk::CompareOp::eAlways, 0.0f, VK_LOD_CLAMP_NONE,
+			vk::BorderColor::eIntOpaqueBlack, VK_FALSE };
+		m_NearestSampler = m_Device->createSamplerUnique(samplerInfo);
+		samplerInfo.magFilter = vk::Filter::eLinear;
+		samplerInfo.minFilter = vk::Filter::eLinear;
+		m_LinearSampler = m_Device->createSamplerUnique(samplerInfo);
+
+		// Bindless descriptor table, the only descriptor set we have, slot 0 of each array is a fallback for when it runs out
+		m_BindlessFallbackBuffer = CreateBuffer(m_Allocator, 256, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU,
+			{ MemoryCategory::Other, "Bindless fallback" });
+		memset(m_BindlessFallbackBuffer.AllocationInfo.pMappedData, 0, 256); // Reads as zeroes rather than whatever was there
+		m_Bindless.CreateBindlessTable(m_Device.get(), m_BindlessFallbackBuffer.Buffer, m_ErrorCheckerboardImage.ImageView, m_NearestSampler.get());
+		vk::DescriptorSetLayout bindlessLayout = m_Bindless.GetLayout();
 
 		// Pipeline layout
-		vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstantData) };
-		m_PipelineLayout = m_Device->createPipelineLayoutUnique({ {}, 1, &m_DescriptorSetLayout.get(), 1, &pushConstantRange });
+		vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstantData) };
+		m_PipelineLayout = m_Device->createPipelineLayoutUnique({ {}, 1, &bindlessLayout, 1, &pushConstantRange });
+
+		// Thread pool first, cooking textures and compiling shaders use it too
+		m_ThreadPool = std::make_unique<ThreadPool>(m_Spec.RecordThreads);
+		Logger::logger->Log("Thread pool created: Using " + std::to_string(m_ThreadPool->GetThreadCount()) + " worker threads");
+
+		// Timestamps go around the passes on the graphics queue, one set of queries per frame in flight
+		m_Profiler.CreateProfiler(m_Device.get(), m_PhysicalDevice, m_GraphicsIndex, m_Spec.FramesInFlight);
 
 		// Shaders
-		std::vector<char> vertShaderCode = readFile("res/shader/shader.vert.spv");
-		std::vector<char> fragShaderCode = readFile("res/shader/shader.frag.spv");
-		std::vector<vk::ShaderCreateInfoEXT> shaderInfos{
-			{ {}, vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eFragment, vk::ShaderCodeTypeEXT::eSpirv,
-			vertShaderCode.size(), vertShaderCode.data(), "main", 1, &m_DescriptorSetLayout.get(), 1, &pushConstantRange },
-			{ {}, vk::ShaderStageFlagBits::eFragment, vk::ShaderStageFlagBits{0}, vk::ShaderCodeTypeEXT::eSpirv,
-			fragShaderCode.size(), fragShaderCode.data(), "main", 1,&m_DescriptorSetLayout.get(), 1, &pushConstantRange } };
-		m_Shaders = m_Device->createShadersEXTUnique(shaderInfos, nullptr, m_DLDI).value;
+		// Driver binaries are cached after the first run, so only a new driver or changed SPIR-V goes through the compiler
+		m_ShaderCache.CreateShaderCache(m_Device.get(), m_PhysicalDevice, m_DLDI, "shadercache");
+		m_ShaderCache.AddSetLayout(bindlessLayout, m_Bindless.GetLayoutInfo());
+		// The vertex shader comes in a variant per feature combination, all four are built in the background now so toggling one never hitches
+		m_VertexShaders.CreateShaderVariants(m_ShaderCache, *m_ThreadPool, { "res/shader/shader.vert.spv", vk::ShaderStageFlagBits::eVertex,
+			vk::ShaderStageFlagBits::eFragment }, { bindlessLayout }, { pushConstantRange }, SnapVertices | PackedVertices);
+		for (uint32_t features = 0; features < (1u << ShaderFeatureBits); features++)
+			m_VertexShaders.Request(features);
+		m_FragmentShader = m_ShaderCache.CreateShader({ "res/shader/shader.frag.spv", vk::ShaderStageFlagBits::eFragment, {} }, { bindlessLayout },
+			{ pushConstantRange });
 
 		vk::AttachmentDescription colorAttachment{ {}, m_Swapchain.ImageFormat, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear,
 			vk::AttachmentStoreOp::eStore, {}, {}, {}, vk::ImageLayout::ePresentSrcKHR };
@@ -150,88 +266,122 @@ namespace hyper
 		vk::SubpassDescription subpass{ {}, vk::PipelineBindPoint::eGraphics, /*inAttachmentCount*/ 0, nullptr, 1, &colourAttachmentRef };
 
 		// Images
-		m_TextureImage = CreateImageTexture(m_Allocator, m_CommandPool.get(), m_Device.get(), m_DeviceQueue, "res/texture/texture.jpg",
-			vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled);
-		std::array<uint32_t, 16 * 16 > pixels = { 0 };
-		for (int x = 0; x < 16; x++) 
-			for (int y = 0; y < 16; y++) 
-				pixels[y * 16 + x] = ((x % 2) ^ (y % 2)) ? glm::packUnorm4x8(glm::vec4(1, 0, 1, 1)) : glm::packUnorm4x8(glm::vec4(0, 0, 0, 0));
-		m_ErrorCheckerboardImage = CreateImageStaged(m_Allocator, m_CommandPool.get(), m_Device.get(), m_DeviceQueue, { 16, 16 }, pixels.data(),
-			vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled);
-
-		// Texture samplers
-		vk::SamplerCreateInfo samplerInfo{ {}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest,
-			vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, {}, VK_TRUE,
-			m_PhysicalDevice.getProperties().limits.maxSamplerAnisotropy, VK_FALSE, vk::CompareOp::eAlways, {}, {}, vk::BorderColor::eIntOpaqueBlack, VK_FALSE };
-		m_NearestSampler = m_Device->createSamplerUnique(samplerInfo);
-		samplerInfo.magFilter = vk::Filter::eLinear;
-		samplerInfo.minFilter = vk::Filter::eLinear;
-		m_LinearSampler = m_Device->createSamplerUnique(samplerInfo);
+		// The texture gets cooked to BC7 the first time (or whenever the source changes), every run after that skips the jpeg decode
+		std::filesystem::path texturePath = "res/texture/texture.jpg", cookedTexturePath = "res/texture/texture.ktx2";
+		if (m_SupportsBC && (!std::filesystem::exists(cookedTexturePath)
+			|| std::filesystem::last_write_time(cookedTexturePath) < std::filesystem::last_write_time(texturePath)))
+			CookTexture(texturePath, cookedTexturePath, BcFormat::BC7, false, m_ThreadPool.get());
+		if (m_SupportsBC)
+			m_TextureImage = CreateImageKtx(m_Allocator, m_Device.get(), m_UploadContext, cookedTexturePath.string(), vk::ImageUsageFlagBits::eSampled);
+		if (!m_TextureImage.Image)
+			m_TextureImage = CreateImageTexture(m_Allocator, m_Device.get(), m_UploadContext, texturePath.string(),
+				vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled);
+		// Written into the bindless table once, from here on they're just indices
+		m_TextureIndex = m_Bindless.AddTexture(m_TextureImage.ImageView);
+		m_LinearSamplerIndex = m_Bindless.AddSampler(m_LinearSampler.get());
 
 		// Meshes
-		testMeshes = LoadModel(m_CommandPool.get(), m_Device.get(), m_DeviceQueue, m_Allocator, "res/model/basicmesh.glb");
-
-		// Uniform Buffer
-		m_UniformBuffers.resize(m_Swapchain.ImageCount);
-		for (auto& ub : m_UniformBuffers)
-			ub = CreateBuffer(m_Allocator, sizeof(UniformBufferObject), vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		
-		// Descriptor pool
-		std::vector<vk::DescriptorPoolSize> poolSizes = { { vk::DescriptorType::eUniformBuffer, m_Swapchain.ImageCount },
-			{ vk::DescriptorType::eCombinedImageSampler, m_Swapchain.ImageCount } };
-		m_DescriptorPool = m_Device->createDescriptorPoolUnique({ { vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet }, m_Swapchain.ImageCount,
-			2, poolSizes.data() });
-
-		// Descriptor sets
-		std::vector<vk::DescriptorSetLayout> layouts(m_Swapchain.ImageCount, m_DescriptorSetLayout.get());
-		vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{ m_DescriptorPool.get(), static_cast<uint32_t>(m_Swapchain.ImageCount), layouts.data() };
-		m_DescriptorSets.resize(m_Swapchain.ImageCount);
-		m_DescriptorSets = m_Device->allocateDescriptorSetsUnique(descriptorSetAllocateInfo);
-
-		// ImGui
-		ImGui::CreateContext();
-		ImGui_ImplGlfw_InitForVulkan(m_Window, true);
-		ImGui_ImplVulkan_InitInfo imGuiInfo{ m_Instance.get(), m_PhysicalDevice, m_Device.get(), static_cast<uint32_t>(m_GraphicsIndex), m_DeviceQueue,
-			nullptr, nullptr, m_Swapchain.ImageCount, m_Swapchain.ImageCount, VK_SAMPLE_COUNT_1_BIT, nullptr, 0, 2, true,
-			vk::PipelineRenderingCreateInfoKHR{ 0, 1, &m_Swapchain.ImageFormat, vk::Format::eD32Sfloat } };
-		ImGui_ImplVulkan_Init(&imGuiInfo);
+		// Placeholder is tiny and needed for the first frame, the actual model loads in the background and shows up when it's ready
+		m_PlaceholderMesh = UploadMesh(m_GeometryPool, m_UploadContext, MakePlaceholderMesh());
+		m_AssetLoader.CreateAssetLoader(m_Allocator, m_Device.get(), m_GeometryPool, m_UploadContext, m_Bindless, m_Spec.LoaderThreads);
+		m_TestModel = m_AssetLoader.LoadModelAsync(m_Spec.ModelPath);
+
+		// One submit and one wait for every texture and mesh above
+		m_UploadContext.Wait(m_UploadContext.Flush());
+
+		// Frame allocators, uniforms and transforms get bump allocated every frame and handed to shaders by address
+		vk::PhysicalDeviceLimits limits = m_PhysicalDevice.getProperties().limits;
+		vk::DeviceSize transientAlignment = std::max<vk::DeviceSize>({ 16, limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment });
+		for (FrameData& frame : m_Frames)
+			frame.Transient.CreateFrameAllocator(m_Allocator, m_Device.get(), m_Spec.FrameAllocatorSize, transientAlignment);
+
+		// ImGui, headless has nobody to look at it
+		if (!m_Spec.Headless)
+		{
+			ImGui::CreateContext();
+			ImGui_ImplGlfw_InitForVulkan(m_Window, true);
+			ImGui_ImplVulkan_InitInfo imGuiInfo{ m_Instance.get(), m_PhysicalDevice, m_Device.get(), static_cast<uint32_t>(m_GraphicsIndex), m_DeviceQueue,
+				nullptr, nullptr, m_Swapchain.ImageCount, m_Swapchain.ImageCount, VK_SAMPLE_COUNT_1_BIT, nullptr, 0, 2, true,
+				vk::PipelineRenderingCreateInfoKHR{ 0, 1, &m_Swapchain.ImageFormat, vk::Format::eD32Sfloat } };
+			ImGui_ImplVulkan_Init(&imGuiInfo);
+		}
 
 		// Command buffers
-		m_CommandBuffers = m_Device->allocateCommandBuffersUnique({ m_CommandPool.get(), vk::CommandBufferLevel::ePrimary, m_Swapchain.ImageCount });
+		std::vector<vk::UniqueCommandBuffer> commandBuffers = m_Device->allocateCommandBuffersUnique({ m_CommandPool.get(),
+			vk::CommandBufferLevel::ePrimary, m_Spec.FramesInFlight });
+		for (uint32_t i = 0; i < m_Spec.FramesInFlight; i++)
+			m_Frames[i].CommandBuffer = std::move(commandBuffers[i]);
+
+		// A command pool + secondary per recording chunk, which only get used once the draw list is big enough
+		uint32_t recordChunks = m_ThreadPool->GetThreadCount() + 1; // Workers plus the main thread
+		for (FrameData& frame : m_Frames)
+			for (uint32_t i = 0; i < recordChunks; i++)
+			{
+				frame.WorkerCommandPools.push_back(m_Device->createCommandPoolUnique({ vk::CommandPoolCreateFlagBits::eTransient, m_GraphicsIndex }));
+				frame.WorkerCommandBuffers.push_back(std::move(m_Device->allocateCommandBuffersUnique({ frame.WorkerCommandPools.back().get(),
+					vk::CommandBufferLevel::eSecondary, 1 })[0]));
+			}
 	}
 
 	void Renderer::DrawFrame()
 	{
 		static float oldTimeStart = 0;
-		float timeSinceStart = static_cast<float>(glfwGetTime());
+		float timeSinceStart = static_cast<float>(GetTime());
 		float deltaTime = timeSinceStart - oldTimeStart;
 		oldTimeStart = timeSinceStart;
 
 		static float cameraSpeed = 5.0f;
 		static float cameraSensitivity = 1 / 500.0f;
-		m_Camera.Update(deltaTime);
-		m_Camera.ProcessInput(m_Window, cameraSpeed, cameraSensitivity);
+		{
+			HYPER_PROFILE_SCOPE("Camera::Update");
+			m_Camera.Update(deltaTime);
+		}
+		if (!m_Spec.Headless)
+		{
+			HYPER_PROFILE_SCOPE("Input");
+			m_Camera.ProcessInput(m_Window, cameraSpeed, cameraSensitivity);
+		}
+
+		// Only wait on the slot we're about to reuse, the other frames in flight can keep going on the gpu
+		FrameData& frame = m_Frames[m_CurrentFrame];
+		{
+			HYPER_PROFILE_SCOPE("Wait for frame");
+			static_cast<void>(m_Device->waitForFences(1, &frame.InFlightFence.get(), VK_TRUE, UINT64_MAX));
+		}
+		m_Profiler.CollectGpu(m_CurrentFrame); // Its timestamps from last time round are done now
+		frame.Transient.Reset(); // Same for everything it handed out
+
+		m_AssetLoader.Update();
+		m_MemoryTracker.Update(); // Pressure callbacks run here, before anything this frame allocates
 
 		if (m_Swapchain.Resized)
 		{
+			m_Device->waitIdle(); // Other slots might still be drawing into the old images
 			m_Swapchain.CreateSwapchain(2, vk::Format::eB8G8R8A8Unorm, { m_Spec.Width, m_Spec.Height }, m_Window, m_Device.get(),
 				m_GraphicsIndex, m_PresentIndex, m_Surface.get());
 			DestroyImage(m_Allocator, m_Device.get(), m_DepthImage);
 			m_DepthImage = CreateImage(m_Allocator, m_Device.get(), m_Swapchain.Extent, vk::Format::eD32Sfloat, vk::ImageTiling::eOptimal,
-				vk::ImageUsageFlagBits::eDepthStencilAttachment, VMA_MEMORY_USAGE_GPU_ONLY);
+				vk::ImageUsageFlagBits::eDepthStencilAttachment, VMA_MEMORY_USAGE_GPU_ONLY, { MemoryCategory::RenderTarget, "Depth" });
+			m_RenderFinishedSemaphores.resize(m_Swapchain.ImageCount);
+			for (vk::UniqueSemaphore& semaphore : m_RenderFinishedSemaphores)
+				semaphore = m_Device->createSemaphoreUnique({});
 			Logger::logger->Log("Swapchain rereated");
 		}
 
-		ImGui_ImplVulkan_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
-
 		static std::vector<vk::ClearValue> clearValues{ vk::ClearColorValue{ 1.0f, 0.5f, 0.3f, 1.0f }, vk::ClearColorValue{ 1.0f, 0.0f, 0.0f, 0.0f } };
 		static bool nearestSampler = true;
 		static bool shouldSnap = false;
 		static float snapFactor = 100.0f;
 		static float spinSpeed = 1.f;
+		static int instanceGrid = 1;
+		static bool frustumCulling = true;
+		if (!m_Spec.Headless)
 		{ // Custom window
+			HYPER_PROFILE_SCOPE("ImGui");
+			ImGui_ImplVulkan_NewFrame();
+			ImGui_ImplGlfw_NewFrame();
+			ImGui::NewFrame();
+
 			ImGui::Begin("Stuff to mess with!");
 			ImGui::ColorEdit4("Clear Colour", clearValues[0].color.float32.data()); // wtf is this??? vulkan explain????
 			ImGui::SliderFloat3("Camera Position", (float*)&m_Camera.position, -10.0f, 10.0f);
@@ -243,147 +393,486 @@ namespace hyper
 			ImGui::Checkbox("Snap Vertices", &shouldSnap);
 			ImGui::SliderFloat("Snap Factor", &snapFactor, 100.0f, 1.0f);
 			ImGui::SliderFloat("Spin Speed", &spinSpeed, 0.01f, 2.0f);
+			ImGui::SliderInt("Instance Grid", &instanceGrid, 1, 100);
+			ImGui::Checkbox("Frustum Culling", &frustumCulling);
+			ImGui::Text("Visible: %u, Culled: %u (%.3fms)", m_VisibleCount, m_CulledCount, m_CullTime);
+			ImGui::Text("Draws: %u, Shader binds: %u (%u saved)", m_DrawStats.Draws, m_DrawStats.ShaderBinds, m_DrawStats.ShaderBindsSaved);
+			ImGui::Text("Index binds: %u (%u saved), Push constants: %u (%u saved)", m_DrawStats.IndexBufferBinds, m_DrawStats.IndexBufferBindsSaved,
+				m_DrawStats.PushConstants, m_DrawStats.PushConstantsSaved);
+			const FrameAllocator& lastTransient = m_Frames[(m_CurrentFrame + m_Frames.size() - 1) % m_Frames.size()].Transient; // This frame's was just reset
+			ImGui::Text("Frame allocator: %.1f / %.1f KB", lastTransient.GetUsed() / 1024.0f, lastTransient.GetCapacity() / 1024.0f);
 			ImGui::End();
-		}
-		ImGui::Render();
 
-		for (uint32_t i = 0; i < m_Swapchain.ImageCount; i++)
-		{
-			vk::DescriptorBufferInfo bufferInfo{ m_UniformBuffers[i].Buffer, 0, sizeof(UniformBufferObject) };
-			vk::DescriptorImageInfo imageInfo{ nearestSampler ? m_NearestSampler.get() : m_LinearSampler.get(),
-				m_ErrorCheckerboardImage.ImageView, vk::ImageLayout::eReadOnlyOptimal };
-			std::vector<vk::WriteDescriptorSet> descriptorWrites{
-				vk::WriteDescriptorSet{ m_DescriptorSets[i].get(), 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo },
-				vk::WriteDescriptorSet{ m_DescriptorSets[i].get(), 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo } };
-			m_Device->updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+			m_Profiler.DrawImGui();
+			m_MemoryTracker.DrawImGui();
+			ImGui::Render();
 		}
 
+		// Get next image, headless gives every frame slot its own so the fence wait above already covers it
+		vk::ResultValue<uint32_t> imageIndex = [&]()
+			{
+				HYPER_PROFILE_SCOPE("Acquire");
+				if (m_Spec.Headless)
+					return vk::ResultValue<uint32_t>(vk::Result::eSuccess, m_CurrentFrame);
+				return m_Device->acquireNextImageKHR(m_Swapchain.ActualSwapchain.get(), std::numeric_limits<uint64_t>::max(),
+					frame.ImageAvailableSemaphore.get(), {});
+			}();
+		if (imageIndex.result == vk::Result::eErrorOutOfDateKHR || imageIndex.result == vk::Result::eSuboptimalKHR)
+			m_Swapchain.Resized = true;
+
+		// Only reset once we know we're submitting, otherwise the next wait on this slot never returns
+		static_cast<void>(m_Device->resetFences(1, &frame.InFlightFence.get()));
+
 		// Update UBO
-		static uint32_t currentFrame = 0;
 		UniformBufferObject ubo{};
-		ubo.model = glm::rotate(glm::mat4(1.0f), static_cast<float>(glfwGetTime()) * glm::radians(90.0f) * spinSpeed, glm::vec3(1.0f, 1.0f, 1.0f));
 		ubo.view = m_Camera.GetViewMatrix();
-		ubo.proj = glm::perspective(glm::radians(70.0f), m_Swapchain.Extent.width / (float)m_Swapchain.Extent.height, 0.1f, 1000.0f);
+		float farPlane = 1000.0f;
+		ubo.proj = glm::perspective(glm::radians(70.0f), m_Swapchain.Extent.width / (float)m_Swapchain.Extent.height, 0.1f, farPlane);
 		ubo.proj[1][1] *= -1;
-		memcpy(m_UniformBuffers[currentFrame].AllocationInfo.pMappedData, &ubo, sizeof(ubo));
-		currentFrame = (currentFrame + 1) % m_Swapchain.ImageCount;
 		
 		//vk::Buffer vertexBuffers[] = { m_VertexBuffer.Buffer };
 		//vk::DeviceSize offsets[] = { 0 };
 		PushConstantData pushConstants{};
-		pushConstants.vertexBuffer = m_Device->getBufferAddress({ testMeshes[2]->vertexBuffer.Buffer });
-		pushConstants.shouldSnap = shouldSnap;
 		pushConstants.snapFactor = snapFactor;
-		for (size_t i = 0; i < m_CommandBuffers.size(); i++)
+		m_FrameFeatures = shouldSnap ? SnapVertices : 0; // A different vertex shader variant, nothing gets pushed for it
+		pushConstants.uniforms = frame.Transient.Push(ubo).Address; // A fresh copy every frame, no descriptor writes and nothing to wait on
+		pushConstants.textureIndex = m_ErrorCheckerboardIndex;
+		pushConstants.samplerIndex = nearestSampler ? m_NearestSamplerIndex : m_LinearSamplerIndex;
+
+		// Draw list, a grid of copies of the test model's scene, the placeholder cube until it's resident
+		// Copies of the same surface all end up in one instanced draw
+		m_DrawList.clear();
+		auto addMesh = [&](const MeshAsset& mesh, const glm::mat4& transform)
+			{
+				for (uint32_t i = 0; i < mesh.surfaces.size(); i++)
+				{
+					const GeoSurface& surface = mesh.surfaces[i];
+					MaterialInstance* material = surface.image < m_TestModelMaterials.size() ? &m_TestModelMaterials[surface.image] : nullptr; // No image draws the checkerboard
+					m_DrawList.push_back(RenderObject{ surface.count, mesh.firstIndex + surface.startIndex, mesh.vertexOffset, mesh.indexBuffer, mesh.indexType,
+						mesh.vertexBufferAddress, mesh.vertexFormat, mesh.positionOffset, mesh.positionScale, surface.boundingSphere, mesh.firstSurfaceId + i,
+						material, transform });
+				}
+			};
+		bool modelResident = m_TestModel->State == AssetState::Resident;
+		if (modelResident)
+		{
+			m_TestModel->SceneGraph.UpdateWorldMatrices(m_ThreadPool.get()); // Only does anything for nodes that changed
+			if (m_TestModelMaterials.size() != m_TestModel->TextureIndices.size())
+				for (uint32_t i = 0; i < m_TestModel->TextureIndices.size(); i++) // Same fragment shader as everything else, ids start at 1 since 0 is no material
+					m_TestModelMaterials.push_back(MaterialInstance{ {}, *m_PipelineLayout, m_TestModel->TextureIndices[i], 0, 0, i + 1 });
+			for (MaterialInstance& material : m_TestModelMaterials)
+				material.samplerIndex = pushConstants.samplerIndex; // Still follows the sampler toggle
+		}
+		glm::mat4 spin = glm::rotate(glm::mat4(1.0f), static_cast<float>(GetTime()) * glm::radians(90.0f) * spinSpeed, glm::vec3(1.0f, 1.0f, 1.0f));
+		for (int x = 0; x < instanceGrid; x++)
+			for (int z = 0; z < instanceGrid; z++)
+			{
+				glm::mat4 cell = glm::translate(glm::mat4(1.0f), glm::vec3{ x - (instanceGrid - 1) * 0.5f, 0.0f, -z } * 3.0f) * spin;
+				if (!modelResident)
+				{
+					addMesh(*m_PlaceholderMesh, cell);
+					continue;
+				}
+				const Scene& scene = m_TestModel->SceneGraph;
+				for (uint32_t node = 0; node < scene.GetNodeCount(); node++)
+					if (scene.GetMesh(node) >= 0 && scene.GetMesh(node) < static_cast<int32_t>(m_TestModel->Meshes.size()))
+						addMesh(*m_TestModel->Meshes[scene.GetMesh(node)], cell * scene.GetWorldMatrix(node));
+			}
+		if (frustumCulling)
+		{
+			HYPER_PROFILE_SCOPE("Cull");
+			CullDrawList(ubo.proj * ubo.view);
+		}
+		else
+		{
+			m_VisibleCount = static_cast<uint32_t>(m_DrawList.size());
+			m_CulledCount = 0;
+		}
 		{
-			// Synchronisation2 barriers
-			vk::ImageMemoryBarrier2 topImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
-				vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
-				vk::ImageLayout::eUndefined, vk::ImageLayout::eAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Swapchain.Images[i],
-				vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } };
-			vk::ImageMemoryBarrier2 bottomImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
-				vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
-				vk::ImageLayout::eAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Swapchain.Images[i],
-				vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } };
-
-			std::vector<vk::RenderingAttachmentInfo> attachments{ { m_Swapchain.ImageViews[i].get(), vk::ImageLayout::eAttachmentOptimal, {},{},{}, // Colour
-				vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, clearValues[0] } };
-			vk::RenderingAttachmentInfo depthAttachment{ m_DepthImage.ImageView, vk::ImageLayout::eAttachmentOptimal, {}, {}, {}, // Depth
-					vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare, clearValues[1] };
-
-			vk::RenderingInfo renderingInfo{ {}, vk::Rect2D{ { 0, 0 }, m_Swapchain.Extent }, 1, {}, attachments, &depthAttachment };
-
-			// Actual command buffers
-			m_CommandBuffers[i]->begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-			m_CommandBuffers[i]->pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &topImageMemoryBarrier2 });
-			// Get ready for the motherload of boilerplate from using ShaderEXT's
-			std::vector<vk::VertexInputBindingDescription2EXT> bindings{ Vertex::getBindingDescription() };
-			m_CommandBuffers[i]->setVertexInputEXT(static_cast<uint32_t>(bindings.size()), bindings.data(),
-				static_cast<uint32_t>(Vertex::getAttributeDescriptions().size()), Vertex::getAttributeDescriptions().data(), m_DLDI);
-			m_CommandBuffers[i]->setViewportWithCount(vk::Viewport{ 0.0f, 0.0f, static_cast<float>(m_Swapchain.Extent.width), static_cast<float>(m_Swapchain.Extent.height), 0.0f, 1.0f });
-			m_CommandBuffers[i]->setScissorWithCount(vk::Rect2D{ { 0, 0 }, { m_Swapchain.Extent.width, m_Swapchain.Extent.height } });
-			m_CommandBuffers[i]->setRasterizerDiscardEnable(0);
-			m_CommandBuffers[i]->setPolygonModeEXT(vk::PolygonMode::eFill, m_DLDI);
-			m_CommandBuffers[i]->setRasterizationSamplesEXT(vk::SampleCountFlagBits::e1, m_DLDI);
-			m_CommandBuffers[i]->setCullMode(vk::CullModeFlagBits::eBack);
-			m_CommandBuffers[i]->setFrontFace(vk::FrontFace::eCounterClockwise);
-
-			m_CommandBuffers[i]->setDepthTestEnable(1);
-			m_CommandBuffers[i]->setDepthWriteEnable(1);
-			m_CommandBuffers[i]->setDepthCompareOp(vk::CompareOp::eLess);
-			m_CommandBuffers[i]->setDepthBiasEnable(0);
-
-			m_CommandBuffers[i]->setColorBlendEnableEXT(0, { 1/*vk::BlendFactor::eOne*/, 0/*vk::BlendFactor::eZero*/, 1/*vk::BlendOp::eAdd*/ }, m_DLDI);
-			m_CommandBuffers[i]->setColorBlendEquationEXT(0, vk::ColorBlendEquationEXT{ vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd }, m_DLDI);
-			m_CommandBuffers[i]->setColorWriteMaskEXT(0, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB
-				| vk::ColorComponentFlagBits::eA, m_DLDI);
-
-			m_CommandBuffers[i]->setSampleMaskEXT(vk::SampleCountFlagBits::e1, 1, m_DLDI);
-			m_CommandBuffers[i]->setAlphaToCoverageEnableEXT(0, m_DLDI);
-			m_CommandBuffers[i]->setStencilTestEnable(0);
-			m_CommandBuffers[i]->setPrimitiveTopology(vk::PrimitiveTopology::eTriangleList);
-			m_CommandBuffers[i]->setPrimitiveRestartEnable(0);
-
-			m_CommandBuffers[i]->beginRendering(&renderingInfo);
-			m_CommandBuffers[i]->bindShadersEXT({ vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eFragment }, { m_Shaders[0].get(), m_Shaders[1].get() }, m_DLDI);
-
-			//m_CommandBuffers[i]->bindVertexBuffers(0, 1, vertexBuffers, offsets); // Using push constants atm, probably not for long
-			m_CommandBuffers[i]->bindIndexBuffer(testMeshes[2]->indexBuffer.Buffer, 0, vk::IndexType::eUint32);
-
-			m_CommandBuffers[i]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *m_PipelineLayout, 0, 1, &m_DescriptorSets[i].get(), 0, nullptr);
-			m_CommandBuffers[i]->pushConstants(*m_PipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstantData), &pushConstants);
-
-			m_CommandBuffers[i]->drawIndexed(testMeshes[2]->surfaces[0].count, 1, testMeshes[2]->surfaces[0].startIndex, 0, 0);
-
-			ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), m_CommandBuffers[i].get());
-
-			m_CommandBuffers[i]->endRendering();
-
-			m_CommandBuffers[i]->pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &bottomImageMemoryBarrier2 });
-
-			m_CommandBuffers[i]->end();
+			HYPER_PROFILE_SCOPE("Build batches");
+			pushConstants.instances = BuildDrawBatches(frame, ubo.view, farPlane);
 		}
 
-		static_cast<void>(m_Device->resetFences(1, &m_InFlightFence.get()));
-	
-		// Get next image
-		vk::ResultValue<uint32_t> imageIndex = m_Device->acquireNextImageKHR(m_Swapchain.ActualSwapchain.get(), std::numeric_limits<uint64_t>::max(),
-			m_ImageAvailableSemaphore.get(), {});
-		if (imageIndex.result == vk::Result::eErrorOutOfDateKHR || imageIndex.result == vk::Result::eSuboptimalKHR)
-			m_Swapchain.Resized = true;
+		// Recording happens after acquire so only the buffer that actually gets submitted is recorded
+		{
+			HYPER_PROFILE_SCOPE("Record");
+			RecordCommandBuffer(frame, imageIndex.value, clearValues, pushConstants);
+		}
+
+		// Submit command buffer, no more waiting on the fence here, the next use of this slot does that
+		vk::SemaphoreSubmitInfo waitSemaphoreInfo{ frame.ImageAvailableSemaphore.get(), {}, vk::PipelineStageFlagBits2::eColorAttachmentOutput };
+		vk::CommandBufferSubmitInfo commandBufferInfo{ frame.CommandBuffer.get() };
+		vk::SemaphoreSubmitInfo signalSemaphoreInfo{ m_RenderFinishedSemaphores[imageIndex.value].get(), {}, vk::PipelineStageFlagBits2::eAllCommands };
+		uint32_t semaphoreCount = m_Spec.Headless ? 0 : 1; // Nothing to acquire or present, the fence is all there is
+		std::lock_guard<std::mutex> queueLock(m_QueueMutex); // Upload context submits to the graphics queue too
+		{
+			HYPER_PROFILE_SCOPE("Submit");
+			m_DeviceQueue.submit2({ vk::SubmitInfo2{ {}, semaphoreCount, &waitSemaphoreInfo, 1, &commandBufferInfo, semaphoreCount, &signalSemaphoreInfo } },
+				frame.InFlightFence.get());
+			m_Profiler.SubmitGpuFrame();
+		}
+
+		if (!m_Spec.Headless)
+		{
+			HYPER_PROFILE_SCOPE("Present");
+			static_cast<void>(m_PresentQueue.presentKHR({ 1, &m_RenderFinishedSemaphores[imageIndex.value].get(), 1, &m_Swapchain.ActualSwapchain.get(),
+				&imageIndex.value }));
+		}
+
+		m_CurrentFrame = (m_CurrentFrame + 1) % m_Spec.FramesInFlight;
+	}
+
+	void Renderer::SetDrawState(vk::CommandBuffer commandBuffer)
+	{ // Secondaries don't inherit any of this from the primary, so every command buffer that draws has to call it
+		// Get ready for the motherload of boilerplate from using ShaderEXT's
+		std::vector<vk::VertexInputBindingDescription2EXT> bindings{ Vertex::getBindingDescription() };
+		commandBuffer.setVertexInputEXT(static_cast<uint32_t>(bindings.size()), bindings.data(),
+			static_cast<uint32_t>(Vertex::getAttributeDescriptions().size()), Vertex::getAttributeDescriptions().data(), m_DLDI);
+		commandBuffer.setViewportWithCount(vk::Viewport{ 0.0f, 0.0f, static_cast<float>(m_Swapchain.Extent.width), static_cast<float>(m_Swapchain.Extent.height), 0.0f, 1.0f });
+		commandBuffer.setScissorWithCount(vk::Rect2D{ { 0, 0 }, { m_Swapchain.Extent.width, m_Swapchain.Extent.height } });
+		commandBuffer.setRasterizerDiscardEnable(0);
+		commandBuffer.setPolygonModeEXT(vk::PolygonMode::eFill, m_DLDI);
+		commandBuffer.setRasterizationSamplesEXT(vk::SampleCountFlagBits::e1, m_DLDI);
+		commandBuffer.setCullMode(vk::CullModeFlagBits::eBack);
+		commandBuffer.setFrontFace(vk::FrontFace::eCounterClockwise);
+
+		commandBuffer.setDepthTestEnable(1);
+		commandBuffer.setDepthWriteEnable(1);
+		commandBuffer.setDepthCompareOp(vk::CompareOp::eLess);
+		commandBuffer.setDepthBiasEnable(0);
+
+		commandBuffer.setColorBlendEnableEXT(0, { 1/*vk::BlendFactor::eOne*/, 0/*vk::BlendFactor::eZero*/, 1/*vk::BlendOp::eAdd*/ }, m_DLDI);
+		commandBuffer.setColorBlendEquationEXT(0, vk::ColorBlendEquationEXT{ vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd }, m_DLDI);
+		commandBuffer.setColorWriteMaskEXT(0, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB
+			| vk::ColorComponentFlagBits::eA, m_DLDI);
+
+		commandBuffer.setSampleMaskEXT(vk::SampleCountFlagBits::e1, 1, m_DLDI);
+		commandBuffer.setAlphaToCoverageEnableEXT(0, m_DLDI);
+		commandBuffer.setStencilTestEnable(0);
+		commandBuffer.setPrimitiveTopology(vk::PrimitiveTopology::eTriangleList);
+		commandBuffer.setPrimitiveRestartEnable(0);
+
+		commandBuffer.bindShadersEXT({ vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eFragment },
+			{ m_FrameVertexShaders[m_FrameFeatures], m_FragmentShader.get() }, m_DLDI);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *m_PipelineLayout, 0, 1, &m_Bindless.GetSet(), 0, nullptr);
+	}
+
+	void Renderer::CullDrawList(const glm::mat4& viewProjection)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		Frustum frustum = ExtractFrustum(viewProjection);
+		uint32_t count = static_cast<uint32_t>(m_DrawList.size());
+		m_CullBounds.Resize(count);
+		m_Visibility.resize(count);
+
+		// Spheres go to world space and get tested in the same pass, so each chunk's bounds are still in cache for the kernel
+		auto cullRange = [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					const RenderObject& object = m_DrawList[i];
+					const glm::mat4& m = object.transform;
+					float scale = std::sqrt(std::max({ glm::dot(glm::vec3(m[0]), glm::vec3(m[0])), glm::dot(glm::vec3(m[1]), glm::vec3(m[1])),
+						glm::dot(glm::vec3(m[2]), glm::vec3(m[2])) })); // Biggest axis scale, so non-uniform scaling stays conservative
+					m_CullBounds.Set(i, glm::vec3(m * glm::vec4(glm::vec3(object.boundingSphere), 1.0f)), object.boundingSphere.w * scale);
+				}
+				return CullSpheres(frustum, m_CullBounds, begin, end, m_Visibility.data());
+			};
+		if (count >= m_Spec.ParallelCullThreshold)
+		{
+			uint32_t chunkCount = m_ThreadPool->GetThreadCount() + 1;
+			std::vector<uint32_t> chunkVisible(chunkCount, 0);
+			m_ThreadPool->ParallelFor(count, chunkCount, [&](uint32_t chunk, uint32_t begin, uint32_t end) { chunkVisible[chunk] = cullRange(begin, end); });
+			m_VisibleCount = 0;
+			for (uint32_t visible : chunkVisible)
+				m_VisibleCount += visible;
+		}
+		else
+			m_VisibleCount = cullRange(0, count);
+		m_CulledCount = count - m_VisibleCount;
+
+		// Compact in place, order doesn't matter since batching sorts it anyway
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < count; i++)
+			if (m_Visibility[i])
+			{
+				if (kept != i)
+					m_DrawList[kept] = m_DrawList[i];
+				kept++;
+			}
+		m_DrawList.resize(kept);
+		m_CullTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	vk::DeviceAddress Renderer::BuildDrawBatches(FrameData& frame, const glm::mat4& view, float farPlane)
+	{
+		// Sort keys, front to back inside each surface since everything is opaque for now
+		uint32_t count = static_cast<uint32_t>(m_DrawList.size());
+		m_SortKeys.resize(count);
+		m_SortOrder.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const RenderObject& object = m_DrawList[i];
+			float viewDepth = -(view * object.transform[3]).z; // Camera looks down -z
+			uint32_t shaderId = (object.material ? object.material->shaderId : 0) << ShaderFeatureBits | GetVertexFeatures(object); // Variants sort as their own shader
+			m_SortKeys[i] = SortKey::Make(SortKey::Opaque, shaderId, object.material ? object.material->materialId : 0, object.surfaceId,
+				SortKey::QuantizeDepth(viewDepth, farPlane));
+			m_SortOrder[i] = i;
+		}
+		RadixSort(m_SortKeys, m_SortOrder, m_SortKeysTemp, m_SortOrderTemp);
+		m_SortedDrawList.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			m_SortedDrawList[i] = m_DrawList[m_SortOrder[i]];
+		m_DrawList.swap(m_SortedDrawList);
+
+		// Same state bits and the same geometry means only the transform differs, ids can wrap so the geometry still gets checked
+		auto sameDraw = [](const RenderObject& a, const RenderObject& b)
+			{
+				return a.material == b.material && a.indexBuffer == b.indexBuffer && a.indexType == b.indexType && a.firstIndex == b.firstIndex
+					&& a.indexCount == b.indexCount && a.vertexOffset == b.vertexOffset && a.vertexBufferAddress == b.vertexBufferAddress;
+			};
+		m_DrawBatches.clear();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t first = m_DrawBatches.empty() ? 0 : m_DrawBatches.back().firstObject;
+			if (!m_DrawBatches.empty() && (m_SortKeys[first] & SortKey::StateMask) == (m_SortKeys[i] & SortKey::StateMask)
+				&& sameDraw(m_DrawList[first], m_DrawList[i]))
+				m_DrawBatches.back().instanceCount++;
+			else
+				m_DrawBatches.push_back(DrawBatch{ i, 1 });
+		}
+
+		// Recording threads can't wait on the pool they're running on, so every variant this frame draws with gets looked up here first
+		m_FrameVertexShaders.fill(vk::ShaderEXT{});
+		m_FrameVertexShaders[m_FrameFeatures] = m_VertexShaders.Get(m_FrameFeatures); // SetDrawState binds this one
+		for (const DrawBatch& batch : m_DrawBatches)
+		{
+			uint32_t features = GetVertexFeatures(m_DrawList[batch.firstObject]);
+			if (!m_FrameVertexShaders[features])
+				m_FrameVertexShaders[features] = m_VertexShaders.Get(features);
+		}
+
+		// One transform per render object, in draw batch order
+		FrameAllocation instances = frame.Transient.Allocate(m_DrawList.size() * sizeof(glm::mat4), alignof(glm::mat4));
+		glm::mat4* transforms = static_cast<glm::mat4*>(instances.Data);
+		for (size_t i = 0; i < m_DrawList.size(); i++)
+			transforms[i] = m_DrawList[i].transform;
+		return instances.Address;
+	}
+
+	uint32_t Renderer::GetVertexFeatures(const RenderObject& object) const
+	{
+		return m_FrameFeatures | (object.vertexFormat == VertexFormat::Packed ? PackedVertices : 0);
+	}
+
+	DrawStats Renderer::RecordDraws(vk::CommandBuffer commandBuffer, const DrawBatch* batches, size_t batchCount, PushConstantData pushConstants)
+	{ // The draw list is sorted by state, so all of these only change where the sort key does
+		DrawStats stats;
+		vk::Buffer boundIndexBuffer{};
+		vk::IndexType boundIndexType = vk::IndexType::eUint32;
+		vk::ShaderEXT boundVertexShader = m_FrameVertexShaders[m_FrameFeatures]; // SetDrawState binds the defaults
+		vk::ShaderEXT boundFragmentShader = m_FragmentShader.get();
+		PushConstantData pushed{};
+		bool hasPushed = false;
+		uint32_t defaultTexture = pushConstants.textureIndex, defaultSampler = pushConstants.samplerIndex; // For objects without a material
+		for (size_t i = 0; i < batchCount; i++)
+		{
+			const DrawBatch& batch = batches[i];
+			const RenderObject& object = m_DrawList[batch.firstObject];
+			stats.Draws++;
+
+			// The vertex shader variant depends on the mesh's vertex format, materials only swap the fragment shader
+			vk::ShaderEXT vertexShader = m_FrameVertexShaders[GetVertexFeatures(object)];
+			if (vertexShader != boundVertexShader)
+			{
+				vk::ShaderStageFlagBits stage = vk::ShaderStageFlagBits::eVertex;
+				commandBuffer.bindShadersEXT(1, &stage, &vertexShader, m_DLDI);
+				boundVertexShader = vertexShader;
+				stats.ShaderBinds++;
+			}
+			else
+				stats.ShaderBindsSaved++;
+
+			vk::ShaderEXT fragmentShader = object.material && object.material->shader ? object.material->shader : m_FragmentShader.get();
+			if (fragmentShader != boundFragmentShader)
+			{
+				vk::ShaderStageFlagBits stage = vk::ShaderStageFlagBits::eFragment;
+				commandBuffer.bindShadersEXT(1, &stage, &fragmentShader, m_DLDI);
+				boundFragmentShader = fragmentShader;
+				stats.ShaderBinds++;
+			}
+			else
+				stats.ShaderBindsSaved++;
+
+			if (object.indexBuffer != boundIndexBuffer || object.indexType != boundIndexType) // Every mesh in a pool block shares the one binding
+			{
+				commandBuffer.bindIndexBuffer(object.indexBuffer, 0, object.indexType);
+				boundIndexBuffer = object.indexBuffer;
+				boundIndexType = object.indexType;
+				stats.IndexBufferBinds++;
+			}
+			else
+				stats.IndexBufferBindsSaved++;
+
+			pushConstants.vertexBuffer = object.vertexBufferAddress;
+			pushConstants.positionOffset = glm::vec4(object.positionOffset, 0.0f);
+			pushConstants.positionScale = glm::vec4(object.positionScale, 0.0f);
+			pushConstants.textureIndex = object.material ? object.material->textureIndex : defaultTexture;
+			pushConstants.samplerIndex = object.material ? object.material->samplerIndex : defaultSampler;
+			if (!hasPushed || std::memcmp(&pushed, &pushConstants, sizeof(PushConstantData)) != 0) // Surfaces of the same mesh push the same thing
+			{
+				commandBuffer.pushConstants(*m_PipelineLayout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0,
+					sizeof(PushConstantData), &pushConstants);
+				std::memcpy(&pushed, &pushConstants, sizeof(PushConstantData)); // Padding included, so the memcmp stays stable
+				hasPushed = true;
+				stats.PushConstants++;
+			}
+			else
+				stats.PushConstantsSaved++;
+			commandBuffer.drawIndexed(object.indexCount, batch.instanceCount, object.firstIndex, object.vertexOffset, batch.firstObject); // gl_InstanceIndex picks the transform
+		}
+		return stats;
+	}
 
-		// Submit command buffer
-		vk::SemaphoreSubmitInfo waitSemaphoreInfo{ m_ImageAvailableSemaphore.get(), {}, vk::PipelineStageFlagBits2::eNone };
-		vk::CommandBufferSubmitInfo commandBufferInfo{ m_CommandBuffers[imageIndex.value].get() };
-		vk::SemaphoreSubmitInfo signalSemaphoreInfo{ m_RenderFinishedSemaphore.get(), {}, vk::PipelineStageFlagBits2::eNone };
-		m_DeviceQueue.submit2({ vk::SubmitInfo2{ {}, 1, &waitSemaphoreInfo, 1, &commandBufferInfo, 1, &signalSemaphoreInfo } }, m_InFlightFence.get());
-		static_cast<void>(m_Device->waitForFences(1, &m_InFlightFence.get(), VK_TRUE, UINT64_MAX));
+	void Renderer::RecordCommandBuffer(FrameData& frame, uint32_t imageIndex, const std::vector<vk::ClearValue>& clearValues,
+		const PushConstantData& pushConstants)
+	{
+		vk::CommandBuffer commandBuffer = frame.CommandBuffer.get();
+		// Nothing to draw (placeholder not up yet, everything culled) stays inline, executeCommands can't take zero secondaries
+		bool recordParallel = !m_DrawBatches.empty() && !frame.WorkerCommandBuffers.empty() && m_DrawBatches.size() >= m_Spec.ParallelRecordThreshold;
+
+		// Synchronisation2 barriers, the top one waits on the same stage the acquire semaphore does
+		vk::ImageMemoryBarrier2 topImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eNone,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Swapchain.Images[imageIndex],
+			vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } };
+		vk::ImageMemoryBarrier2 depthImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eLateFragmentTests, vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			vk::PipelineStageFlagBits2::eEarlyFragmentTests, vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_DepthImage.Image,
+			vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 } }; // Depth is shared between frames in flight, so wait on the last one
+		std::array<vk::ImageMemoryBarrier2, 2> topImageMemoryBarriers{ topImageMemoryBarrier2, depthImageMemoryBarrier2 };
+		vk::ImageLayout finalLayout = m_Spec.Headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR; // Offscreen is ready to be read back
+		vk::ImageMemoryBarrier2 bottomImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+			vk::ImageLayout::eAttachmentOptimal, finalLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Swapchain.Images[imageIndex],
+			vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } };
+
+		std::vector<vk::RenderingAttachmentInfo> attachments{ { m_Swapchain.ImageViews[imageIndex].get(), vk::ImageLayout::eAttachmentOptimal, {},{},{}, // Colour
+			vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, clearValues[0] } };
+		vk::RenderingAttachmentInfo depthAttachment{ m_DepthImage.ImageView, vk::ImageLayout::eAttachmentOptimal, {}, {}, {}, // Depth
+				vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare, clearValues[1] };
+
+		vk::RenderingInfo renderingInfo{ recordParallel ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags{},
+			vk::Rect2D{ { 0, 0 }, m_Swapchain.Extent }, 1, {}, attachments, &depthAttachment };
+
+		commandBuffer.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+		m_Profiler.BeginGpuFrame(commandBuffer, m_CurrentFrame); // Resets the queries, has to be outside of rendering
+		uint32_t frameScope = m_Profiler.BeginGpuScope(commandBuffer, "Frame");
+		uint32_t sceneScope = m_Profiler.BeginGpuScope(commandBuffer, "Scene");
+		commandBuffer.pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(topImageMemoryBarriers.size()), topImageMemoryBarriers.data() });
+
+		if (recordParallel)
+		{ // Each chunk of the draw list gets recorded into its own secondary on its own thread, then the primary just executes them
+			vk::CommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{ {}, 0, 1, &m_Swapchain.ImageFormat, vk::Format::eD32Sfloat,
+				vk::Format::eUndefined, vk::SampleCountFlagBits::e1 };
+			vk::CommandBufferInheritanceInfo inheritanceInfo{ {}, 0, {}, VK_FALSE, {}, {}, &inheritanceRenderingInfo };
+
+			uint32_t drawCount = static_cast<uint32_t>(m_DrawBatches.size());
+			uint32_t chunkCount = std::min(static_cast<uint32_t>(frame.WorkerCommandBuffers.size()), drawCount);
+			uint32_t chunkSize = (drawCount + chunkCount - 1) / chunkCount;
+			chunkCount = (drawCount + chunkSize - 1) / chunkSize; // The split ParallelFor makes, minus any empty chunks at the end
+			std::vector<DrawStats> chunkStats(chunkCount);
+			m_ThreadPool->ParallelFor(drawCount, chunkCount, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+				{
+					HYPER_PROFILE_SCOPE("Record chunk");
+					m_Device->resetCommandPool(frame.WorkerCommandPools[chunk].get()); // Fence already said the gpu is done with it
+					vk::CommandBuffer secondary = frame.WorkerCommandBuffers[chunk].get();
+					secondary.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+						| vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritanceInfo });
+					SetDrawState(secondary);
+					chunkStats[chunk] = RecordDraws(secondary, m_DrawBatches.data() + begin, end - begin, pushConstants);
+					secondary.end();
+				});
+			m_DrawStats = {};
+			for (const DrawStats& stats : chunkStats)
+				m_DrawStats += stats;
+
+			std::vector<vk::CommandBuffer> secondaries;
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+				secondaries.push_back(frame.WorkerCommandBuffers[chunk].get());
+			commandBuffer.beginRendering(&renderingInfo);
+			commandBuffer.executeCommands(secondaries);
+			commandBuffer.endRendering();
+			m_Profiler.EndGpuScope(commandBuffer, sceneScope);
+
+			// A pass that uses secondaries can't have anything inline, so ImGui gets its own pass on top
+			// It blends over the scene's colour, so that has to be finished first, depth only stays attached since ImGui's pipeline was made with it
+			std::array<vk::ImageMemoryBarrier2, 2> passBarriers{ vk::ImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+				vk::AccessFlagBits2::eColorAttachmentWrite, vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+				vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite, vk::ImageLayout::eAttachmentOptimal,
+				vk::ImageLayout::eAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Swapchain.Images[imageIndex],
+				vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } }, depthImageMemoryBarrier2 };
+			passBarriers[1].oldLayout = vk::ImageLayout::eAttachmentOptimal; // Contents don't matter, this just orders the don't care load after the scene's writes
+			commandBuffer.pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr,
+				static_cast<uint32_t>(passBarriers.size()), passBarriers.data() });
+			attachments[0].loadOp = vk::AttachmentLoadOp::eLoad;
+			depthAttachment.loadOp = vk::AttachmentLoadOp::eDontCare; // The scene's depth was never stored
+			renderingInfo.flags = {};
+			commandBuffer.beginRendering(&renderingInfo);
+		}
+		else
+		{
+			commandBuffer.beginRendering(&renderingInfo);
+			SetDrawState(commandBuffer);
+			m_DrawStats = RecordDraws(commandBuffer, m_DrawBatches.data(), m_DrawBatches.size(), pushConstants);
+			m_Profiler.EndGpuScope(commandBuffer, sceneScope); // Timestamps are fine inside rendering, ImGui just shares the pass here
+		}
 
-		static_cast<void>(m_PresentQueue.presentKHR({ 1, &m_RenderFinishedSemaphore.get(), 1, &m_Swapchain.ActualSwapchain.get(), &imageIndex.value }));
+		if (!m_Spec.Headless)
+		{
+			uint32_t imguiScope = m_Profiler.BeginGpuScope(commandBuffer, "ImGui");
+			ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+			m_Profiler.EndGpuScope(commandBuffer, imguiScope);
+		}
+
+		commandBuffer.endRendering();
+
+		commandBuffer.pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &bottomImageMemoryBarrier2 });
+		m_Profiler.EndGpuScope(commandBuffer, frameScope);
+
+		commandBuffer.end();
 	}
 
 	Renderer::~Renderer()
 	{
 		m_Device->waitIdle(); // Can't figure out how to wait for semaphore completion before closing app, this is the band-aid fix
+		m_VertexShaders.DestroyShaderVariants(); // Before the pool goes, it might still be building one
+		m_Profiler.DestroyProfiler();
 
-		for (auto& ub : m_UniformBuffers)
-			DestroyBuffer(m_Allocator, ub); // Eventually want to figure out a way to fit these inside unique pointers so they also descope automatically :D
+		for (FrameData& frame : m_Frames)
+			frame.Transient.DestroyFrameAllocator(); // Eventually want to figure out a way to fit these inside unique pointers so they also descope automatically :D
 
 		DestroyImage(m_Allocator, m_Device.get(), m_DepthImage);
 		DestroyImage(m_Allocator, m_Device.get(), m_TextureImage);
 		DestroyImage(m_Allocator, m_Device.get(), m_ErrorCheckerboardImage);
+		DestroyBuffer(m_Allocator, m_BindlessFallbackBuffer);
+		m_Swapchain.DestroyOffscreen(m_Allocator, m_Device.get()); // Nothing in it unless headless
 
-		for (std::shared_ptr<MeshAsset> meshAsset : testMeshes)
-		{
-			DestroyBuffer(m_Allocator, meshAsset->vertexBuffer);
-			DestroyBuffer(m_Allocator, meshAsset->indexBuffer);
-		}
+		m_AssetLoader.DestroyAssetLoader(); // Waits on anything still loading
+		FreeMesh(m_GeometryPool, *m_PlaceholderMesh);
+		m_GeometryPool.DestroyGeometryPool();
 
+		m_UploadContext.DestroyUploadContext();
+		m_MemoryTracker.DestroyMemoryTracker(); // Everything's been freed by now, so anything it still counts is a leak
 		vmaDestroyAllocator(m_Allocator);
 
-		ImGui_ImplVulkan_Shutdown();
-		ImGui_ImplGlfw_Shutdown();
-		ImGui::DestroyContext();
+		if (!m_Spec.Headless)
+		{
+			ImGui_ImplVulkan_Shutdown();
+			ImGui_ImplGlfw_Shutdown();
+			ImGui::DestroyContext();
+		}
 
 		Logger::logger->Log("Goodbye!");
 	}
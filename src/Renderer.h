@@ -1,12 +1,10 @@
 #pragma once
 #include <iostream>
 #include <filesystem>
+#include <array>
 #include <vulkan/vulkan.hpp> // Came with sdk
 #include <GLFW/glfw3.h> // Downloaded from their website
 #include <vma/vk_mem_alloc.h> // Came with sdk, if not, either re-install with this option on or download from respective site
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp> // Came with sdk, if not, either re-install with this option on or download from respective site
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
@@ -18,20 +16,63 @@
 #include "Mesh.h"
 #include "UserActions.h"
 #include "Camera.h"
+#include "ThreadPool.h"
+#include "Bindless.h"
+#include "Upload.h"
+#include "AssetLoader.h"
+#include "Culling.h"
+#include "DrawSort.h"
+#include "ShaderCache.h"
+#include "ShaderVariants.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "FrameAllocator.h"
 
 namespace hyper
 {
 	struct UniformBufferObject
 	{
-		glm::mat4 model;
 		glm::mat4 view;
 		glm::mat4 proj;
 	};
-	struct PushConstantData
+	struct PushConstantData // Feature toggles aren't in here, they're specialization constants, see ShaderVariants
 	{
+		glm::vec4 positionOffset; // vec4s first so the std430 offsets line up without any padding here
+		glm::vec4 positionScale;
 		vk::DeviceAddress vertexBuffer;
-		bool shouldSnap;
-		float snapFactor;
+		vk::DeviceAddress uniforms; // This frame's UniformBufferObject, out of the frame allocator
+		vk::DeviceAddress instances; // This frame's instance transforms, same
+		float snapFactor; // Only read by the SnapVertices variant
+		uint32_t textureIndex; // Indices into the bindless table
+		uint32_t samplerIndex;
+	};
+
+	struct DrawStats // Per frame, the saved counts are what recording everything for every draw would have done on top
+	{
+		uint32_t Draws = 0;
+		uint32_t ShaderBinds = 0, ShaderBindsSaved = 0;
+		uint32_t IndexBufferBinds = 0, IndexBufferBindsSaved = 0;
+		uint32_t PushConstants = 0, PushConstantsSaved = 0;
+
+		DrawStats& operator+=(const DrawStats& other)
+		{
+			Draws += other.Draws;
+			ShaderBinds += other.ShaderBinds; ShaderBindsSaved += other.ShaderBindsSaved;
+			IndexBufferBinds += other.IndexBufferBinds; IndexBufferBindsSaved += other.IndexBufferBindsSaved;
+			PushConstants += other.PushConstants; PushConstantsSaved += other.PushConstantsSaved;
+			return *this;
+		}
+	};
+
+	struct FrameData // Everything the cpu writes to while the gpu could still be reading the last use of this slot
+	{
+		vk::UniqueCommandBuffer CommandBuffer;
+		vk::UniqueFence InFlightFence;
+		vk::UniqueSemaphore ImageAvailableSemaphore;
+		FrameAllocator Transient; // Uniforms, instance transforms and anything else that's only needed for the frame, reset once the fence is waited on
+
+		std::vector<vk::UniqueCommandPool> WorkerCommandPools; // One per recording chunk, pools can't be touched by two threads at once
+		std::vector<vk::UniqueCommandBuffer> WorkerCommandBuffers;
 	};
 
 	class Renderer
@@ -43,10 +84,26 @@ namespace hyper
 
 		void SetFramebufferResized() { m_Swapchain.Resized = true; }
 
+		// Headless has no clock of its own, whoever drives it steps this so every run draws the same frames
+		void SetHeadlessTime(double seconds) { m_HeadlessTime = seconds; }
+		Camera& GetCamera() { return m_Camera; }
+		AssetState GetSceneState() const { return m_TestModel->State; }
+		std::string GetDeviceName() const { return m_PhysicalDevice.getProperties().deviceName.data(); }
+
 	private:
+		double GetTime() const { return m_Spec.Headless ? m_HeadlessTime : glfwGetTime(); }
+		void SetDrawState(vk::CommandBuffer commandBuffer);
+		void CullDrawList(const glm::mat4& viewProjection);
+		vk::DeviceAddress BuildDrawBatches(FrameData& frame, const glm::mat4& view, float farPlane); // Returns where the instance transforms went
+		uint32_t GetVertexFeatures(const RenderObject& object) const;
+		DrawStats RecordDraws(vk::CommandBuffer commandBuffer, const DrawBatch* batches, size_t batchCount, PushConstantData pushConstants);
+		void RecordCommandBuffer(FrameData& frame, uint32_t imageIndex, const std::vector<vk::ClearValue>& clearValues,
+			const PushConstantData& pushConstants);
+
 		Spec m_Spec;
 
-		GLFWwindow* m_Window{};
+		GLFWwindow* m_Window{}; // Null when headless
+		double m_HeadlessTime = 0.0;
 		vk::UniqueInstance m_Instance;
 
 		vk::detail::DispatchLoaderDynamic m_DLDI;
@@ -54,35 +111,63 @@ namespace hyper
 		vk::UniqueSurfaceKHR m_Surface;
 
 		vk::PhysicalDevice m_PhysicalDevice;
+		bool m_SupportsBC = false; // Block compressed textures
+		bool m_SupportsMemoryBudget = false; // VK_EXT_memory_budget
 		vk::UniqueDevice m_Device;
+		Profiler m_Profiler; // Also Profiler::profiler, anything can open a scope
 		
 		VmaAllocator m_Allocator{};
+		MemoryTracker m_MemoryTracker; // Also MemoryTracker::tracker, every tagged allocation is counted in it
 
-		uint32_t m_GraphicsIndex = -1, m_PresentIndex = -1;
-		vk::Queue m_DeviceQueue, m_PresentQueue;
+		uint32_t m_GraphicsIndex = -1, m_PresentIndex = -1, m_TransferIndex = -1, m_ComputeIndex = -1;
+		vk::Queue m_DeviceQueue, m_PresentQueue, m_TransferQueue, m_ComputeQueue; // Transfer and compute fall back to shared queues
+		std::mutex m_QueueMutex; // Held for submits and presents, other threads can flush uploads
 
 		Swapchain m_Swapchain;
 
 		vk::UniqueCommandPool m_CommandPool;
-		std::vector<vk::UniqueCommandBuffer> m_CommandBuffers;
 
-		vk::UniqueFence m_InFlightFence;
-		vk::UniqueSemaphore m_ImageAvailableSemaphore, m_RenderFinishedSemaphore;
+		std::vector<vk::UniqueSemaphore> m_RenderFinishedSemaphores; // One per swapchain image, present holds onto it until the image comes back
+
+		BindlessTable m_Bindless;
+		UploadContext m_UploadContext;
+		GeometryPool m_GeometryPool;
+
+		std::vector<FrameData> m_Frames;
+		uint32_t m_CurrentFrame = 0;
+
+		std::unique_ptr<ThreadPool> m_ThreadPool;
+		std::vector<RenderObject> m_DrawList;
+		std::vector<DrawBatch> m_DrawBatches;
+		std::vector<RenderObject> m_SortedDrawList; // Scratch space for sorting, kept around so it doesn't reallocate every frame
+		std::vector<uint64_t> m_SortKeys, m_SortKeysTemp;
+		std::vector<uint32_t> m_SortOrder, m_SortOrderTemp;
+		DrawStats m_DrawStats;
 
-		vk::UniqueDescriptorPool m_DescriptorPool;
+		CullBounds m_CullBounds;
+		std::vector<uint8_t> m_Visibility;
+		uint32_t m_VisibleCount = 0, m_CulledCount = 0;
+		float m_CullTime = 0.0f; // Milliseconds
 
 		Camera m_Camera;
 
-		std::vector<std::shared_ptr<MeshAsset>> testMeshes;
+		AssetLoader m_AssetLoader;
+		std::shared_ptr<ModelAsset> m_TestModel;
+		std::vector<MaterialInstance> m_TestModelMaterials; // One per image of the test model, made once it's resident
+		std::shared_ptr<MeshAsset> m_PlaceholderMesh; // Drawn in place of anything that isn't resident yet
 
+		ShaderCache m_ShaderCache;
 		// Should be handled by the render object soon
-		std::vector<vk::UniqueHandle<vk::ShaderEXT, vk::detail::DispatchLoaderDynamic>> m_Shaders;
+		ShaderVariants m_VertexShaders; // SnapVertices | PackedVertices
+		UniqueShader m_FragmentShader;
+		uint32_t m_FrameFeatures = 0; // Features every draw this frame has, packed meshes add PackedVertices on top
+		std::array<vk::ShaderEXT, 1 << ShaderFeatureBits> m_FrameVertexShaders{}; // Variants this frame uses, looked up before recording
 		vk::UniquePipelineLayout m_PipelineLayout;
-		vk::UniqueDescriptorSetLayout m_DescriptorSetLayout;
-		std::vector<vk::UniqueDescriptorSet> m_DescriptorSets;
-		std::vector<Buffer> m_UniformBuffers;
 		
 		Image m_DepthImage, m_TextureImage, m_ErrorCheckerboardImage;
 		vk::UniqueSampler m_NearestSampler, m_LinearSampler;
+		Buffer m_BindlessFallbackBuffer;
+		uint32_t m_TextureIndex = 0, m_LinearSamplerIndex = 0;
+		uint32_t m_ErrorCheckerboardIndex = BindlessTable::FallbackIndex, m_NearestSamplerIndex = BindlessTable::FallbackIndex; // They're the fallbacks
 	};
 }
\ No newline at end of file
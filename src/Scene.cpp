@@ -0,0 +1,109 @@
+#include "Scene.h"
+
+#include <algorithm>
+
+namespace hyper
+{
+	uint32_t Scene::AddNode(uint32_t parent, const std::string& name, glm::vec3 translation, glm::quat rotation, glm::vec3 scale, int32_t mesh)
+	{
+		uint32_t node = GetNodeCount();
+		m_Parent.push_back(parent);
+		m_SubtreeSize.push_back(1);
+		m_Translation.push_back(translation);
+		m_Rotation.push_back(rotation);
+		m_Scale.push_back(scale);
+		m_World.push_back(glm::mat4(1.0f));
+		m_Mesh.push_back(mesh);
+		m_Name.push_back(name);
+		m_Dirty.push_back(0);
+
+		for (uint32_t ancestor = parent; ancestor != NoParent; ancestor = m_Parent[ancestor])
+			m_SubtreeSize[ancestor]++;
+		MarkDirty(node);
+		return node;
+	}
+
+	void Scene::Clear()
+	{
+		m_Parent.clear();
+		m_SubtreeSize.clear();
+		m_Translation.clear();
+		m_Rotation.clear();
+		m_Scale.clear();
+		m_World.clear();
+		m_Mesh.clear();
+		m_Name.clear();
+		m_Dirty.clear();
+		m_DirtyNodes.clear();
+	}
+
+	uint32_t Scene::UpdateWorldMatrices(ThreadPool* threadPool, uint32_t parallelThreshold)
+	{
+		if (m_DirtyNodes.empty())
+			return 0;
+
+		// Sorted, anything inside a subtree that's already been updated can be skipped
+		std::sort(m_DirtyNodes.begin(), m_DirtyNodes.end());
+		uint32_t updated = 0;
+		uint32_t coveredEnd = 0;
+		for (uint32_t node : m_DirtyNodes)
+		{
+			m_Dirty[node] = 0;
+			if (node < coveredEnd)
+				continue;
+			uint32_t end = node + m_SubtreeSize[node];
+			coveredEnd = end;
+			updated += end - node;
+
+			if (!threadPool || end - node < parallelThreshold)
+			{
+				UpdateRange(node, end);
+				continue;
+			}
+
+			// Walk down while there's only one child, then each child subtree is independent of the others and gets its own task
+			uint32_t root = node;
+			UpdateRange(root, root + 1);
+			while (m_SubtreeSize[root] > 1 && m_SubtreeSize[root + 1] == m_SubtreeSize[root] - 1)
+			{
+				root++;
+				UpdateRange(root, root + 1);
+			}
+			std::vector<uint32_t> children;
+			for (uint32_t child = root + 1; child < root + m_SubtreeSize[root]; child += m_SubtreeSize[child])
+				children.push_back(child);
+			threadPool->ParallelFor(static_cast<uint32_t>(children.size()), threadPool->GetThreadCount() + 1,
+				[&](uint32_t, uint32_t first, uint32_t last)
+				{
+					for (uint32_t i = first; i < last; i++)
+						UpdateRange(children[i], children[i] + m_SubtreeSize[children[i]]);
+				});
+		}
+		m_DirtyNodes.clear();
+		return updated;
+	}
+
+	void Scene::MarkDirty(uint32_t node)
+	{
+		if (m_Dirty[node])
+			return;
+		m_Dirty[node] = 1;
+		m_DirtyNodes.push_back(node);
+	}
+
+	glm::mat4 Scene::GetLocalMatrix(uint32_t node) const
+	{ // T * R * S, same order glTF uses
+		glm::mat4 local = glm::mat4_cast(m_Rotation[node]);
+		local[0] *= m_Scale[node].x;
+		local[1] *= m_Scale[node].y;
+		local[2] *= m_Scale[node].z;
+		local[3] = glm::vec4(m_Translation[node], 1.0f);
+		return local;
+	}
+
+	void Scene::UpdateRange(uint32_t begin, uint32_t end)
+	{ // Depth first order means the parent of anything in here has either been done already in this loop or is outside it
+		for (uint32_t node = begin; node < end; node++)
+			m_World[node] = m_Parent[node] == NoParent ? GetLocalMatrix(node) : m_World[m_Parent[node]] * GetLocalMatrix(node);
+	}
+}
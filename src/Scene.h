@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "ThreadPool.h"
+
+namespace hyper
+{
+	// Flattened node tree, one array per field, nodes are stored depth first so parents always come before their children
+	// That makes every subtree one contiguous range, so a dirty node only has to update [node, node + subtree size) and nothing else
+	class Scene
+	{
+	public:
+		static constexpr uint32_t NoParent = ~0u;
+
+		// Nodes have to be added depth first, a node's parent has to be the last node added or one of its ancestors
+		uint32_t AddNode(uint32_t parent, const std::string& name, glm::vec3 translation, glm::quat rotation, glm::vec3 scale, int32_t mesh = -1);
+		void Clear();
+
+		void SetTranslation(uint32_t node, glm::vec3 translation) { m_Translation[node] = translation; MarkDirty(node); }
+		void SetRotation(uint32_t node, glm::quat rotation) { m_Rotation[node] = rotation; MarkDirty(node); }
+		void SetScale(uint32_t node, glm::vec3 scale) { m_Scale[node] = scale; MarkDirty(node); }
+
+		// Only touches dirty subtrees, big ones get split across the pool by child subtree, returns how many nodes were updated
+		uint32_t UpdateWorldMatrices(ThreadPool* threadPool = nullptr, uint32_t parallelThreshold = 4096);
+
+		uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Parent.size()); }
+		uint32_t GetParent(uint32_t node) const { return m_Parent[node]; }
+		uint32_t GetSubtreeSize(uint32_t node) const { return m_SubtreeSize[node]; }
+		int32_t GetMesh(uint32_t node) const { return m_Mesh[node]; }
+		const std::string& GetName(uint32_t node) const { return m_Name[node]; }
+		glm::vec3 GetTranslation(uint32_t node) const { return m_Translation[node]; }
+		glm::quat GetRotation(uint32_t node) const { return m_Rotation[node]; }
+		glm::vec3 GetScale(uint32_t node) const { return m_Scale[node]; }
+		const glm::mat4& GetWorldMatrix(uint32_t node) const { return m_World[node]; }
+		const std::vector<glm::mat4>& GetWorldMatrices() const { return m_World; }
+
+	private:
+		void MarkDirty(uint32_t node);
+		glm::mat4 GetLocalMatrix(uint32_t node) const;
+		void UpdateRange(uint32_t begin, uint32_t end); // Every parent outside the range has to be up to date already
+
+		std::vector<uint32_t> m_Parent;
+		std::vector<uint32_t> m_SubtreeSize; // Including the node itself
+		std::vector<glm::vec3> m_Translation;
+		std::vector<glm::quat> m_Rotation;
+		std::vector<glm::vec3> m_Scale;
+		std::vector<glm::mat4> m_World;
+		std::vector<int32_t> m_Mesh; // -1 for nodes that are only there for the hierarchy
+		std::vector<std::string> m_Name;
+
+		std::vector<uint8_t> m_Dirty; // Stops a node going into m_DirtyNodes twice
+		std::vector<uint32_t> m_DirtyNodes;
+	};
+}
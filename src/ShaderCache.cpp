@@ -0,0 +1,229 @@
+#include "ShaderCache.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+#include "File.h"
+#include "Hash.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+
+namespace hyper
+{
+	namespace
+	{
+		constexpr uint32_t ShaderBinaryMagic = 0x42485348; // "HSHB"
+		constexpr uint32_t ShaderBinaryFileVersion = 1;
+
+		struct ShaderBinaryHeader
+		{
+			uint32_t Magic;
+			uint32_t FileVersion;
+			uint8_t BinaryUUID[VK_UUID_SIZE];
+			uint32_t BinaryVersion;
+			uint32_t DriverVersion;
+			uint64_t Key; // Guards against a renamed file
+			uint64_t Size;
+			uint64_t Hash; // Of the binary, catches a write that got cut off
+		};
+
+		uint64_t HashSetLayout(const vk::DescriptorSetLayoutCreateInfo& info)
+		{
+			uint32_t header[2] = { static_cast<uint32_t>(info.flags), info.bindingCount };
+			uint64_t hash = HashBytes(header, sizeof(header));
+			for (uint32_t i = 0; i < info.bindingCount; i++)
+			{ // Immutable samplers' handles change every run, so only whether there are any goes in
+				const vk::DescriptorSetLayoutBinding& binding = info.pBindings[i];
+				uint32_t values[5] = { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount,
+					static_cast<uint32_t>(binding.stageFlags), binding.pImmutableSamplers != nullptr };
+				hash = HashBytes(values, sizeof(values), hash);
+			}
+			for (const vk::BaseInStructure* next = static_cast<const vk::BaseInStructure*>(info.pNext); next; next = next->pNext)
+				if (next->sType == vk::StructureType::eDescriptorSetLayoutBindingFlagsCreateInfo)
+				{
+					const vk::DescriptorSetLayoutBindingFlagsCreateInfo& flags = *reinterpret_cast<const vk::DescriptorSetLayoutBindingFlagsCreateInfo*>(next);
+					for (uint32_t i = 0; i < flags.bindingCount; i++)
+					{
+						uint32_t value = static_cast<uint32_t>(flags.pBindingFlags[i]);
+						hash = HashBytes(&value, sizeof(value), hash);
+					}
+				}
+			return hash;
+		}
+	}
+
+	void ShaderCache::CreateShaderCache(vk::Device device, vk::PhysicalDevice physicalDevice, vk::detail::DispatchLoaderDynamic& dldi,
+		const std::filesystem::path& directory)
+	{
+		m_Device = device;
+		m_DLDI = &dldi;
+		m_Directory = directory;
+
+		vk::StructureChain<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceShaderObjectPropertiesEXT> properties =
+			physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceShaderObjectPropertiesEXT>();
+		const vk::PhysicalDeviceShaderObjectPropertiesEXT& shaderObjectProperties = properties.get<vk::PhysicalDeviceShaderObjectPropertiesEXT>();
+		std::memcpy(m_BinaryUUID.data(), shaderObjectProperties.shaderBinaryUUID.data(), VK_UUID_SIZE);
+		m_BinaryVersion = shaderObjectProperties.shaderBinaryVersion;
+		m_DriverVersion = properties.get<vk::PhysicalDeviceProperties2>().properties.driverVersion;
+
+		std::error_code error;
+		std::filesystem::create_directories(m_Directory, error);
+		m_Enabled = !error;
+		if (!m_Enabled)
+			Logger::logger->Log("Couldn't create the shader cache at " + m_Directory.string() + ", shaders will be compiled every run", Severity::Warning);
+	}
+
+	void ShaderCache::AddSetLayout(vk::DescriptorSetLayout layout, const vk::DescriptorSetLayoutCreateInfo& info)
+	{
+		m_SetLayoutHashes[static_cast<VkDescriptorSetLayout>(layout)] = HashSetLayout(info);
+	}
+
+	std::vector<UniqueShader> ShaderCache::CreateShaders(const std::vector<ShaderDesc>& shaders, const std::vector<vk::DescriptorSetLayout>& setLayouts,
+		const std::vector<vk::PushConstantRange>& pushConstantRanges, ThreadPool* pool)
+	{
+		uint32_t hits = m_Hits, misses = m_Misses;
+		std::vector<UniqueShader> created(shaders.size());
+		if (pool)
+			pool->ParallelForEach(static_cast<uint32_t>(shaders.size()), [&](uint32_t index)
+				{ // Driver compiles are the slow part of a cold cache, and vkCreateShadersEXT is fine to call from several threads
+					created[index] = CreateShader(shaders[index], setLayouts, pushConstantRanges);
+				});
+		else
+			for (size_t i = 0; i < shaders.size(); i++)
+				created[i] = CreateShader(shaders[i], setLayouts, pushConstantRanges);
+
+		HYPER_LOG(Severity::Setup, "Shaders created: {} from the cache, {} compiled", m_Hits - hits, m_Misses - misses);
+		return created;
+	}
+
+	UniqueShader ShaderCache::CreateShader(const ShaderDesc& shader, const std::vector<vk::DescriptorSetLayout>& setLayouts,
+		const std::vector<vk::PushConstantRange>& pushConstantRanges)
+	{
+		std::vector<char> code = readFile(shader.Path.string());
+		if (code.empty())
+			return UniqueShader{};
+
+		vk::SpecializationInfo specializationInfo{ static_cast<uint32_t>(shader.Constants.size()), shader.Constants.data(), shader.ConstantData.size(),
+			shader.ConstantData.data() };
+		vk::ShaderCreateInfoEXT shaderInfo{ {}, shader.Stage, shader.NextStage, vk::ShaderCodeTypeEXT::eSpirv, code.size(), code.data(), "main",
+			static_cast<uint32_t>(setLayouts.size()), setLayouts.data(), static_cast<uint32_t>(pushConstantRanges.size()), pushConstantRanges.data(),
+			shader.Constants.empty() ? nullptr : &specializationInfo };
+
+		// A binary only matches the create info it was made with, so all of it goes in the key, the set layouts by what's in them rather than their handles
+		uint64_t key = HashBytes(code.data(), code.size());
+		uint32_t stages[3] = { static_cast<uint32_t>(shader.Stage), static_cast<uint32_t>(shader.NextStage), static_cast<uint32_t>(setLayouts.size()) };
+		key = HashBytes(stages, sizeof(stages), key);
+		bool cached = m_Enabled;
+		for (vk::DescriptorSetLayout layout : setLayouts)
+		{
+			auto found = m_SetLayoutHashes.find(static_cast<VkDescriptorSetLayout>(layout));
+			if (found == m_SetLayoutHashes.end())
+			{
+				HYPER_LOG(Severity::Warning, "{} uses a set layout the shader cache wasn't given, it won't be cached", shader.Path);
+				cached = false;
+				break;
+			}
+			key = HashBytes(&found->second, sizeof(found->second), key);
+		}
+		for (const vk::PushConstantRange& range : pushConstantRanges)
+		{
+			uint32_t values[3] = { static_cast<uint32_t>(range.stageFlags), range.offset, range.size };
+			key = HashBytes(values, sizeof(values), key);
+		}
+		for (const vk::SpecializationMapEntry& constant : shader.Constants)
+		{ // Every variant is its own binary
+			uint32_t values[3] = { constant.constantID, constant.offset, static_cast<uint32_t>(constant.size) };
+			key = HashBytes(values, sizeof(values), key);
+		}
+		key = HashBytes(shader.ConstantData.data(), shader.ConstantData.size(), key);
+
+		// Raw calls rather than vulkan.hpp so a rejected binary comes back as a result instead of an exception
+		VkShaderEXT handle = VK_NULL_HANDLE;
+		std::vector<uint8_t> binary;
+		if (cached && LoadBinary(key, binary))
+		{
+			vk::ShaderCreateInfoEXT binaryInfo = shaderInfo;
+			binaryInfo.setCodeType(vk::ShaderCodeTypeEXT::eBinary).setCodeSize(binary.size()).setPCode(binary.data());
+			VkResult result = m_DLDI->vkCreateShadersEXT(static_cast<VkDevice>(m_Device), 1, reinterpret_cast<const VkShaderCreateInfoEXT*>(&binaryInfo),
+				nullptr, &handle);
+			if (result == VK_SUCCESS)
+				m_Hits++;
+			else
+			{ // Driver updates are the usual reason, the header checks should catch most of those before we get here
+				Logger::logger->Log("Driver rejected the cached binary for " + shader.Path.string() + ", compiling it again", Severity::Warning);
+				handle = VK_NULL_HANDLE;
+			}
+		}
+
+		if (handle == VK_NULL_HANDLE)
+		{
+			if (m_DLDI->vkCreateShadersEXT(static_cast<VkDevice>(m_Device), 1, reinterpret_cast<const VkShaderCreateInfoEXT*>(&shaderInfo),
+				nullptr, &handle) != VK_SUCCESS)
+			{
+				Logger::logger->Log("Failed to create shader from " + shader.Path.string(), Severity::Error);
+				return UniqueShader{};
+			}
+			m_Misses++;
+			if (cached)
+				SaveBinary(key, m_Device.getShaderBinaryDataEXT(vk::ShaderEXT(handle), *m_DLDI));
+		}
+		return UniqueShader(vk::ShaderEXT(handle), vk::detail::ObjectDestroy<vk::Device, vk::detail::DispatchLoaderDynamic>(m_Device, nullptr, *m_DLDI));
+	}
+
+	bool ShaderCache::LoadBinary(uint64_t key, std::vector<uint8_t>& binary) const
+	{
+		std::ifstream file(GetPath(key), std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		ShaderBinaryHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.Magic != ShaderBinaryMagic
+			|| header.FileVersion != ShaderBinaryFileVersion || header.Key != key)
+			return false;
+		// Made by a different gpu or driver, the driver would most likely reject it anyway
+		if (std::memcmp(header.BinaryUUID, m_BinaryUUID.data(), VK_UUID_SIZE) != 0 || header.BinaryVersion != m_BinaryVersion
+			|| header.DriverVersion != m_DriverVersion)
+			return false;
+
+		binary.resize(header.Size);
+		if (!file.read(reinterpret_cast<char*>(binary.data()), header.Size) || HashBytes(binary.data(), binary.size()) != header.Hash)
+			return false;
+		return true;
+	}
+
+	void ShaderCache::SaveBinary(uint64_t key, const std::vector<uint8_t>& binary) const
+	{
+		if (binary.empty())
+			return;
+		ShaderBinaryHeader header{ ShaderBinaryMagic, ShaderBinaryFileVersion, {}, m_BinaryVersion, m_DriverVersion, key, binary.size(),
+			HashBytes(binary.data(), binary.size()) };
+		std::memcpy(header.BinaryUUID, m_BinaryUUID.data(), VK_UUID_SIZE);
+
+		// Written next to it then renamed over, so another instance never reads half a file
+		std::filesystem::path path = GetPath(key);
+		std::filesystem::path temporary = path;
+		temporary += ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				return;
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+			if (!file)
+				return;
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, path, error);
+		if (error)
+			std::filesystem::remove(temporary, error);
+	}
+
+	std::filesystem::path ShaderCache::GetPath(uint64_t key) const
+	{
+		std::ostringstream name;
+		name << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+		return m_Directory / name.str();
+	}
+}
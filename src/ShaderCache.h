@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <atomic>
+#include <filesystem>
+#include <vulkan/vulkan.hpp>
+
+namespace hyper
+{
+	class ThreadPool;
+
+	using UniqueShader = vk::UniqueHandle<vk::ShaderEXT, vk::detail::DispatchLoaderDynamic>;
+
+	struct ShaderDesc // One stage, the layout is shared by every shader in a CreateShaders call
+	{
+		std::filesystem::path Path; // SPIR-V
+		vk::ShaderStageFlagBits Stage;
+		vk::ShaderStageFlags NextStage;
+		std::vector<vk::SpecializationMapEntry> Constants; // Specialization constants, empty for none, see ShaderVariants
+		std::vector<uint8_t> ConstantData;
+	};
+
+	// Keeps what vkGetShaderBinaryDataEXT hands back on disk, one file per shader, so later runs skip the driver compiling SPIR-V
+	// Files are named by a hash of the SPIR-V and create info (set layout bindings included), and only used while the shaderBinaryUUID/version and driver version still match
+	class ShaderCache
+	{
+	public:
+		void CreateShaderCache(vk::Device device, vk::PhysicalDevice physicalDevice, vk::detail::DispatchLoaderDynamic& dldi,
+			const std::filesystem::path& directory);
+
+		// Handles mean nothing across runs, so each set layout's bindings have to be given here before any shader that uses it is created
+		// A shader using a layout that wasn't added still gets made, it just skips the cache
+		void AddSetLayout(vk::DescriptorSetLayout layout, const vk::DescriptorSetLayoutCreateInfo& info);
+
+		// From the cached binary when there's one the driver accepts, from SPIR-V otherwise (which writes the cache), in the same order as shaders
+		// With a pool every shader gets created at once, anything that fails completely is left as a null handle
+		std::vector<UniqueShader> CreateShaders(const std::vector<ShaderDesc>& shaders, const std::vector<vk::DescriptorSetLayout>& setLayouts,
+			const std::vector<vk::PushConstantRange>& pushConstantRanges, ThreadPool* pool = nullptr);
+
+		// Just the one, safe to call from any thread
+		UniqueShader CreateShader(const ShaderDesc& shader, const std::vector<vk::DescriptorSetLayout>& setLayouts,
+			const std::vector<vk::PushConstantRange>& pushConstantRanges);
+
+		uint32_t GetHits() const { return m_Hits; }
+		uint32_t GetMisses() const { return m_Misses; }
+
+	private:
+		bool LoadBinary(uint64_t key, std::vector<uint8_t>& binary) const;
+		void SaveBinary(uint64_t key, const std::vector<uint8_t>& binary) const;
+		std::filesystem::path GetPath(uint64_t key) const;
+
+		vk::Device m_Device;
+		vk::detail::DispatchLoaderDynamic* m_DLDI = nullptr;
+		std::filesystem::path m_Directory;
+		bool m_Enabled = false; // Off if the directory can't be made, everything just compiles
+		std::unordered_map<VkDescriptorSetLayout, uint64_t> m_SetLayoutHashes; // Only written by AddSetLayout, so shader threads can read it without a lock
+
+		std::array<uint8_t, VK_UUID_SIZE> m_BinaryUUID{};
+		uint32_t m_BinaryVersion = 0, m_DriverVersion = 0;
+
+		std::atomic<uint32_t> m_Hits{ 0 }, m_Misses{ 0 };
+	};
+}
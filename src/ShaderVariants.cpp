@@ -0,0 +1,75 @@
+#include "ShaderVariants.h"
+
+#include "ThreadPool.h"
+
+namespace hyper
+{
+	void ShaderVariants::CreateShaderVariants(ShaderCache& cache, ThreadPool& pool, const ShaderDesc& shader,
+		const std::vector<vk::DescriptorSetLayout>& setLayouts, const std::vector<vk::PushConstantRange>& pushConstantRanges, uint32_t featureMask)
+	{
+		m_Cache = &cache;
+		m_Pool = &pool;
+		m_Shader = shader;
+		m_SetLayouts = setLayouts;
+		m_PushConstantRanges = pushConstantRanges;
+		m_FeatureMask = featureMask;
+
+		// Every variant has a constant for every bit in the mask, only the values change
+		m_Shader.Constants.clear();
+		for (uint32_t bit = 0; bit < 32; bit++)
+			if (m_FeatureMask & (1u << bit))
+				m_Shader.Constants.push_back(vk::SpecializationMapEntry{ bit, static_cast<uint32_t>(m_Shader.Constants.size() * sizeof(VkBool32)),
+					sizeof(VkBool32) });
+	}
+
+	void ShaderVariants::DestroyShaderVariants()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (std::pair<const uint32_t, std::unique_ptr<Variant>>& variant : m_Variants)
+			variant.second->Ready.wait(); // The pool could still be writing into it
+		m_Variants.clear();
+	}
+
+	void ShaderVariants::Request(uint32_t features)
+	{
+		features &= m_FeatureMask;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::unique_ptr<Variant>& variant = m_Variants[features];
+		if (variant)
+			return;
+		variant = std::make_unique<Variant>();
+
+		ShaderDesc shader = m_Shader;
+		for (const vk::SpecializationMapEntry& constant : shader.Constants)
+		{
+			VkBool32 value = (features >> constant.constantID) & 1;
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+			shader.ConstantData.insert(shader.ConstantData.end(), bytes, bytes + sizeof(value));
+		}
+		Variant* target = variant.get();
+		variant->Ready = m_Pool->Submit([this, target, shader]()
+			{
+				target->Shader = m_Cache->CreateShader(shader, m_SetLayouts, m_PushConstantRanges);
+			}).share();
+	}
+
+	vk::ShaderEXT ShaderVariants::Get(uint32_t features)
+	{
+		Request(features);
+		Variant* variant = Find(features);
+		variant->Ready.wait(); // Only blocks the first time a variant nobody requested is needed
+		return variant->Shader.get();
+	}
+
+	uint32_t ShaderVariants::GetVariantCount()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return static_cast<uint32_t>(m_Variants.size());
+	}
+
+	ShaderVariants::Variant* ShaderVariants::Find(uint32_t features)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Variants[features & m_FeatureMask].get();
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <unordered_map>
+#include <vulkan/vulkan.hpp>
+
+#include "ShaderCache.h"
+
+namespace hyper
+{
+	class ThreadPool;
+
+	enum ShaderFeature : uint32_t // Each bit is a bool specialization constant whose constant_id is the bit's index, has to match the shaders
+	{
+		SnapVertices = 1 << 0,
+		PackedVertices = 1 << 1 // Vertex buffer holds PackedVertex instead of Vertex
+	};
+	constexpr uint32_t ShaderFeatureBits = 2;
+
+	// Every combination of a shader's feature bits is its own ShaderEXT with the bits baked in, so the shader never branches on them
+	// Variants get built on the pool the first time they're asked for and stay around, the binaries go through the ShaderCache like any other shader
+	class ShaderVariants
+	{
+	public:
+		// featureMask is every bit this shader has a constant for, anything else asked for is ignored
+		void CreateShaderVariants(ShaderCache& cache, ThreadPool& pool, const ShaderDesc& shader, const std::vector<vk::DescriptorSetLayout>& setLayouts,
+			const std::vector<vk::PushConstantRange>& pushConstantRanges, uint32_t featureMask);
+		void DestroyShaderVariants(); // Waits on anything still building
+
+		void Request(uint32_t features); // Starts building it if nobody has yet, returns straight away
+		// Waits if it's still building, so ask for it with Request ahead of time, never call this from one of the pool's threads
+		vk::ShaderEXT Get(uint32_t features);
+
+		uint32_t GetFeatureMask() const { return m_FeatureMask; }
+		uint32_t GetVariantCount();
+
+	private:
+		struct Variant
+		{
+			std::shared_future<void> Ready;
+			UniqueShader Shader; // Null if it failed to build
+		};
+
+		Variant* Find(uint32_t features);
+
+		ShaderCache* m_Cache = nullptr;
+		ThreadPool* m_Pool = nullptr;
+		ShaderDesc m_Shader;
+		std::vector<vk::DescriptorSetLayout> m_SetLayouts;
+		std::vector<vk::PushConstantRange> m_PushConstantRanges;
+		uint32_t m_FeatureMask = 0;
+
+		std::unordered_map<uint32_t, std::unique_ptr<Variant>> m_Variants; // Pointers stay put while the map grows, the pool writes through them
+		std::mutex m_Mutex;
+	};
+}
@@ -10,8 +10,22 @@ namespace hyper
 	{ // Default options, just in case
 		bool Debug = DEBUG_ON;
 		bool InfoDebug = DEBUG_ON;
+		bool Validation = DEBUG_ON; // Only with Debug on too, the benchmark turns it off so the layer doesn't end up in the timings
+		bool Headless = false; // No window, surface or swapchain, frames get drawn into offscreen images (ci and render farm boxes)
+		std::string LogPath; // Log messages also go to this file (without the colours), empty only logs to the console
+		std::string DeviceName; // Picks the first device with this in its name ("llvmpipe" for lavapipe), empty prefers a discrete gpu
+		std::string ModelPath = "res/model/basicmesh.glb";
 		std::string Title = "App";
 		uint32_t Width = 1600, Height = 900;
+		uint32_t FramesInFlight = 2; // How many frames the cpu can get ahead of the gpu, 1 brings back the old stall-every-frame behaviour
+		uint32_t RecordThreads = 0; // Worker threads for the thread pool, 0 lets it pick from the core count
+		uint32_t ParallelRecordThreshold = 512; // Draw lists smaller than this get recorded on the main thread, secondaries aren't free
+		uint32_t ParallelCullThreshold = 16384; // Same idea for culling, the kernel is quick enough that small lists aren't worth waking threads for
+		uint32_t LoaderThreads = 2; // Asset loading gets its own threads, so loading doesn't fight with command recording
+		uint64_t StagingBufferSize = 64ull * 1024 * 1024; // Size of the upload ring, anything bigger gets its own staging buffer
+		uint64_t GeometryBlockSize = 128ull * 1024 * 1024; // Vertices and indices for every mesh share blocks this size
+		uint64_t FrameAllocatorSize = 4ull * 1024 * 1024; // Per frame slot, for uniforms and instance transforms, grows if a frame doesn't fit
+		float MemoryPressureThreshold = 0.9f; // Fraction of a heap's budget, past it the memory tracker's pressure callbacks get called every frame
 		uint32_t ApiVersion = 4206881; // 1.3.289
 		// VK_MAKE_API_VERSION(0,1,3,0); = 4206592
 		// VK_MAKE_API_VERSION(0,1,3,289); = 4206881
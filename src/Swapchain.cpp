@@ -48,4 +48,33 @@ namespace hyper
 				vk::ComponentMapping{ vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
 				vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } }));
 	}
+
+	void Swapchain::CreateOffscreen(uint32_t count, vk::Format format, vk::Extent2D extent, VmaAllocator& allocator, vk::Device device)
+	{
+		DestroyOffscreen(allocator, device);
+		Resized = false;
+		ImageCount = count;
+		ImageFormat = format;
+		Extent = extent;
+
+		for (uint32_t i = 0; i < count; i++)
+		{ // Transfer source as well so frames can be read back
+			Image image = CreateImage(allocator, device, Extent, ImageFormat, vk::ImageTiling::eOptimal,
+				vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_GPU_ONLY,
+				{ MemoryCategory::RenderTarget, "Offscreen swapchain image" });
+			Images.push_back(image.Image);
+			ImageViews.push_back(vk::UniqueImageView(image.ImageView, device)); // Owned by ImageViews like a real swapchain's
+			image.ImageView = nullptr;
+			OffscreenImages.push_back(image);
+		}
+	}
+
+	void Swapchain::DestroyOffscreen(VmaAllocator& allocator, vk::Device device)
+	{
+		ImageViews.clear();
+		Images.clear();
+		for (Image& image : OffscreenImages)
+			DestroyImage(allocator, device, image); // Null view, so only the image goes
+		OffscreenImages.clear();
+	}
 }
\ No newline at end of file
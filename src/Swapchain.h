@@ -2,6 +2,8 @@
 #include <vulkan/vulkan.hpp>
 #include <GLFW/glfw3.h>
 
+#include "Image.h"
+
 namespace hyper
 {
 	struct Swapchain
@@ -14,8 +16,12 @@ namespace hyper
 		vk::Format ImageFormat = { vk::Format::eUndefined };
 		vk::Extent2D Extent;
 		bool Resized = false;
+		std::vector<Image> OffscreenImages; // Headless only, Images and ImageViews point at these
 
 		void CreateSwapchain(uint32_t count, vk::Format format, vk::Extent2D extent, GLFWwindow* window, vk::Device device,
 			uint32_t graphicsIndex, uint32_t presentIndex, vk::SurfaceKHR surface);
+		// Stands in for a swapchain when there's no surface, one image per frame in flight so nothing needs acquiring
+		void CreateOffscreen(uint32_t count, vk::Format format, vk::Extent2D extent, VmaAllocator& allocator, vk::Device device);
+		void DestroyOffscreen(VmaAllocator& allocator, vk::Device device);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace hyper
+{
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		m_Workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+			m_Workers.emplace_back([this]() { WorkerLoop(); });
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Condition.notify_all();
+		for (std::thread& worker : m_Workers)
+			worker.join();
+	}
+
+	void ThreadPool::ParallelFor(uint32_t count, uint32_t chunkCount, const std::function<void(uint32_t chunk, uint32_t begin, uint32_t end)>& task)
+	{
+		chunkCount = std::max(std::min(chunkCount, count), 1u);
+		uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+		std::vector<std::future<void>> futures;
+		futures.reserve(chunkCount - 1);
+		for (uint32_t chunk = 1; chunk < chunkCount; chunk++)
+		{
+			uint32_t begin = std::min(chunk * chunkSize, count);
+			uint32_t end = std::min(begin + chunkSize, count);
+			futures.push_back(Submit([&task, chunk, begin, end]() { task(chunk, begin, end); }));
+		}
+		task(0, 0, std::min(chunkSize, count)); // No point in this thread sitting around waiting
+		for (std::future<void>& future : futures)
+			future.get();
+	}
+
+	void ThreadPool::ParallelForEach(uint32_t count, const std::function<void(uint32_t index)>& task)
+	{
+		struct State
+		{
+			std::atomic<uint32_t> Next{ 0 };
+			uint32_t Done = 0;
+			std::mutex Mutex;
+			std::condition_variable Finished;
+		};
+		// Helpers that only get picked up after everything's done still touch the state, so it can't live on this stack
+		std::shared_ptr<State> state = std::make_shared<State>();
+		const std::function<void(uint32_t index)>* work = &task;
+		auto run = [state, work, count]()
+			{
+				uint32_t done = 0;
+				for (uint32_t index = state->Next++; index < count; index = state->Next++)
+				{
+					(*work)(index);
+					done++;
+				}
+				if (done == 0)
+					return;
+				std::lock_guard<std::mutex> lock(state->Mutex);
+				state->Done += done;
+				if (state->Done == count)
+					state->Finished.notify_one();
+			};
+
+		uint32_t helpers = count > 1 ? std::min(count - 1, GetThreadCount()) : 0; // This thread is the other one
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (uint32_t i = 0; i < helpers; i++)
+				m_Tasks.emplace(run);
+		}
+		m_Condition.notify_all();
+
+		run();
+		std::unique_lock<std::mutex> lock(state->Mutex);
+		state->Finished.wait(lock, [&]() { return state->Done == count; });
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Condition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+				if (m_Stopping && m_Tasks.empty())
+					return;
+				task = std::move(m_Tasks.front());
+				m_Tasks.pop();
+			}
+			task();
+		}
+	}
+}
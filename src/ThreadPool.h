@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+
+namespace hyper
+{
+	class ThreadPool
+	{
+	public:
+		ThreadPool(uint32_t threadCount = 0); // 0 means one less than the hardware threads, the calling thread is the last one
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+		template<typename F>
+		auto Submit(F&& task) -> std::future<decltype(task())>
+		{ // packaged_task isn't copyable so it can't go straight into a std::function, shared_ptr gets around that
+			using Result = decltype(task());
+			std::shared_ptr<std::packaged_task<Result()>> packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+			std::future<Result> future = packagedTask->get_future();
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Tasks.emplace([packagedTask]() { (*packagedTask)(); });
+			}
+			m_Condition.notify_one();
+			return future;
+		}
+
+		// Splits [0, count) into chunkCount contiguous ranges and blocks until they're all done, the calling thread runs chunk 0
+		void ParallelFor(uint32_t count, uint32_t chunkCount, const std::function<void(uint32_t chunk, uint32_t begin, uint32_t end)>& task);
+		// One index at a time, whichever thread is free takes the next one, for work that varies a lot in cost (decoding images of different sizes)
+		// Waits on the work rather than on futures, so it's fine to call from inside a pool task, the caller just does it all if nobody else is free
+		void ParallelForEach(uint32_t count, const std::function<void(uint32_t index)>& task);
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> m_Workers;
+		std::queue<std::function<void()>> m_Tasks;
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		bool m_Stopping = false;
+	};
+}
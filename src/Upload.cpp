@@ -0,0 +1,315 @@
+#include "Upload.h"
+
+#include <algorithm>
+
+#include "Logger.h"
+
+namespace hyper
+{
+	static constexpr vk::DeviceSize StagingAlignment = 16; // Covers every texel and compressed block size we upload
+
+	void UploadContext::CreateUploadContext(VmaAllocator& allocator, vk::Device device, vk::Queue queue, uint32_t queueFamily, vk::Queue graphicsQueue,
+		uint32_t graphicsFamily, std::mutex& graphicsQueueMutex, vk::DeviceSize stagingSize)
+	{
+		m_Allocator = allocator;
+		m_Device = device;
+		m_Queue = queue;
+		m_QueueFamily = queueFamily;
+		m_GraphicsQueue = graphicsQueue;
+		m_GraphicsFamily = graphicsFamily;
+		m_GraphicsQueueMutex = &graphicsQueueMutex;
+
+		m_CommandPool = m_Device.createCommandPoolUnique({ vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient,
+			m_QueueFamily });
+		if (m_QueueFamily != m_GraphicsFamily)
+			m_AcquireCommandPool = m_Device.createCommandPoolUnique({ vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+				| vk::CommandPoolCreateFlagBits::eTransient, m_GraphicsFamily });
+		vk::SemaphoreTypeCreateInfo timelineInfo{ vk::SemaphoreType::eTimeline, 0 };
+		m_Timeline = m_Device.createSemaphoreUnique({ {}, &timelineInfo });
+		if (m_QueueFamily != m_GraphicsFamily)
+			m_TransferTimeline = m_Device.createSemaphoreUnique({ {}, &timelineInfo });
+
+		m_RingSize = stagingSize;
+		m_Ring = CreateBuffer(m_Allocator, m_RingSize, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY,
+			{ MemoryCategory::Staging, "Staging ring" });
+	}
+
+	void UploadContext::DestroyUploadContext()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		FlushLocked();
+		while (!m_InFlight.empty())
+		{
+			vk::SemaphoreWaitInfo waitInfo{ {}, 1, &m_Timeline.get(), &m_InFlight.back().Ticket };
+			static_cast<void>(m_Device.waitSemaphores(waitInfo, UINT64_MAX));
+			Retire();
+		}
+		DestroyBuffer(m_Allocator, m_Ring);
+	}
+
+	void UploadContext::Stage(const void* data, vk::DeviceSize size, const std::function<void(vk::CommandBuffer commandBuffer, vk::Buffer staging,
+		vk::DeviceSize offset)>& commands)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		uint64_t pos = 0;
+		if (!AllocateRing(size, pos))
+		{ // Rare enough that a one-off buffer is fine, it goes away when the batch it's in completes
+			HYPER_LOG(Severity::Warning, "Upload of {} bytes doesn't fit in the staging ring, using its own buffer", size);
+			Buffer overflow = CreateBuffer(m_Allocator, size, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY,
+				{ MemoryCategory::Staging, "Staging overflow" });
+			memcpy(overflow.AllocationInfo.pMappedData, data, size);
+			commands(GetPendingCommandBuffer(), overflow.Buffer, 0);
+			m_Pending.Overflow.push_back(overflow);
+			return;
+		}
+
+		vk::DeviceSize offset = pos % m_RingSize;
+		memcpy(static_cast<char*>(m_Ring.AllocationInfo.pMappedData) + offset, data, size);
+		commands(GetPendingCommandBuffer(), m_Ring.Buffer, offset);
+	}
+
+	StagingAllocation UploadContext::Reserve(vk::DeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		StagingAllocation allocation;
+		allocation.Size = size;
+		uint64_t pos = 0;
+		if (AllocateRing(size, pos))
+		{
+			m_Reserved.insert(pos);
+			allocation.RingPos = pos;
+			allocation.Buffer = m_Ring.Buffer;
+			allocation.Offset = pos % m_RingSize;
+			allocation.Data = static_cast<char*>(m_Ring.AllocationInfo.pMappedData) + allocation.Offset;
+		}
+		else
+		{
+			allocation.Overflow = CreateBuffer(m_Allocator, size, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY,
+				{ MemoryCategory::Staging, "Staging overflow" });
+			allocation.Buffer = allocation.Overflow.Buffer;
+			allocation.Data = allocation.Overflow.AllocationInfo.pMappedData;
+		}
+		return allocation;
+	}
+
+	void UploadContext::Commit(StagingAllocation& allocation, const std::function<void(vk::CommandBuffer commandBuffer, vk::Buffer staging,
+		vk::DeviceSize offset)>& commands)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		commands(GetPendingCommandBuffer(), allocation.Buffer, allocation.Offset);
+		// Ring space stays reserved until this batch retires, an older batch retiring first mustn't free it
+		if (allocation.RingPos != ~0ull)
+			m_Pending.Reserved.push_back(allocation.RingPos);
+		else
+			m_Pending.Overflow.push_back(allocation.Overflow);
+		allocation = {};
+	}
+
+	void UploadContext::Cancel(StagingAllocation& allocation)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (allocation.RingPos != ~0ull)
+			m_Reserved.erase(m_Reserved.find(allocation.RingPos)); // The space comes back once whatever batch is after it retires
+		else if (allocation.Overflow.Buffer)
+			DestroyBuffer(m_Allocator, allocation.Overflow);
+		allocation = {};
+	}
+
+	bool UploadContext::AllocateRing(vk::DeviceSize size, uint64_t& pos)
+	{
+		if (size > m_RingSize)
+			return false;
+		while (true)
+		{
+			pos = (m_WritePos + StagingAlignment - 1) / StagingAlignment * StagingAlignment;
+			if (pos % m_RingSize + size > m_RingSize)
+				pos = (pos / m_RingSize + 1) * m_RingSize; // Doesn't fit before the end, skip to the start of the ring
+			if (pos + size - m_ReadPos <= m_RingSize)
+				break;
+
+			// Out of room, free up whatever the gpu is done with and wait on the oldest batch if that isn't enough
+			Retire();
+			if (m_InFlight.empty() && !m_HasPending)
+			{
+				if (!m_Reserved.empty())
+					return false; // Only reservations are holding the ring, and they get committed on other threads, so no waiting here
+				m_WritePos = m_ReadPos = 0; // Nothing is using the ring at all, start again from the top
+				continue;
+			}
+			if (m_InFlight.empty())
+				FlushLocked(); // The pending batch is the only thing holding the ring
+			vk::SemaphoreWaitInfo waitInfo{ {}, 1, &m_Timeline.get(), &m_InFlight.front().Ticket };
+			static_cast<void>(m_Device.waitSemaphores(waitInfo, UINT64_MAX));
+		}
+		m_WritePos = pos + size;
+		return true;
+	}
+
+	void UploadContext::Record(const std::function<void(vk::CommandBuffer commandBuffer)>& commands)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		commands(GetPendingCommandBuffer());
+	}
+
+	void UploadContext::RecordGraphics(const std::function<void(vk::CommandBuffer commandBuffer)>& commands)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_QueueFamily == m_GraphicsFamily)
+			commands(GetPendingCommandBuffer()); // Upload queue can already do graphics, so it all stays in one command buffer
+		else
+			m_Pending.GraphicsCommands.push_back(commands);
+	}
+
+	void UploadContext::ReleaseBuffer(vk::CommandBuffer commandBuffer, vk::Buffer buffer)
+	{
+		if (m_QueueFamily == m_GraphicsFamily)
+			return; // The barrier at the end of the batch covers it
+
+		vk::BufferMemoryBarrier2 releaseBufferMemoryBarrier2{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, m_QueueFamily, m_GraphicsFamily, buffer, 0, VK_WHOLE_SIZE };
+		commandBuffer.pipelineBarrier2({ {}, 0, nullptr, 1, &releaseBufferMemoryBarrier2 });
+		m_Pending.BufferAcquires.push_back(vk::BufferMemoryBarrier2{ vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+			vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead, m_QueueFamily, m_GraphicsFamily, buffer, 0, VK_WHOLE_SIZE });
+	}
+
+	void UploadContext::ReleaseImage(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageSubresourceRange range, vk::ImageLayout oldLayout,
+		vk::ImageLayout newLayout)
+	{
+		if (m_QueueFamily == m_GraphicsFamily)
+		{ // Same family, so it's just the layout transition
+			vk::ImageMemoryBarrier2 imageMemoryBarrier2{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderRead, oldLayout, newLayout,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, range };
+			commandBuffer.pipelineBarrier2({ vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier2 });
+			return;
+		}
+
+		// Release and acquire have to match exactly, layout transition included, it happens once between the two
+		vk::ImageMemoryBarrier2 releaseImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, oldLayout, newLayout, m_QueueFamily, m_GraphicsFamily, image, range };
+		commandBuffer.pipelineBarrier2({ {}, 0, nullptr, 0, nullptr, 1, &releaseImageMemoryBarrier2 });
+		m_Pending.ImageAcquires.push_back(vk::ImageMemoryBarrier2{ vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+			vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eTransfer, // Transfer for mip blits recorded with RecordGraphics
+			vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite, oldLayout, newLayout,
+			m_QueueFamily, m_GraphicsFamily, image, range });
+	}
+
+	uint64_t UploadContext::Flush()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return FlushLocked();
+	}
+
+	void UploadContext::Wait(uint64_t ticket)
+	{
+		if (ticket == 0)
+			return;
+		vk::SemaphoreWaitInfo waitInfo{ {}, 1, &m_Timeline.get(), &ticket };
+		static_cast<void>(m_Device.waitSemaphores(waitInfo, UINT64_MAX)); // No lock held, other threads can keep uploading
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		Retire();
+	}
+
+	bool UploadContext::IsComplete(uint64_t ticket)
+	{
+		return m_Device.getSemaphoreCounterValue(m_Timeline.get()) >= ticket;
+	}
+
+	vk::CommandBuffer UploadContext::GetPendingCommandBuffer()
+	{
+		if (!m_HasPending)
+		{
+			if (m_FreeCommandBuffers.empty())
+				m_FreeCommandBuffers.push_back(m_Device.allocateCommandBuffers({ m_CommandPool.get(), vk::CommandBufferLevel::ePrimary, 1 })[0]);
+			m_Pending.CommandBuffer = m_FreeCommandBuffers.back();
+			m_FreeCommandBuffers.pop_back();
+			m_Pending.CommandBuffer.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+			m_HasPending = true;
+		}
+		return m_Pending.CommandBuffer;
+	}
+
+	uint64_t UploadContext::FlushLocked()
+	{
+		if (!m_HasPending)
+			return m_LastTicket;
+
+		// One barrier for the whole batch instead of one per copy, anything submitted after this sees the writes
+		vk::MemoryBarrier2 memoryBarrier2{ vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite };
+		m_Pending.CommandBuffer.pipelineBarrier2({ {}, 1, &memoryBarrier2 });
+		m_Pending.CommandBuffer.end();
+
+		m_Pending.Ticket = ++m_LastTicket;
+		m_Pending.RingEnd = m_WritePos;
+		vk::CommandBufferSubmitInfo commandBufferSubmitInfo{ m_Pending.CommandBuffer };
+		if (m_QueueFamily == m_GraphicsFamily)
+		{ // Everything's in the one command buffer, it signals the ticket itself
+			vk::SemaphoreSubmitInfo signalSemaphoreInfo{ m_Timeline.get(), m_Pending.Ticket, vk::PipelineStageFlagBits2::eAllCommands };
+			Submit(m_Queue, vk::SubmitInfo2{ {}, 0, nullptr, 1, &commandBufferSubmitInfo, 1, &signalSemaphoreInfo });
+		}
+		else
+		{ // The copies signal their own timeline, the ticket comes from the graphics queue after it so the two queues never race on one semaphore
+			vk::SemaphoreSubmitInfo signalTransferSemaphoreInfo{ m_TransferTimeline.get(), ++m_LastTransfer, vk::PipelineStageFlagBits2::eAllCommands };
+			Submit(m_Queue, vk::SubmitInfo2{ {}, 0, nullptr, 1, &commandBufferSubmitInfo, 1, &signalTransferSemaphoreInfo });
+
+			if (!m_Pending.BufferAcquires.empty() || !m_Pending.ImageAcquires.empty() || !m_Pending.GraphicsCommands.empty())
+			{ // Graphics queue picks up ownership once the copies are done
+				if (m_FreeAcquireCommandBuffers.empty())
+					m_FreeAcquireCommandBuffers.push_back(m_Device.allocateCommandBuffers({ m_AcquireCommandPool.get(), vk::CommandBufferLevel::ePrimary, 1 })[0]);
+				m_Pending.AcquireCommandBuffer = m_FreeAcquireCommandBuffers.back();
+				m_FreeAcquireCommandBuffers.pop_back();
+
+				m_Pending.AcquireCommandBuffer.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+				m_Pending.AcquireCommandBuffer.pipelineBarrier2({ {}, 0, nullptr, static_cast<uint32_t>(m_Pending.BufferAcquires.size()),
+					m_Pending.BufferAcquires.data(), static_cast<uint32_t>(m_Pending.ImageAcquires.size()), m_Pending.ImageAcquires.data() });
+				for (const std::function<void(vk::CommandBuffer commandBuffer)>& commands : m_Pending.GraphicsCommands)
+					commands(m_Pending.AcquireCommandBuffer);
+				m_Pending.AcquireCommandBuffer.end();
+			}
+
+			// Without anything to acquire it's an empty submit, still needed so the ticket only ever signals from the graphics queue, in order
+			vk::SemaphoreSubmitInfo waitTransferSemaphoreInfo{ m_TransferTimeline.get(), m_LastTransfer, vk::PipelineStageFlagBits2::eAllCommands };
+			vk::CommandBufferSubmitInfo acquireCommandBufferSubmitInfo{ m_Pending.AcquireCommandBuffer };
+			vk::SemaphoreSubmitInfo signalTicketSemaphoreInfo{ m_Timeline.get(), m_Pending.Ticket, vk::PipelineStageFlagBits2::eAllCommands };
+			Submit(m_GraphicsQueue, vk::SubmitInfo2{ {}, 1, &waitTransferSemaphoreInfo, m_Pending.AcquireCommandBuffer ? 1u : 0u,
+				&acquireCommandBufferSubmitInfo, 1, &signalTicketSemaphoreInfo });
+		}
+
+		m_InFlight.push_back(std::move(m_Pending));
+		m_Pending = {};
+		m_HasPending = false;
+		return m_LastTicket;
+	}
+
+	void UploadContext::Submit(vk::Queue queue, const vk::SubmitInfo2& submitInfo)
+	{ // Only the graphics queue is shared, a dedicated transfer queue is all ours
+		if (queue == m_GraphicsQueue)
+		{
+			std::lock_guard<std::mutex> lock(*m_GraphicsQueueMutex);
+			queue.submit2(submitInfo);
+		}
+		else
+			queue.submit2(submitInfo);
+	}
+
+	void UploadContext::Retire()
+	{
+		uint64_t completed = m_Device.getSemaphoreCounterValue(m_Timeline.get());
+		while (!m_InFlight.empty() && m_InFlight.front().Ticket <= completed)
+		{
+			Batch& batch = m_InFlight.front();
+			for (uint64_t pos : batch.Reserved)
+				m_Reserved.erase(m_Reserved.find(pos));
+			m_ReadPos = m_Reserved.empty() ? batch.RingEnd : std::min(batch.RingEnd, *m_Reserved.begin()); // Reservations still being written stay put
+			for (Buffer& overflow : batch.Overflow)
+				DestroyBuffer(m_Allocator, overflow);
+			m_FreeCommandBuffers.push_back(batch.CommandBuffer); // Gets reset when it's begun again
+			if (batch.AcquireCommandBuffer)
+				m_FreeAcquireCommandBuffers.push_back(batch.AcquireCommandBuffer);
+			m_InFlight.pop_front();
+		}
+	}
+}
\ No newline at end of file
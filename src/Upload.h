@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <set>
+#include <mutex>
+#include <functional>
+#include <vulkan/vulkan.hpp>
+#include <vma/vk_mem_alloc.h>
+
+#include "Buffer.h"
+
+namespace hyper
+{
+	// Batches uploads into one command buffer and one submit, staging memory comes out of a persistently mapped ring
+	// Flush hands back a ticket (timeline semaphore value) that can be waited on, instead of every copy doing a full round trip
+	// If the upload queue is a different family to graphics, resources get released here and acquired on the graphics queue before the ticket signals
+	// Tickets are only ever signalled from one queue, the upload queue if it can do graphics and the graphics queue if not, so they always go up in order
+	struct StagingAllocation // A piece of staging memory handed out by Reserve, write into Data from any thread then Commit it
+	{
+		void* Data = nullptr;
+		vk::Buffer Buffer;
+		vk::DeviceSize Offset = 0;
+		vk::DeviceSize Size = 0;
+		uint64_t RingPos = ~0ull; // ~0 when it got its own buffer instead of ring space
+		hyper::Buffer Overflow;
+	};
+
+	class UploadContext
+	{
+	public:
+		void CreateUploadContext(VmaAllocator& allocator, vk::Device device, vk::Queue queue, uint32_t queueFamily, vk::Queue graphicsQueue,
+			uint32_t graphicsFamily, std::mutex& graphicsQueueMutex, vk::DeviceSize stagingSize);
+		void DestroyUploadContext();
+
+		// Copies data into staging memory, then lets the caller record whatever copy it needs from there
+		void Stage(const void* data, vk::DeviceSize size, const std::function<void(vk::CommandBuffer commandBuffer, vk::Buffer staging,
+			vk::DeviceSize offset)>& commands);
+		// Same as Stage, but the caller fills the memory in (decoding straight into it, reading a file into it) without holding the lock
+		// The ring can't reuse a reservation's space until it's committed, so don't sit on one
+		StagingAllocation Reserve(vk::DeviceSize size);
+		void Commit(StagingAllocation& allocation, const std::function<void(vk::CommandBuffer commandBuffer, vk::Buffer staging,
+			vk::DeviceSize offset)>& commands);
+		void Cancel(StagingAllocation& allocation); // For when whatever was meant to go in it failed, nothing gets recorded
+		// For copies that don't need staging memory, like buffer to buffer
+		void Record(const std::function<void(vk::CommandBuffer commandBuffer)>& commands);
+		// For commands a transfer queue can't run, like blits, they go after this batch's copies (and acquires) on the graphics queue
+		// With a separate transfer family they're recorded at flush, so capture by value
+		void RecordGraphics(const std::function<void(vk::CommandBuffer commandBuffer)>& commands);
+
+		// Only call these from inside Stage/Record, once the copies into the resource are recorded
+		void ReleaseBuffer(vk::CommandBuffer commandBuffer, vk::Buffer buffer);
+		void ReleaseImage(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageSubresourceRange range, vk::ImageLayout oldLayout,
+			vk::ImageLayout newLayout);
+
+		uint64_t Flush(); // Submits everything recorded so far, returns the ticket for it
+		void Wait(uint64_t ticket);
+		bool IsComplete(uint64_t ticket);
+
+		vk::Semaphore GetTimeline() const { return m_Timeline.get(); }
+
+	private:
+		struct Batch
+		{
+			uint64_t Ticket = 0;
+			uint64_t RingEnd = 0; // Everything in the ring before this is free once the ticket completes
+			vk::CommandBuffer CommandBuffer;
+			vk::CommandBuffer AcquireCommandBuffer; // Graphics queue side of the ownership transfer, if there is one
+			std::vector<vk::BufferMemoryBarrier2> BufferAcquires;
+			std::vector<vk::ImageMemoryBarrier2> ImageAcquires;
+			std::vector<std::function<void(vk::CommandBuffer commandBuffer)>> GraphicsCommands;
+			std::vector<Buffer> Overflow; // Uploads too big for the ring get their own staging buffer
+			std::vector<uint64_t> Reserved; // Reservations committed into this batch, see m_Reserved
+		};
+
+		void Submit(vk::Queue queue, const vk::SubmitInfo2& submitInfo);
+
+		bool AllocateRing(vk::DeviceSize size, uint64_t& pos); // False if it can't fit right now without waiting on a reservation
+		vk::CommandBuffer GetPendingCommandBuffer();
+		uint64_t FlushLocked();
+		void Retire(); // Frees up everything the gpu has finished with, never blocks
+
+		VmaAllocator m_Allocator{};
+		vk::Device m_Device;
+		vk::Queue m_Queue, m_GraphicsQueue;
+		uint32_t m_QueueFamily = 0, m_GraphicsFamily = 0;
+		std::mutex* m_GraphicsQueueMutex = nullptr; // Shared with the renderer, queues can't be submitted to from two threads at once
+
+		vk::UniqueCommandPool m_CommandPool, m_AcquireCommandPool;
+		std::vector<vk::CommandBuffer> m_FreeCommandBuffers, m_FreeAcquireCommandBuffers;
+		vk::UniqueSemaphore m_Timeline; // Tickets
+		vk::UniqueSemaphore m_TransferTimeline; // Only with a separate upload family, the copies being done, which the graphics side waits on
+		uint64_t m_LastTicket = 0, m_LastTransfer = 0;
+
+		Buffer m_Ring;
+		vk::DeviceSize m_RingSize = 0;
+		uint64_t m_WritePos = 0, m_ReadPos = 0; // Never wrap, the offset into the ring is pos % m_RingSize
+		std::multiset<uint64_t> m_Reserved; // Ring positions handed out by Reserve whose batch hasn't retired yet, m_ReadPos can't pass the first one
+
+		Batch m_Pending;
+		bool m_HasPending = false;
+		std::deque<Batch> m_InFlight;
+
+		std::mutex m_Mutex;
+	};
+}
\ No newline at end of file
@@ -8,6 +8,9 @@ int main()
 	hyper::Logger* logger = new hyper::Logger();
 	logger->SetDebug(spec);
 
-	hyper::Application app(spec);
-	app.Run();
+	{
+		hyper::Application app(spec);
+		app.Run();
+	}
+	delete logger; // Writes out whatever's still queued, the renderer's goodbye included
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+#include <cmath>
+
+#include "Test.h"
+#include "MeshOptimizer.h"
+
+namespace hyper
+{
+	namespace
+	{
+		struct TestVertex // No padding, so bitwise welding sees exactly what's set
+		{
+			float Position[3];
+			float TexCoord[2];
+		};
+
+		struct TestMesh
+		{
+			std::vector<TestVertex> Vertices;
+			std::vector<uint32_t> Indices;
+		};
+
+		// side x side quads, two triangles each, counter-clockwise, triangles in row order like most exporters leave them
+		TestMesh MakeGrid(uint32_t side)
+		{
+			TestMesh mesh;
+			for (uint32_t y = 0; y <= side; y++)
+				for (uint32_t x = 0; x <= side; x++)
+				{
+					float u = static_cast<float>(x) / side, v = static_cast<float>(y) / side;
+					mesh.Vertices.push_back({ { u, v, 0.0f }, { u, v } });
+				}
+			for (uint32_t y = 0; y < side; y++)
+				for (uint32_t x = 0; x < side; x++)
+				{
+					uint32_t i = y * (side + 1) + x;
+					for (uint32_t index : { i, i + 1, i + side + 2, i + side + 2, i + side + 1, i })
+						mesh.Indices.push_back(index);
+				}
+			return mesh;
+		}
+
+		void ShuffleTriangles(std::vector<uint32_t>& indices, uint32_t seed)
+		{
+			std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+			std::memcpy(triangles.data(), indices.data(), indices.size() * sizeof(uint32_t));
+			std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+			std::memcpy(indices.data(), triangles.data(), indices.size() * sizeof(uint32_t));
+		}
+
+		// Every triangle as its three vertices' bytes, rotated to start at the smallest so winding counts but where it starts doesn't, then sorted
+		using TriangleKey = std::array<std::array<unsigned char, sizeof(TestVertex)>, 3>;
+		std::vector<TriangleKey> TriangleSet(const TestMesh& mesh)
+		{
+			std::vector<TriangleKey> triangles;
+			for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+			{
+				TriangleKey key;
+				for (size_t corner = 0; corner < 3; corner++)
+					std::memcpy(key[corner].data(), &mesh.Vertices[mesh.Indices[i + corner]], sizeof(TestVertex));
+				std::rotate(key.begin(), std::min_element(key.begin(), key.end()), key.end());
+				triangles.push_back(key);
+			}
+			std::sort(triangles.begin(), triangles.end());
+			return triangles;
+		}
+
+		// Everything OptimizeMesh does after welding, in the same order
+		void Optimize(TestMesh& mesh, uint32_t cacheSize)
+		{
+			std::vector<uint32_t> clusters = OptimizeVertexCache(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.size(), cacheSize);
+			OptimizeOverdraw(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices[0].Position, mesh.Vertices.size(), sizeof(TestVertex),
+				clusters, cacheSize, 1.05f);
+			std::vector<TestVertex> vertices(mesh.Vertices.size());
+			vertices.resize(OptimizeVertexFetch(vertices.data(), mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size(),
+				sizeof(TestVertex)));
+			mesh.Vertices = std::move(vertices);
+		}
+	}
+
+	HYPER_TEST("mesh/weld removes exact duplicates")
+	{ // Unindexed grid, every triangle has its own copy of its corners, like a glTF with split vertices
+		TestMesh grid = MakeGrid(8);
+		TestMesh split;
+		for (uint32_t index : grid.Indices)
+		{
+			split.Indices.push_back(static_cast<uint32_t>(split.Vertices.size()));
+			split.Vertices.push_back(grid.Vertices[index]);
+		}
+		TestVertex nearDuplicate = grid.Vertices[0];
+		nearDuplicate.TexCoord[0] = std::nextafter(nearDuplicate.TexCoord[0], 1.0f); // One bit off is a different vertex
+		split.Vertices.push_back(nearDuplicate);
+
+		std::vector<uint32_t> remap;
+		size_t unique = GenerateVertexRemap(remap, split.Vertices.data(), split.Vertices.size(), sizeof(TestVertex));
+		HYPER_CHECK(unique == grid.Vertices.size() + 1);
+
+		std::vector<TestVertex> welded(unique);
+		RemapVertices(welded.data(), split.Vertices.data(), split.Vertices.size(), sizeof(TestVertex), remap);
+		for (size_t i = 0; i < split.Vertices.size(); i++)
+			HYPER_CHECK(remap[i] < unique && std::memcmp(&welded[remap[i]], &split.Vertices[i], sizeof(TestVertex)) == 0);
+
+		TestMesh result{ welded, split.Indices };
+		RemapIndices(result.Indices.data(), result.Indices.size(), remap);
+		HYPER_CHECK(TriangleSet(result) == TriangleSet(split));
+	}
+
+	HYPER_TEST("mesh/reordering keeps every triangle")
+	{
+		TestMesh mesh = MakeGrid(32);
+		ShuffleTriangles(mesh.Indices, 1);
+		std::vector<TriangleKey> before = TriangleSet(mesh);
+		Optimize(mesh, 16);
+		HYPER_CHECK(mesh.Indices.size() == before.size() * 3);
+		HYPER_CHECK(TriangleSet(mesh) == before);
+	}
+
+	HYPER_TEST("mesh/cache stats don't get worse")
+	{
+		for (bool shuffled : { false, true })
+			for (uint32_t cacheSize : { 8u, 16u, 32u })
+			{
+				TestMesh mesh = MakeGrid(64);
+				if (shuffled)
+					ShuffleTriangles(mesh.Indices, cacheSize);
+				VertexCacheStats before = AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.size(), cacheSize);
+				Optimize(mesh, cacheSize);
+				VertexCacheStats after = AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.size(), cacheSize);
+				HYPER_CHECK(after.ACMR <= before.ACMR);
+				HYPER_CHECK(after.ATVR <= before.ATVR);
+				if (shuffled) // Random order is close to the worst case, anything working should win by a lot
+					HYPER_CHECK(after.ACMR < before.ACMR * 0.75f);
+			}
+	}
+
+	HYPER_TEST("mesh/fetch order is first touch")
+	{
+		TestMesh mesh = MakeGrid(16);
+		ShuffleTriangles(mesh.Indices, 2);
+		mesh.Vertices.push_back({ { 2.0f, 2.0f, 2.0f }, { 0.0f, 0.0f } }); // Nothing uses it, fetch should drop it
+		size_t used = mesh.Vertices.size() - 1;
+
+		std::vector<TestVertex> vertices(mesh.Vertices.size());
+		std::vector<uint32_t> indices = mesh.Indices;
+		size_t count = OptimizeVertexFetch(vertices.data(), indices.data(), indices.size(), mesh.Vertices.data(), mesh.Vertices.size(), sizeof(TestVertex));
+		HYPER_CHECK(count == used);
+
+		uint32_t next = 0;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			HYPER_CHECK(indices[i] <= next); // Either one seen before or the very next one
+			if (indices[i] == next)
+				next++;
+			HYPER_CHECK(std::memcmp(&vertices[indices[i]], &mesh.Vertices[mesh.Indices[i]], sizeof(TestVertex)) == 0);
+		}
+		HYPER_CHECK(next == count);
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+namespace hyper
+{
+	struct TestCase
+	{
+		const char* Name;
+		void (*Body)();
+	};
+
+	// Tiny test harness, no dependencies so the tests build without the Vulkan SDK, anything that needs a device belongs in hyper-bench
+	std::vector<TestCase>& GetTests();
+	void ReportFailure(const char* file, int line, const char* expression); // Counts against whichever test is running, it keeps going
+
+	struct TestRegistrar // One per HYPER_TEST, adds it before main runs
+	{
+		TestRegistrar(const char* name, void (*body)()) { GetTests().push_back({ name, body }); }
+	};
+}
+
+// name is what --filter matches against, "mesh/weld" and the like, body is the braces after it
+#define HYPER_TEST_CONCAT_(a, b) a##b
+#define HYPER_TEST_CONCAT(a, b) HYPER_TEST_CONCAT_(a, b)
+#define HYPER_TEST(name) \
+	static void HYPER_TEST_CONCAT(Test, __LINE__)(); \
+	static hyper::TestRegistrar HYPER_TEST_CONCAT(Registrar, __LINE__)(name, HYPER_TEST_CONCAT(Test, __LINE__)); \
+	static void HYPER_TEST_CONCAT(Test, __LINE__)()
+
+#define HYPER_CHECK(expression) do { if (!(expression)) hyper::ReportFailure(__FILE__, __LINE__, #expression); } while (false)
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <string>
+
+#include "Test.h"
+
+namespace hyper
+{
+	namespace
+	{
+		uint32_t failures = 0;
+	}
+
+	std::vector<TestCase>& GetTests()
+	{ // Function static so registrars in other files can't run before it exists
+		static std::vector<TestCase> tests;
+		return tests;
+	}
+
+	void ReportFailure(const char* file, int line, const char* expression)
+	{
+		std::cerr << file << "(" << line << "): check failed: " << expression << "\n";
+		failures++;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else
+		{
+			std::cerr << "Usage: hyper-tests [--filter name]\n";
+			return 2;
+		}
+	}
+
+	uint32_t run = 0, failed = 0;
+	for (const hyper::TestCase& test : hyper::GetTests())
+	{
+		if (!filter.empty() && std::string(test.Name).find(filter) == std::string::npos)
+			continue;
+		uint32_t before = hyper::failures;
+		test.Body();
+		bool passed = hyper::failures == before;
+		std::cout << (passed ? "[pass] " : "[FAIL] ") << test.Name << "\n";
+		run++;
+		failed += passed ? 0 : 1;
+	}
+	std::cout << run - failed << "/" << run << " tests passed\n";
+	return failed == 0 && run > 0 ? 0 : 1;
+}